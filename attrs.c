@@ -0,0 +1,258 @@
+#include "attrs.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_MODULE "attrs"
+#define LOG_ENABLE_DBG 0
+#include "log.h"
+#include "debug.h"
+#include "grid.h"
+#include "macros.h"
+#include "util.h"
+#include "xmalloc.h"
+
+#define MAX_ATTRS (1u << 28)   /* Limited by the width of cell_attrs.idx */
+#define RESERVED_SLOTS 2
+
+/*
+ * Attributes are not reference counted. That would mean updating
+ * counts on every cell write, erase and scroll, for two grids,
+ * slowing down the hottest paths. Instead, attributes no longer
+ * referenced by any grid are reclaimed by a mark-and-sweep
+ * collection, when the table is full.
+ *
+ * The collection's pause is bounded by the number of lines, not
+ * cells: compressed scrollback rows, which is all but a couple of
+ * screens' worth, are marked from their attribute runs only (see
+ * grid_mark_attrs()). Its cost is amortized, too; reclaimed slots
+ * are only re-used if they make up at least a quarter of the table,
+ * otherwise the table grows. I.e. there are at least size/4 new
+ * attributes between two collections.
+ *
+ * Below this size (48KB, plus the index), the table is simply grown.
+ */
+#define MIN_GC_SIZE 4096
+
+/* Marks a free slot; never set in real attributes */
+static const struct attributes free_slot = {.reserved = 1};
+
+static uint32_t
+attrs_hash(const struct attributes *attrs)
+{
+    uint64_t v;
+    memcpy(&v, attrs, sizeof(v));
+
+    /* FNV-1a, on each 32-bit half */
+    uint32_t hash = 2166136261u;
+    hash = (hash ^ (uint32_t)v) * 16777619u;
+    hash = (hash ^ (uint32_t)(v >> 32)) * 16777619u;
+    return hash;
+}
+
+static void
+index_insert(struct terminal *term, size_t idx)
+{
+    const size_t mask = term->attrs_index_size - 1;
+
+    for (size_t i = attrs_hash(&term->attrs[idx]) & mask;
+         ;
+         i = (i + 1) & mask)
+    {
+        if (term->attrs_index[i] == 0) {
+            term->attrs_index[i] = idx + 1;
+            return;
+        }
+    }
+}
+
+static void
+index_rebuild(struct terminal *term)
+{
+    /* Keep the load factor at or below 0.5 */
+    const size_t size = term->attrs_size * 2;
+
+    if (size != term->attrs_index_size) {
+        free(term->attrs_index);
+        term->attrs_index = xcalloc(size, sizeof(term->attrs_index[0]));
+        term->attrs_index_size = size;
+    } else
+        memset(term->attrs_index, 0, size * sizeof(term->attrs_index[0]));
+
+    for (size_t i = 0; i < term->attrs_count; i++) {
+        if (!attrs_equal(&term->attrs[i], &free_slot))
+            index_insert(term, i);
+    }
+}
+
+/* Releases all attributes not referenced by any grid. Returns the number of released slots */
+static size_t
+collect_garbage(struct terminal *term)
+{
+    bool *used = xcalloc(term->attrs_count, sizeof(used[0]));
+
+    grid_mark_attrs(&term->normal, used, term->attrs_count);
+    grid_mark_attrs(&term->alt, used, term->attrs_count);
+    if (term->url_grid_snapshot != NULL)
+        grid_mark_attrs(term->url_grid_snapshot, used, term->attrs_count);
+
+    /* Keep attrs_pen() valid */
+    if (term->attrs_pen_idx < term->attrs_count)
+        used[term->attrs_pen_idx] = true;
+
+    size_t freed = 0;
+    for (size_t i = RESERVED_SLOTS; i < term->attrs_count; i++) {
+        if (used[i] || attrs_equal(&term->attrs[i], &free_slot))
+            continue;
+
+        term->attrs[i] = free_slot;
+        freed++;
+    }
+
+    free(used);
+
+    LOG_DBG("reclaimed %zu of %zu attributes", freed, term->attrs_count);
+
+    if (freed > 0) {
+        term->attrs_reuse_ofs = RESERVED_SLOTS;
+        index_rebuild(term);
+    }
+
+    return freed;
+}
+
+static bool
+alloc_slot(struct terminal *term, size_t *slot)
+{
+    /* Re-use slots released by the last garbage collection */
+    while (term->attrs_reuse_ofs < term->attrs_count) {
+        size_t i = term->attrs_reuse_ofs++;
+        if (attrs_equal(&term->attrs[i], &free_slot)) {
+            *slot = i;
+            return true;
+        }
+    }
+
+    if (term->attrs_count < term->attrs_size) {
+        *slot = term->attrs_count++;
+        return true;
+    }
+
+    const bool at_max = term->attrs_size >= MAX_ATTRS;
+
+    if (term->attrs_size >= MIN_GC_SIZE) {
+        size_t freed = collect_garbage(term);
+
+        /*
+         * Only re-use the reclaimed slots if there are enough of
+         * them; otherwise we'd end up scanning the grids over and
+         * over again.
+         */
+        if (freed > 0 && (freed >= term->attrs_size / 4 || at_max))
+            return alloc_slot(term, slot);
+    }
+
+    if (at_max)
+        return false;
+
+    const size_t new_size = min(term->attrs_size * 2, MAX_ATTRS);
+
+    term->attrs = xrealloc(term->attrs, new_size * sizeof(term->attrs[0]));
+    term->attrs_size = new_size;
+    index_rebuild(term);
+
+    *slot = term->attrs_count++;
+    return true;
+}
+
+void
+attrs_init(struct terminal *term)
+{
+    xassert(term->attrs == NULL);
+
+    term->attrs_size = 16;
+    term->attrs = xmalloc(term->attrs_size * sizeof(term->attrs[0]));
+    term->attrs[ATTRS_DEFAULT] = (struct attributes){0};
+    term->attrs[ATTRS_UNDERLINE] = (struct attributes){.underline = true};
+    term->attrs_count = RESERVED_SLOTS;
+    term->attrs_reuse_ofs = RESERVED_SLOTS;
+    term->attrs_generation++;
+    index_rebuild(term);
+
+    term->attrs_pen = (struct attributes){0};
+    term->attrs_pen_idx = ATTRS_DEFAULT;
+}
+
+uint32_t
+attrs_get(struct terminal *term, const struct attributes *attrs)
+{
+    xassert(!attrs_equal(attrs, &free_slot));
+
+    if (unlikely(term->attrs == NULL))
+        attrs_init(term);
+
+    const size_t mask = term->attrs_index_size - 1;
+
+    for (size_t i = attrs_hash(attrs) & mask;
+         term->attrs_index[i] != 0;
+         i = (i + 1) & mask)
+    {
+        const size_t idx = term->attrs_index[i] - 1;
+        if (attrs_equal(&term->attrs[idx], attrs))
+            return idx;
+    }
+
+    size_t slot;
+    if (!alloc_slot(term, &slot)) {
+        LOG_WARN("attribute table full");
+        return ATTRS_DEFAULT;
+    }
+
+    term->attrs[slot] = *attrs;
+    term->attrs_generation++;
+    index_insert(term, slot);
+    return slot;
+}
+
+void
+attrs_free(struct terminal *term)
+{
+    free(term->attrs);
+    free(term->attrs_index);
+    term->attrs = NULL;
+    term->attrs_index = NULL;
+    term->attrs_count = 0;
+    term->attrs_size = 0;
+    term->attrs_index_size = 0;
+    term->attrs_reuse_ofs = 0;
+    term->attrs_generation++;
+}
+
+UNITTEST
+{
+    struct terminal term = {.attrs_count = 0};
+    attrs_init(&term);
+
+    const struct attributes bold = {.bold = true};
+    const struct attributes red = {.have_fg = true, .fg = 0xff0000};
+
+    uint32_t idx_bold = attrs_get(&term, &bold);
+    uint32_t idx_red = attrs_get(&term, &red);
+
+    xassert(idx_bold >= RESERVED_SLOTS);
+    xassert(idx_red >= RESERVED_SLOTS);
+    xassert(idx_bold != idx_red);
+    xassert(attrs_get(&term, &bold) == idx_bold);
+    xassert(attrs_get(&term, &(struct attributes){0}) == ATTRS_DEFAULT);
+    xassert(attrs_get(&term, &(struct attributes){.underline = true}) == ATTRS_UNDERLINE);
+    xassert(term.attrs_count == RESERVED_SLOTS + 2);
+
+    /* Unreferenced attributes are reclaimed, instead of growing forever */
+    for (size_t i = 0; i < 2 * MIN_GC_SIZE; i++) {
+        const struct attributes a = {.have_bg = true, .bg = i};
+        xassert(attrs_get(&term, &a) != ATTRS_DEFAULT);
+    }
+    xassert(term.attrs_size == MIN_GC_SIZE);
+
+    attrs_free(&term);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include "macros.h"
+#include "terminal.h"
+
+/*
+ * Reserved slots, never reclaimed. Zeroed cells use ATTRS_DEFAULT;
+ * ATTRS_UNDERLINE is used by IME pre-edit text.
+ */
+#define ATTRS_DEFAULT   0
+#define ATTRS_UNDERLINE 1
+
+/*
+ * Looks up 'attrs' in the terminal's attribute table, interning it
+ * if it doesn't already exist. Returns its index.
+ *
+ * When there are no free slots left, attributes no longer referenced
+ * by any grid are reclaimed. Should that fail too, ATTRS_DEFAULT is
+ * returned.
+ */
+uint32_t attrs_get(struct terminal *term, const struct attributes *attrs);
+void attrs_init(struct terminal *term);
+void attrs_free(struct terminal *term);
+
+static inline bool
+attrs_equal(const struct attributes *a, const struct attributes *b)
+{
+    uint64_t x, y;
+    memcpy(&x, a, sizeof(x));
+    memcpy(&y, b, sizeof(y));
+    return x == y;
+}
+
+/* The index of the current VT attributes (term->vt.attrs) */
+static inline uint32_t
+attrs_pen(struct terminal *term)
+{
+    if (likely(attrs_equal(&term->vt.attrs, &term->attrs_pen)))
+        return term->attrs_pen_idx;
+
+    term->attrs_pen_idx = attrs_get(term, &term->vt.attrs);
+    term->attrs_pen = term->vt.attrs;
+    return term->attrs_pen_idx;
+}
+
+/* A cell's attributes. Not for use by the renderer; see cell_attrs() in render.c */
+static inline const struct attributes *
+attrs_of(const struct terminal *term, const struct cell *cell)
+{
+    xassert(cell->attrs.idx < term->attrs_count);
+    return &term->attrs[cell->attrs.idx];
+}
@@ -24,6 +24,23 @@ cmd_scrollback_up(struct terminal *term, int rows)
     rows = min(rows, term->rows);
     xassert(term->grid->offset >= 0);
 
+    if (term->conf->scrollback.spill) {
+        /* Page in spilled lines, when about to reach the oldest row */
+        const int screen_end = grid_row_absolute(term->grid, term->rows - 1);
+
+        int above = 0;
+        for (int r = grid_row_absolute_in_view(term->grid, -1);
+             above < rows && r != screen_end &&
+                 grid_ring_get(term->grid, r) != NULL;
+             r = grid_row_wrap(term->grid, r - 1))
+        {
+            above++;
+        }
+
+        if (above < rows)
+            term_spill_page_in(term, rows - above, NULL);
+    }
+
     int new_view = term->grid->view - rows;
     while (new_view < 0)
         new_view += term->grid->num_rows;
@@ -33,7 +50,7 @@ cmd_scrollback_up(struct terminal *term, int rows)
     xassert(new_view < term->grid->num_rows);
 
     /* Avoid scrolling in uninitialized rows */
-    while (term->grid->rows[new_view] == NULL)
+    while (grid_ring_get(term->grid, new_view) == NULL)
         new_view = (new_view + 1) % term->grid->num_rows;
 
     if (new_view == term->grid->view) {
@@ -57,12 +74,12 @@ cmd_scrollback_up(struct terminal *term, int rows)
             new_view = (end + 1) % term->grid->num_rows;
     }
 
-    while (term->grid->rows[new_view] == NULL)
+    while (grid_ring_get(term->grid, new_view) == NULL)
         new_view = (new_view + 1) % term->grid->num_rows;
 
 #if defined(_DEBUG)
     for (int r = 0; r < term->rows; r++)
-        xassert(term->grid->rows[(new_view + r) % term->grid->num_rows] != NULL);
+        xassert(grid_ring_get(term->grid, grid_row_wrap(term->grid, new_view + r)) != NULL);
 #endif
 
     LOG_DBG("scrollback UP: %d -> %d (offset = %d, end = %d, rows = %d)",
@@ -80,6 +97,10 @@ cmd_scrollback_up(struct terminal *term, int rows)
     selection_view_up(term, new_view);
     term->grid->view = new_view;
 
+    /* Re-compress scrollback rows no longer in view */
+    if (term->conf->scrollback.compress)
+        grid_compress_scrollback(term->grid, term->rows, 0);
+
     if (diff >= 0 && diff < term->rows) {
         term_damage_scroll(term, DAMAGE_SCROLL_REVERSE_IN_VIEW, (struct scroll_region){0, term->rows}, diff);
         term_damage_rows_in_view(term, 0, diff - 1);
@@ -118,7 +139,7 @@ cmd_scrollback_down(struct terminal *term, int rows)
 
         for (int i = 0; i < term->rows; i++) {
             int row_no = (new_view + i) % term->grid->num_rows;
-            if (term->grid->rows[row_no] == NULL) {
+            if (grid_ring_get(term->grid, row_no) == NULL) {
                 all_initialized = false;
                 new_view--;
                 break;
@@ -139,7 +160,7 @@ cmd_scrollback_down(struct terminal *term, int rows)
 
 #if defined(_DEBUG)
     for (int r = 0; r < term->rows; r++)
-        xassert(term->grid->rows[(new_view + r) % term->grid->num_rows] != NULL);
+        xassert(grid_ring_get(term->grid, grid_row_wrap(term->grid, new_view + r)) != NULL);
 #endif
 
     LOG_DBG("scrollback DOWN: %d -> %d (offset = %d, end = %d, rows = %d)",
@@ -157,6 +178,10 @@ cmd_scrollback_down(struct terminal *term, int rows)
     selection_view_down(term, new_view);
     term->grid->view = new_view;
 
+    /* Re-compress scrollback rows no longer in view */
+    if (term->conf->scrollback.compress)
+        grid_compress_scrollback(term->grid, term->rows, 0);
+
     if (diff >= 0 && diff < term->rows) {
         term_damage_scroll(term, DAMAGE_SCROLL_IN_VIEW, (struct scroll_region){0, term->rows}, diff);
         term_damage_rows_in_view(term, term->rows - diff, term->rows - 1);
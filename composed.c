@@ -0,0 +1,255 @@
+#include "composed.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_MODULE "composed"
+#define LOG_ENABLE_DBG 0
+#include "log.h"
+#include "debug.h"
+#include "grid.h"
+#include "macros.h"
+#include "util.h"
+#include "xmalloc.h"
+
+#define MAX_CHAINS (CELL_COMB_CHARS_HI - CELL_COMB_CHARS_LO + 1)
+
+/*
+ * Like attributes (see attrs.c), chains are not reference counted,
+ * but reclaimed by a mark-and-sweep collection when the array is
+ * full. Compressed scrollback rows' text is only scanned if it has
+ * composed characters (see grid_mark_composed()). Below this size,
+ * simply grow the chain array instead.
+ */
+#define MIN_GC_SIZE 4096
+
+static uint32_t
+chain_hash(const struct composed *cc)
+{
+    /* FNV-1a */
+    uint32_t hash = 2166136261u;
+
+    hash = (hash ^ (uint32_t)cc->base) * 16777619u;
+    for (size_t i = 0; i < cc->count; i++)
+        hash = (hash ^ (uint32_t)cc->combining[i]) * 16777619u;
+
+    return hash;
+}
+
+static bool
+chain_equal(const struct composed *a, const struct composed *b)
+{
+    if (a->base != b->base || a->count != b->count)
+        return false;
+
+    for (size_t i = 0; i < a->count; i++) {
+        if (a->combining[i] != b->combining[i])
+            return false;
+    }
+
+    return true;
+}
+
+static void
+index_insert(struct terminal *term, size_t idx)
+{
+    const size_t mask = term->composed_index_size - 1;
+
+    for (size_t i = chain_hash(&term->composed[idx]) & mask;
+         ;
+         i = (i + 1) & mask)
+    {
+        if (term->composed_index[i] == 0) {
+            term->composed_index[i] = idx + 1;
+            return;
+        }
+    }
+}
+
+static void
+index_rebuild(struct terminal *term)
+{
+    /* Keep the load factor at or below 0.5 */
+    const size_t size = term->composed_size * 2;
+
+    if (size != term->composed_index_size) {
+        free(term->composed_index);
+        term->composed_index = xcalloc(size, sizeof(term->composed_index[0]));
+        term->composed_index_size = size;
+    } else
+        memset(term->composed_index, 0, size * sizeof(term->composed_index[0]));
+
+    for (size_t i = 0; i < term->composed_count; i++) {
+        if (term->composed[i].count > 0)
+            index_insert(term, i);
+    }
+}
+
+/* Releases all chains not referenced by any grid. Returns the number of released chains */
+static size_t
+collect_garbage(struct terminal *term)
+{
+    bool *used = xcalloc(term->composed_count, sizeof(used[0]));
+
+    grid_mark_composed(&term->normal, used, term->composed_count);
+    grid_mark_composed(&term->alt, used, term->composed_count);
+    if (term->url_grid_snapshot != NULL)
+        grid_mark_composed(term->url_grid_snapshot, used, term->composed_count);
+
+    /* REP */
+    const wchar_t last = term->vt.last_printed;
+    if (last >= CELL_COMB_CHARS_LO &&
+        last < (CELL_COMB_CHARS_LO + term->composed_count))
+    {
+        used[last - CELL_COMB_CHARS_LO] = true;
+    }
+
+    size_t freed = 0;
+    for (size_t i = 0; i < term->composed_count; i++) {
+        if (used[i] || term->composed[i].count == 0)
+            continue;
+
+        /* A zero count marks the slot as free */
+        term->composed[i] = (struct composed){.count = 0};
+        freed++;
+    }
+
+    free(used);
+
+    LOG_DBG("reclaimed %zu of %zu composed character chains",
+            freed, term->composed_count);
+
+    if (freed > 0) {
+        term->composed_reuse_ofs = 0;
+        index_rebuild(term);
+    }
+
+    return freed;
+}
+
+static bool
+alloc_slot(struct terminal *term, size_t *slot)
+{
+    /* Re-use slots released by the last garbage collection */
+    while (term->composed_reuse_ofs < term->composed_count) {
+        size_t i = term->composed_reuse_ofs++;
+        if (term->composed[i].count == 0) {
+            *slot = i;
+            return true;
+        }
+    }
+
+    if (term->composed_count < term->composed_size) {
+        *slot = term->composed_count++;
+        return true;
+    }
+
+    const bool at_max = term->composed_size >= MAX_CHAINS;
+
+    if (term->composed_size >= MIN_GC_SIZE) {
+        size_t freed = collect_garbage(term);
+
+        /*
+         * Only re-use the reclaimed slots if there are enough of
+         * them; otherwise we'd end up scanning the grids over and
+         * over again.
+         */
+        if (freed > 0 && (freed >= term->composed_size / 4 || at_max))
+            return alloc_slot(term, slot);
+    }
+
+    if (at_max)
+        return false;
+
+    const size_t new_size = min(
+        term->composed_size > 0 ? term->composed_size * 2 : 16, MAX_CHAINS);
+
+    term->composed = xrealloc(
+        term->composed, new_size * sizeof(term->composed[0]));
+    term->composed_size = new_size;
+    index_rebuild(term);
+
+    *slot = term->composed_count++;
+    return true;
+}
+
+bool
+composed_get(struct terminal *term, const struct composed *cc, wchar_t *wc)
+{
+    xassert(cc->count > 0);
+    xassert(cc->count <= ALEN(cc->combining));
+
+    if (term->composed_index_size > 0) {
+        const size_t mask = term->composed_index_size - 1;
+
+        for (size_t i = chain_hash(cc) & mask;
+             term->composed_index[i] != 0;
+             i = (i + 1) & mask)
+        {
+            const size_t idx = term->composed_index[i] - 1;
+            if (chain_equal(&term->composed[idx], cc)) {
+                *wc = CELL_COMB_CHARS_LO + idx;
+                return true;
+            }
+        }
+    }
+
+    size_t slot;
+    if (!alloc_slot(term, &slot))
+        return false;
+
+    term->composed[slot] = *cc;
+    term->composed_generation++;
+    index_insert(term, slot);
+
+    *wc = CELL_COMB_CHARS_LO + slot;
+    return true;
+}
+
+void
+composed_free(struct terminal *term)
+{
+    free(term->composed);
+    free(term->composed_index);
+    term->composed = NULL;
+    term->composed_index = NULL;
+    term->composed_count = 0;
+    term->composed_size = 0;
+    term->composed_index_size = 0;
+    term->composed_reuse_ofs = 0;
+    term->composed_generation++;
+}
+
+UNITTEST
+{
+    struct terminal term = {
+        .composed_count = 0,
+    };
+
+    const struct composed a = {.base = L'a', .combining = {0x301}, .count = 1};
+    const struct composed a2 = {.base = L'a', .combining = {0x300, 0x301}, .count = 2};
+    const struct composed b2 = {.base = L'a', .combining = {0x302, 0x301}, .count = 2};
+
+    wchar_t wc_a, wc_a2, wc_b2, wc;
+    xassert(composed_get(&term, &a, &wc_a));
+    xassert(composed_get(&term, &a2, &wc_a2));
+    xassert(composed_get(&term, &b2, &wc_b2));
+
+    /* Same base and last combining character, but different chains */
+    xassert(wc_a != wc_a2);
+    xassert(wc_a2 != wc_b2);
+
+    xassert(composed_get(&term, &a2, &wc));
+    xassert(wc == wc_a2);
+    xassert(term.composed_count == 3);
+
+    /* Unreferenced chains are reclaimed, instead of growing forever */
+    for (size_t i = 0; i < 2 * MIN_GC_SIZE; i++) {
+        const struct composed cc = {
+            .base = 0x4e00 + i, .combining = {0x301}, .count = 1};
+        xassert(composed_get(&term, &cc, &wc));
+    }
+    xassert(term.composed_size == MIN_GC_SIZE);
+
+    composed_free(&term);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdbool.h>
+#include "terminal.h"
+
+/*
+ * Looks up the composed character chain 'cc', allocating a new one
+ * if it doesn't already exist. On success, '*wc' is set to the cell
+ * value representing the chain (CELL_COMB_CHARS_LO + index).
+ *
+ * When there are no free slots left, chains no longer referenced by
+ * any grid are reclaimed. Returns false if that too fails.
+ */
+bool composed_get(struct terminal *term, const struct composed *cc, wchar_t *wc);
+void composed_free(struct terminal *term);
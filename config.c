@@ -989,6 +989,12 @@ parse_section_scrollback(const char *key, const char *value, struct config *conf
         conf->scrollback.multiplier = multiplier;
     }
 
+    else if (strcmp(key, "compress") == 0)
+        conf->scrollback.compress = str_to_bool(value);
+
+    else if (strcmp(key, "spill") == 0)
+        conf->scrollback.spill = str_to_bool(value);
+
     else {
         LOG_AND_NOTIFY_ERR("%s:%u: [scrollback]: %s: invalid key", path, lineno, key);
         return false;
@@ -2017,6 +2023,12 @@ parse_section_tweak(
             LOG_WARN("tweak: damage whole window");
     }
 
+    else if (strcmp(key, "parser-thread") == 0) {
+        conf->tweak.parser_thread = str_to_bool(value);
+        if (conf->tweak.parser_thread)
+            LOG_WARN("tweak: parsing client output in a separate thread");
+    }
+
     else if (strcmp(key, "render-timer") == 0) {
         if (strcmp(value, "none") == 0) {
             conf->tweak.render_timer_osd = false;
@@ -2541,6 +2553,8 @@ config_load(struct config *conf, const char *conf_path,
                 .text = wcsdup(L""),
             },
             .multiplier = 3.,
+            .compress = false,
+            .spill = false,
         },
         .colors = {
             .fg = default_foreground,
@@ -2614,6 +2628,7 @@ config_load(struct config *conf, const char *conf_path,
             .render_timer_osd = false,
             .render_timer_log = false,
             .damage_whole_window = false,
+            .parser_thread = false,
             .box_drawing_base_thickness = 0.04,
             .box_drawing_solid_shades = true,
             .pua_double_width = false,
@@ -127,6 +127,8 @@ struct config {
             wchar_t *text;
         } indicator;
         double multiplier;
+        bool compress;
+        bool spill;
     } scrollback;
 
     struct {
@@ -234,6 +236,7 @@ struct config {
         bool render_timer_osd;
         bool render_timer_log;
         bool damage_whole_window;
+        bool parser_thread;
         uint64_t delayed_render_lower_ns;
         uint64_t delayed_render_upper_ns;
         off_t max_shm_pool_size;
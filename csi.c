@@ -22,6 +22,7 @@
 #include "util.h"
 #include "version.h"
 #include "vt.h"
+#include "wcwidth.h"
 #include "xmalloc.h"
 #include "xsnprintf.h"
 
@@ -744,7 +745,7 @@ csi_dispatch(struct terminal *term, uint8_t final)
                 int count = vt_param_get(term, 0, 1);
                 LOG_DBG("REP: '%lc' %d times", (wint_t)term->vt.last_printed, count);
 
-                const int width = wcwidth(term->vt.last_printed);
+                const int width = my_wcwidth(term->vt.last_printed);
                 if (width > 0) {
                     for (int i = 0; i < count; i++)
                         term_print(term, term->vt.last_printed, width);
@@ -929,13 +930,17 @@ csi_dispatch(struct terminal *term, uint8_t final)
                             continue;
                     }
 
-                    if (term->render.last_cursor.row == term->grid->rows[i])
+                    struct row *row = grid_ring_get(term->grid, i);
+                    if (term->render.last_cursor.row == row)
                         term->render.last_cursor.row = NULL;
 
-                    grid_row_free(term->grid->rows[i]);
-                    term->grid->rows[i] = NULL;
+                    grid_row_free(term->grid, row);
+                    grid_ring_set(term->grid, i, NULL);
                 }
                 term->grid->view = term->grid->offset;
+                if (term->grid == &term->normal)
+                    term_spill_reset(term);
+                grid_release_chunks(term->grid);
                 term_damage_view(term);
                 break;
             }
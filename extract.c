@@ -4,6 +4,7 @@
 #define LOG_MODULE "extract"
 #define LOG_ENABLE_DBG 1
 #include "log.h"
+#include "util.h"
 
 struct extraction_context {
     wchar_t *buf;
@@ -145,9 +146,10 @@ out:
     return ret;
 }
 
-bool
-extract_one(const struct terminal *term, const struct row *row,
-            const struct cell *cell, int col, void *context)
+static bool
+extract_cell(const struct terminal *term, const struct row *row,
+             const struct cell *cell, const struct composed *composed,
+             int col, void *context)
 {
     struct extraction_context *ctx = context;
 
@@ -223,12 +225,7 @@ extract_one(const struct terminal *term, const struct row *row,
     ctx->newline_count = 0;
     ctx->empty_count = 0;
 
-    if (cell->wc >= CELL_COMB_CHARS_LO &&
-        cell->wc < (CELL_COMB_CHARS_LO + term->composed_count))
-    {
-        const struct composed *composed
-            = &term->composed[cell->wc - CELL_COMB_CHARS_LO];
-
+    if (composed != NULL) {
         if (!ensure_size(ctx, 1 + composed->count))
             goto err;
 
@@ -243,7 +240,8 @@ extract_one(const struct terminal *term, const struct row *row,
         ctx->buf[ctx->idx++] = cell->wc;
 
         if (cell->wc == L'\t') {
-            int next_tab_stop = term->cols - 1;
+            /* Spilled lines may be wider than the window */
+            int next_tab_stop = max(term->cols - 1, col);
             tll_foreach(term->tab_stops, it) {
                 if (it->item > col) {
                     next_tab_stop = it->item;
@@ -264,3 +262,26 @@ err:
     ctx->failed = true;
     return false;
 }
+
+bool
+extract_one(const struct terminal *term, const struct row *row,
+            const struct cell *cell, int col, void *context)
+{
+    const struct composed *composed = NULL;
+
+    if (cell->wc >= CELL_COMB_CHARS_LO &&
+        cell->wc < (CELL_COMB_CHARS_LO + term->composed_count))
+    {
+        composed = &term->composed[cell->wc - CELL_COMB_CHARS_LO];
+    }
+
+    return extract_cell(term, row, cell, composed, col, context);
+}
+
+bool
+extract_one_composed(const struct terminal *term, const struct row *row,
+                     const struct cell *cell, const struct composed *composed,
+                     int col, void *context)
+{
+    return extract_cell(term, row, cell, composed, col, context);
+}
@@ -15,6 +15,15 @@ bool extract_one(
     const struct terminal *term, const struct row *row, const struct cell *cell,
     int col, void *context);
 
+/*
+ * Like extract_one(), but with the composed characters of 'cell'
+ * given by 'composed' (NULL if it has none), rather than looked up in
+ * the terminal's table
+ */
+bool extract_one_composed(
+    const struct terminal *term, const struct row *row, const struct cell *cell,
+    const struct composed *composed, int col, void *context);
+
 bool extract_finish(
     struct extraction_context *context, char **text, size_t *len);
 bool extract_finish_wide(
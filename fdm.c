@@ -7,8 +7,13 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <time.h>
+#include <threads.h>
+#include <stdatomic.h>
 
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 
 #include <tllist.h>
 
@@ -23,6 +28,7 @@ struct fd_handler {
     int events;
     fdm_fd_handler_t callback;
     void *callback_data;
+    bool low_priority;
     bool deleted;
 };
 
@@ -38,9 +44,23 @@ struct hook {
 
 typedef tll(struct hook) hooks_t;
 
+struct fdm_timer {
+    uint64_t expires;       /* CLOCK_MONOTONIC, in ns; 0 when disarmed */
+    uint64_t interval;
+    size_t heap_idx;
+    fdm_timer_handler_t callback;
+    void *callback_data;
+};
+
 struct fdm {
     int epoll_fd;
     bool is_polling;
+
+    /* Held by the main thread, except while it is waiting for events */
+    mtx_t lock;
+    int wake_fd;
+    atomic_bool wake_pending;
+
     tll(struct fd_handler *) fds;
     tll(struct fd_handler *) deferred_delete;
 
@@ -50,11 +70,26 @@ struct fdm {
     hooks_t hooks_low;
     hooks_t hooks_normal;
     hooks_t hooks_high;
+
+    struct {
+        int fd;
+        uint64_t programmed;        /* What 'fd' is armed with; 0 if disarmed */
+        bool dispatching;
+        size_t live;                /* Added, but not yet deleted */
+
+        /* Armed timers, min-heap ordered by expiry */
+        struct fdm_timer **heap;
+        size_t count;
+        size_t size;
+    } timers;
 };
 
 static volatile sig_atomic_t got_signal = false;
 static volatile sig_atomic_t *received_signals = NULL;
 
+static bool fdm_timers_expired(struct fdm *fdm, int fd, int events, void *data);
+static bool fdm_woken(struct fdm *fdm, int fd, int events, void *data);
+
 struct fdm *
 fdm_init(void)
 {
@@ -88,6 +123,23 @@ fdm_init(void)
         return NULL;
     }
 
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (timer_fd < 0) {
+        LOG_ERRNO("failed to create timer FD");
+        free(sig_handlers);
+        free(fdm);
+        return NULL;
+    }
+
+    int wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wake_fd < 0) {
+        LOG_ERRNO("failed to create wake-up event FD");
+        close(timer_fd);
+        free(sig_handlers);
+        free(fdm);
+        return NULL;
+    }
+
     *fdm = (struct fdm){
         .epoll_fd = epoll_fd,
         .is_polling = false,
@@ -98,7 +150,40 @@ fdm_init(void)
         .hooks_low = tll_init(),
         .hooks_normal = tll_init(),
         .hooks_high = tll_init(),
+        .wake_fd = wake_fd,
+        .wake_pending = false,
+        .timers = {.fd = timer_fd},
     };
+
+    if (mtx_init(&fdm->lock, mtx_plain) != thrd_success) {
+        LOG_ERR("failed to initialize FDM lock");
+        close(wake_fd);
+        close(timer_fd);
+        free(sig_handlers);
+        free(fdm);
+        return NULL;
+    }
+
+    if (!fdm_add(fdm, timer_fd, EPOLLIN, &fdm_timers_expired, NULL)) {
+        close(wake_fd);
+        close(timer_fd);
+        mtx_destroy(&fdm->lock);
+        free(sig_handlers);
+        free(fdm);
+        return NULL;
+    }
+
+    if (!fdm_add(fdm, wake_fd, EPOLLIN, &fdm_woken, NULL)) {
+        fdm_del(fdm, timer_fd);
+        close(wake_fd);
+        mtx_destroy(&fdm->lock);
+        free(sig_handlers);
+        free(fdm);
+        return NULL;
+    }
+
+    /* The calling thread is the main thread */
+    mtx_lock(&fdm->lock);
     return fdm;
 }
 
@@ -108,9 +193,15 @@ fdm_destroy(struct fdm *fdm)
     if (fdm == NULL)
         return;
 
+    fdm_del(fdm, fdm->timers.fd);
+    fdm_del(fdm, fdm->wake_fd);
+
     if (tll_length(fdm->fds) > 0)
         LOG_WARN("FD list not empty");
 
+    if (fdm->timers.live > 0)
+        LOG_WARN("timer list not empty");
+
     for (int i = 0; i < SIGRTMAX; i++) {
         if (fdm->signal_handlers[i].callback != NULL)
             LOG_WARN("handler for signal %d not removed", i);
@@ -128,6 +219,7 @@ fdm_destroy(struct fdm *fdm)
     xassert(tll_length(fdm->hooks_low) == 0);
     xassert(tll_length(fdm->hooks_normal) == 0);
     xassert(tll_length(fdm->hooks_high) == 0);
+    xassert(fdm->timers.live == 0);
 
     sigprocmask(SIG_SETMASK, &fdm->sigmask, NULL);
     free(fdm->signal_handlers);
@@ -137,7 +229,10 @@ fdm_destroy(struct fdm *fdm)
     tll_free(fdm->hooks_low);
     tll_free(fdm->hooks_normal);
     tll_free(fdm->hooks_high);
+    free(fdm->timers.heap);
     close(fdm->epoll_fd);
+    mtx_unlock(&fdm->lock);
+    mtx_destroy(&fdm->lock);
     free(fdm);
 
     free((void *)received_signals);
@@ -166,6 +261,7 @@ fdm_add(struct fdm *fdm, int fd, int events, fdm_fd_handler_t cb, void *data)
         .events = events,
         .callback = cb,
         .callback_data = data,
+        .low_priority = false,
         .deleted = false,
     };
 
@@ -278,6 +374,21 @@ fdm_event_del(struct fdm *fdm, int fd, int events)
     return false;
 }
 
+bool
+fdm_set_low_priority(struct fdm *fdm, int fd)
+{
+    tll_foreach(fdm->fds, it) {
+        if (it->item->fd != fd)
+            continue;
+
+        it->item->low_priority = true;
+        return true;
+    }
+
+    LOG_ERR("FD=%d not registered with the FDM", fd);
+    return false;
+}
+
 static hooks_t *
 hook_priority_to_list(struct fdm *fdm, enum fdm_hook_priority priority)
 {
@@ -391,6 +502,275 @@ fdm_signal_del(struct fdm *fdm, int signo)
     return true;
 }
 
+static uint64_t
+now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void
+heap_swap(struct fdm *fdm, size_t a, size_t b)
+{
+    struct fdm_timer **heap = fdm->timers.heap;
+    struct fdm_timer *tmp = heap[a];
+
+    heap[a] = heap[b];
+    heap[b] = tmp;
+    heap[a]->heap_idx = a;
+    heap[b]->heap_idx = b;
+}
+
+static void
+heap_sift_up(struct fdm *fdm, size_t idx)
+{
+    struct fdm_timer **heap = fdm->timers.heap;
+
+    while (idx > 0) {
+        size_t parent = (idx - 1) / 2;
+        if (heap[parent]->expires <= heap[idx]->expires)
+            break;
+
+        heap_swap(fdm, idx, parent);
+        idx = parent;
+    }
+}
+
+static void
+heap_sift_down(struct fdm *fdm, size_t idx)
+{
+    struct fdm_timer **heap = fdm->timers.heap;
+    const size_t count = fdm->timers.count;
+
+    while (true) {
+        size_t smallest = idx;
+        size_t left = 2 * idx + 1;
+        size_t right = left + 1;
+
+        if (left < count && heap[left]->expires < heap[smallest]->expires)
+            smallest = left;
+        if (right < count && heap[right]->expires < heap[smallest]->expires)
+            smallest = right;
+
+        if (smallest == idx)
+            break;
+
+        heap_swap(fdm, idx, smallest);
+        idx = smallest;
+    }
+}
+
+static void
+heap_insert(struct fdm *fdm, struct fdm_timer *timer)
+{
+    if (fdm->timers.count >= fdm->timers.size) {
+        fdm->timers.size = fdm->timers.size > 0 ? fdm->timers.size * 2 : 16;
+        fdm->timers.heap = xrealloc(
+            fdm->timers.heap, fdm->timers.size * sizeof(fdm->timers.heap[0]));
+    }
+
+    timer->heap_idx = fdm->timers.count++;
+    fdm->timers.heap[timer->heap_idx] = timer;
+    heap_sift_up(fdm, timer->heap_idx);
+}
+
+static void
+heap_remove(struct fdm *fdm, struct fdm_timer *timer)
+{
+    const size_t idx = timer->heap_idx;
+    const size_t last = --fdm->timers.count;
+
+    xassert(fdm->timers.heap[idx] == timer);
+
+    if (idx != last) {
+        heap_swap(fdm, idx, last);
+        heap_sift_up(fdm, idx);
+        heap_sift_down(fdm, idx);
+    }
+
+    timer->expires = 0;
+}
+
+/*
+ * Arms the timer FD with the first timer's expiry, unless it is
+ * already armed to expire before that.
+ *
+ * When a timer is pushed forward (the common case, e.g. the delayed
+ * rendering timers, re-armed on every PTY read), this means the FD
+ * may expire early. We then simply re-arm it, from the FD handler.
+ */
+static bool
+timers_reprogram(struct fdm *fdm)
+{
+    if (fdm->timers.dispatching || fdm->timers.count == 0)
+        return true;
+
+    const uint64_t next = fdm->timers.heap[0]->expires;
+    if (fdm->timers.programmed != 0 && fdm->timers.programmed <= next)
+        return true;
+
+    struct itimerspec alarm = {
+        .it_value = {
+            .tv_sec = next / 1000000000,
+            .tv_nsec = next % 1000000000,
+        },
+    };
+
+    if (timerfd_settime(fdm->timers.fd, TFD_TIMER_ABSTIME, &alarm, NULL) < 0) {
+        LOG_ERRNO("failed to arm timer FD");
+        return false;
+    }
+
+    fdm->timers.programmed = next;
+    return true;
+}
+
+static bool
+fdm_timers_expired(struct fdm *fdm, int fd, int events, void *data)
+{
+    if (events & EPOLLHUP)
+        return false;
+
+    uint64_t unused;
+    ssize_t ret = read(fd, &unused, sizeof(unused));
+
+    if (ret < 0 && errno != EAGAIN) {
+        LOG_ERRNO("failed to read timer FD");
+        return false;
+    }
+
+    fdm->timers.programmed = 0;
+    fdm->timers.dispatching = true;
+
+    const uint64_t now = now_ns();
+    bool success = true;
+
+    while (fdm->timers.count > 0 && fdm->timers.heap[0]->expires <= now) {
+        struct fdm_timer *timer = fdm->timers.heap[0];
+        uint64_t expirations = 1;
+
+        if (timer->interval > 0) {
+            expirations += (now - timer->expires) / timer->interval;
+            timer->expires += expirations * timer->interval;
+            heap_sift_down(fdm, 0);
+        } else
+            heap_remove(fdm, timer);
+
+        LOG_DBG("timer %p expired %llu times",
+                (void *)timer, (unsigned long long)expirations);
+
+        /* Note: the handler may delete, or re-arm, the timer */
+        if (!timer->callback(fdm, timer, expirations, timer->callback_data)) {
+            success = false;
+            break;
+        }
+    }
+
+    fdm->timers.dispatching = false;
+    return timers_reprogram(fdm) && success;
+}
+
+struct fdm_timer *
+fdm_timer_add(struct fdm *fdm, fdm_timer_handler_t handler, void *data)
+{
+    struct fdm_timer *timer = xmalloc(sizeof(*timer));
+    *timer = (struct fdm_timer){
+        .callback = handler,
+        .callback_data = data,
+    };
+
+    fdm->timers.live++;
+    return timer;
+}
+
+bool
+fdm_timer_del(struct fdm *fdm, struct fdm_timer *timer)
+{
+    if (timer == NULL)
+        return true;
+
+    if (timer->expires != 0)
+        heap_remove(fdm, timer);
+
+    xassert(fdm->timers.live > 0);
+    fdm->timers.live--;
+    free(timer);
+    return true;
+}
+
+bool
+fdm_timer_set(struct fdm *fdm, struct fdm_timer *timer,
+              uint64_t value_ns, uint64_t interval_ns)
+{
+    const bool was_armed = timer->expires != 0;
+
+    timer->interval = interval_ns;
+
+    if (value_ns == 0) {
+        if (was_armed)
+            heap_remove(fdm, timer);
+        return true;
+    }
+
+    timer->expires = now_ns() + value_ns;
+
+    if (was_armed) {
+        heap_sift_up(fdm, timer->heap_idx);
+        heap_sift_down(fdm, timer->heap_idx);
+    } else
+        heap_insert(fdm, timer);
+
+    return timers_reprogram(fdm);
+}
+
+uint64_t
+fdm_timer_remaining(const struct fdm_timer *timer)
+{
+    if (timer->expires == 0)
+        return 0;
+
+    const uint64_t now = now_ns();
+    return timer->expires > now ? timer->expires - now : 1;
+}
+
+void
+fdm_lock(struct fdm *fdm)
+{
+    mtx_lock(&fdm->lock);
+}
+
+void
+fdm_unlock(struct fdm *fdm)
+{
+    mtx_unlock(&fdm->lock);
+}
+
+static bool
+fdm_woken(struct fdm *fdm, int fd, int events, void *data)
+{
+    uint64_t unused;
+    ssize_t ret = read(fd, &unused, sizeof(unused));
+
+    if (ret < 0 && errno != EAGAIN) {
+        LOG_ERRNO("failed to read wake-up event FD");
+        return false;
+    }
+
+    atomic_store(&fdm->wake_pending, false);
+    return true;
+}
+
+void
+fdm_wake(struct fdm *fdm)
+{
+    if (atomic_exchange(&fdm->wake_pending, true))
+        return;
+
+    if (write(fdm->wake_fd, &(uint64_t){1}, sizeof(uint64_t)) < 0)
+        LOG_ERRNO("failed to wake up the FDM");
+}
+
 bool
 fdm_poll(struct fdm *fdm)
 {
@@ -424,10 +804,21 @@ fdm_poll(struct fdm *fdm)
 
     struct epoll_event events[tll_length(fdm->fds)];
 
+    /*
+     * Other threads may take the lock while we're waiting. Any FDs
+     * they delete in the meantime must outlive the events we're about
+     * to receive, hence 'is_polling'.
+     */
+    fdm->is_polling = true;
+    mtx_unlock(&fdm->lock);
+
     int r = epoll_pwait(
         fdm->epoll_fd, events, tll_length(fdm->fds), -1, &fdm->sigmask);
 
     int errno_copy = errno;
+    mtx_lock(&fdm->lock);
+
+    bool ret = true;
 
     if (unlikely(got_signal)) {
         got_signal = false;
@@ -438,33 +829,38 @@ fdm_poll(struct fdm *fdm)
                 struct sig_handler *handler = &fdm->signal_handlers[i];
 
                 xassert(handler->callback != NULL);
-                if (!handler->callback(fdm, i, handler->callback_data))
-                    return false;
+                if (!handler->callback(fdm, i, handler->callback_data)) {
+                    ret = false;
+                    goto out;
+                }
             }
         }
     }
 
     if (unlikely(r < 0)) {
-        if (errno_copy == EINTR)
-            return true;
-
-        LOG_ERRNO_P(errno_copy, "failed to epoll");
-        return false;
+        if (errno_copy != EINTR) {
+            LOG_ERRNO_P(errno_copy, "failed to epoll");
+            ret = false;
+        }
+        goto out;
     }
 
-    bool ret = true;
+    for (int pass = 0; pass < 2 && ret; pass++) {
+        const bool low_priority = pass == 1;
 
-    fdm->is_polling = true;
-    for (int i = 0; i < r; i++) {
-        struct fd_handler *fd = events[i].data.ptr;
-        if (fd->deleted)
-            continue;
+        for (int i = 0; i < r; i++) {
+            struct fd_handler *fd = events[i].data.ptr;
+            if (fd->deleted || fd->low_priority != low_priority)
+                continue;
 
-        if (!fd->callback(fdm, fd->fd, events[i].events, fd->callback_data)) {
-            ret = false;
-            break;
+            if (!fd->callback(fdm, fd->fd, events[i].events, fd->callback_data)) {
+                ret = false;
+                break;
+            }
         }
     }
+
+out:
     fdm->is_polling = false;
 
     tll_foreach(fdm->deferred_delete, it) {
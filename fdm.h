@@ -1,12 +1,16 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 
 struct fdm;
+struct fdm_timer;
 
 typedef bool (*fdm_fd_handler_t)(struct fdm *fdm, int fd, int events, void *data);
 typedef bool (*fdm_signal_handler_t)(struct fdm *fdm, int signo, void *data);
 typedef void (*fdm_hook_t)(struct fdm *fdm, void *data);
+typedef bool (*fdm_timer_handler_t)(
+    struct fdm *fdm, struct fdm_timer *timer, uint64_t expirations, void *data);
 
 enum fdm_hook_priority {
     FDM_HOOK_PRIORITY_LOW,
@@ -24,6 +28,13 @@ bool fdm_del_no_close(struct fdm *fdm, int fd);
 bool fdm_event_add(struct fdm *fdm, int fd, int events);
 bool fdm_event_del(struct fdm *fdm, int fd, int events);
 
+/*
+ * Low priority FDs are dispatched after all other FDs that are ready
+ * in the same fdm_poll() iteration. Meant for bulk work, like parsing
+ * PTY output, that shouldn't delay e.g. input handling.
+ */
+bool fdm_set_low_priority(struct fdm *fdm, int fd);
+
 bool fdm_hook_add(struct fdm *fdm, fdm_hook_t hook, void *data,
                   enum fdm_hook_priority priority);
 bool fdm_hook_del(struct fdm *fdm, fdm_hook_t hook, enum fdm_hook_priority priority);
@@ -31,4 +42,35 @@ bool fdm_hook_del(struct fdm *fdm, fdm_hook_t hook, enum fdm_hook_priority prior
 bool fdm_signal_add(struct fdm *fdm, int signo, fdm_signal_handler_t handler, void *data);
 bool fdm_signal_del(struct fdm *fdm, int signo);
 
+/*
+ * Timers are multiplexed onto a single timer FD, and (re-)arming
+ * them is, in the common case, done without any system calls.
+ *
+ * A timer is initially disarmed. 'value_ns' is the time until it
+ * expires; zero disarms it. A non-zero 'interval_ns' makes it
+ * periodic. 'expirations', passed to the handler, is the number of
+ * times the timer expired since the handler was last called.
+ */
+struct fdm_timer *fdm_timer_add(
+    struct fdm *fdm, fdm_timer_handler_t handler, void *data);
+bool fdm_timer_del(struct fdm *fdm, struct fdm_timer *timer);
+bool fdm_timer_set(struct fdm *fdm, struct fdm_timer *timer,
+                   uint64_t value_ns, uint64_t interval_ns);
+
+/* Time until the timer expires, or 0 if it is disarmed */
+uint64_t fdm_timer_remaining(const struct fdm_timer *timer);
+
+/*
+ * The main thread, i.e. the one that called fdm_init(), holds the FDM
+ * lock at all times, except while fdm_poll() is waiting for events.
+ * Other threads must hold it while touching anything owned by the
+ * main thread.
+ *
+ * fdm_wake() makes a waiting fdm_poll() return, running all hooks
+ * again. It may be called without holding the lock.
+ */
+void fdm_lock(struct fdm *fdm);
+void fdm_unlock(struct fdm *fdm);
+void fdm_wake(struct fdm *fdm);
+
 bool fdm_poll(struct fdm *fdm);
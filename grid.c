@@ -15,6 +15,526 @@
 
 #define TIME_REFLOW 0
 
+static void
+cell_slab_init(struct slab *slab, int cols)
+{
+    slab_init(slab, cols * sizeof(struct cell));
+}
+
+struct row *grid_empty_chunk[GRID_CHUNK_SIZE];
+
+static int
+chunk_count(int num_rows)
+{
+    return (num_rows + GRID_CHUNK_SIZE - 1) >> GRID_CHUNK_SHIFT;
+}
+
+/* A chunk directory for a ring of 'num_rows' (empty) slots */
+static struct row ***
+chunks_alloc(int num_rows)
+{
+    const int count = chunk_count(num_rows);
+    struct row ***chunks = xmalloc(max(count, 1) * sizeof(chunks[0]));
+
+    for (int i = 0; i < count; i++)
+        chunks[i] = grid_empty_chunk;
+    return chunks;
+}
+
+static void
+chunks_free(struct row ***chunks, int num_rows)
+{
+    if (chunks == NULL)
+        return;
+
+    for (int i = 0; i < chunk_count(num_rows); i++) {
+        if (chunks[i] != grid_empty_chunk)
+            free(chunks[i]);
+    }
+    free(chunks);
+}
+
+static inline struct row *
+chunks_get(struct row **const *chunks, int row_idx)
+{
+    return chunks[row_idx >> GRID_CHUNK_SHIFT][row_idx & (GRID_CHUNK_SIZE - 1)];
+}
+
+static inline void
+chunks_set(struct row ***chunks, int row_idx, struct row *row)
+{
+    struct row ***chunk = &chunks[row_idx >> GRID_CHUNK_SHIFT];
+    if (*chunk == grid_empty_chunk) {
+        if (row == NULL)
+            return;
+        grid_chunk_alloc(chunk);
+    }
+
+    (*chunk)[row_idx & (GRID_CHUNK_SIZE - 1)] = row;
+}
+
+void
+grid_chunk_alloc(struct row ***chunk)
+{
+    xassert(*chunk == grid_empty_chunk);
+    *chunk = xcalloc(GRID_CHUNK_SIZE, sizeof((*chunk)[0]));
+}
+
+void
+grid_ring_init(struct grid *grid, int num_rows)
+{
+    xassert(grid->chunks == NULL);
+
+    grid->num_rows = num_rows;
+    grid->chunks = chunks_alloc(num_rows);
+}
+
+void
+grid_release_chunks(struct grid *grid)
+{
+    for (int i = 0; i < chunk_count(grid->num_rows); i++) {
+        struct row **chunk = grid->chunks[i];
+        if (chunk == grid_empty_chunk)
+            continue;
+
+        bool empty = true;
+        for (int j = 0; j < GRID_CHUNK_SIZE && empty; j++)
+            empty = chunk[j] == NULL;
+
+        if (empty) {
+            free(chunk);
+            grid->chunks[i] = grid_empty_chunk;
+        }
+    }
+}
+
+/*
+ * How grid_resize_ring() moves the rows: they keep their order, with
+ * the first slot below the screen moving from 'old_start' to
+ * 'new_start', and the rows following it by 'count' more.
+ */
+struct ring_move {
+    int old_start;
+    int old_rows;
+    int new_start;
+    int new_rows;
+    int count;
+};
+
+/* Position of the row, counted from the first slot below the screen */
+static int
+ring_move_age(const struct ring_move *move, int row_idx)
+{
+    return (row_idx - move->old_start + move->old_rows) % move->old_rows;
+}
+
+static int
+ring_move_row(const struct ring_move *move, int row_idx)
+{
+    const int age = ring_move_age(move, row_idx);
+    xassert(age >= -move->count);
+    return (move->new_start + age + move->count) % move->new_rows;
+}
+
+void
+grid_resize_ring(
+    struct grid *grid, int count, int screen_rows,
+    size_t tracking_points_count,
+    struct coord *const tracking_points[static tracking_points_count])
+{
+    const struct ring_move move = {
+        .old_start = grid_row_absolute(grid, screen_rows),
+        .old_rows = grid->num_rows,
+        .new_start = grid_row_absolute(grid, screen_rows) %
+                     (grid->num_rows + count),
+        .new_rows = grid->num_rows + count,
+        .count = count,
+    };
+
+    xassert(move.new_rows >= screen_rows);
+
+    /* Removed slots are the first ones below the screen */
+    const int removed = max(-count, 0);
+
+    struct row ***new_grid = chunks_alloc(move.new_rows);
+
+    for (int age = 0; age < move.old_rows; age++) {
+        const int idx = (move.old_start + age) % move.old_rows;
+        struct row *row = grid_ring_get(grid, idx);
+
+        if (row == NULL)
+            continue;
+
+        xassert(age >= removed);
+        chunks_set(new_grid, ring_move_row(&move, idx), row);
+    }
+
+    /* Rows decompressed on demand; empty slots are simply dropped */
+    size_t kept = 0;
+    for (size_t i = 0; i < grid->decompressed.count; i++) {
+        const int idx = grid->decompressed.idx[i];
+        if (ring_move_age(&move, idx) >= removed &&
+            grid_ring_get(grid, idx) != NULL)
+        {
+            grid->decompressed.idx[kept++] = ring_move_row(&move, idx);
+        }
+    }
+    grid->decompressed.count = kept;
+
+    tll_foreach(grid->sixel_images, it) {
+        if (ring_move_age(&move, it->item.pos.row) < removed) {
+            sixel_destroy(&it->item);
+            tll_remove(grid->sixel_images, it);
+        } else
+            it->item.pos.row = ring_move_row(&move, it->item.pos.row);
+    }
+
+    /*
+     * Tracking points on removed slots are moved to the oldest row.
+     * Selection coordinates may be beyond the ring's size (see
+     * selection_view_up()); they stay so.
+     */
+    for (size_t i = 0; i < tracking_points_count; i++) {
+        struct coord *tp = tracking_points[i];
+        if (tp->row < 0)
+            continue;
+
+        const bool unwrapped = tp->row >= move.old_rows;
+        int row = tp->row % move.old_rows;
+
+        if (ring_move_age(&move, row) < removed) {
+            row = (move.old_start + removed) % move.old_rows;
+            tp->col = 0;
+        }
+
+        tp->row = ring_move_row(&move, row) + (unwrapped ? move.new_rows : 0);
+    }
+
+    grid->offset = ring_move_row(&move, grid->offset);
+    grid->view = ring_move_row(&move, grid->view);
+
+    chunks_free(grid->chunks, grid->num_rows);
+    grid->chunks = new_grid;
+    grid->num_rows = move.new_rows;
+}
+
+/* Frees everything owned by the row, except its slab blocks */
+static void
+row_free_data(struct row *row)
+{
+    grid_row_reset_extra(row);
+    free(row->extra);
+    free(row->compressed);
+}
+
+/*
+ * A compressed row. The attributes are stored as runs of identical
+ * attributes (ignoring the 'clean' bit), covering all columns. They
+ * are followed by the text of the row, up to, and including, its last
+ * non-empty cell. Each character is stored as a variable length
+ * integer; 7 bits per byte, least significant bits first, with the
+ * MSB set on all but the last byte.
+ */
+struct attr_run {
+    uint32_t count;
+    struct cell_attrs attrs;
+};
+
+struct row_compressed {
+    uint32_t size;      /* Total size, in bytes, including this header */
+    uint32_t cols;
+    uint32_t chars;     /* Number of cells with stored text */
+    uint32_t composed;  /* Number of cells with composed characters */
+    uint32_t run_count;
+    struct attr_run runs[];
+};
+
+/* The attributes, as an integer, with the 'clean' bit masked out */
+static inline uint32_t
+attrs_key(const struct cell_attrs *attrs)
+{
+    static const struct cell_attrs clean = {.clean = true};
+
+    uint32_t key, mask;
+    memcpy(&key, attrs, sizeof(key));
+    memcpy(&mask, &clean, sizeof(mask));
+    return key & ~mask;
+}
+
+static void
+row_compress(struct slab *cell_slab, int cols, struct row *row)
+{
+    const struct cell *cells = row->cells;
+
+    xassert(cols > 0);
+
+    int chars = cols;
+    while (chars > 0 && cells[chars - 1].wc == 0)
+        chars--;
+
+    /* Encode into scratch buffers, then copy to an exactly sized blob */
+    struct attr_run runs[cols];
+    uint8_t text[chars * 5 + 1];
+
+    size_t run_count = 0;
+    int run_start = 0;
+    uint32_t run_key = attrs_key(&cells[0].attrs);
+
+    for (int c = 1; c < cols; c++) {
+        const uint32_t key = attrs_key(&cells[c].attrs);
+        if (likely(key == run_key))
+            continue;
+
+        runs[run_count++] = (struct attr_run){
+            .count = c - run_start,
+            .attrs = cells[run_start].attrs,
+        };
+
+        run_start = c;
+        run_key = key;
+    }
+
+    runs[run_count++] = (struct attr_run){
+        .count = cols - run_start,
+        .attrs = cells[run_start].attrs,
+    };
+
+    uint8_t *p = text;
+    uint32_t composed = 0;
+    for (int c = 0; c < chars; c++) {
+        uint32_t v = cells[c].wc;
+        if (v >= CELL_COMB_CHARS_LO && v <= CELL_COMB_CHARS_HI)
+            composed++;
+
+        while (v >= 0x80) {
+            *p++ = (v & 0x7f) | 0x80;
+            v >>= 7;
+        }
+        *p++ = v;
+    }
+
+    const size_t text_size = p - text;
+    const size_t size = sizeof(struct row_compressed) +
+                        run_count * sizeof(runs[0]) +
+                        text_size;
+
+    struct row_compressed *comp = xmalloc(size);
+    *comp = (struct row_compressed){
+        .size = size,
+        .cols = cols,
+        .chars = chars,
+        .composed = composed,
+        .run_count = run_count,
+    };
+
+    memcpy(comp->runs, runs, run_count * sizeof(runs[0]));
+    memcpy(&comp->runs[run_count], text, text_size);
+
+    for (size_t i = 0; i < run_count; i++)
+        comp->runs[i].attrs.clean = false;
+
+    slab_free(cell_slab, row->cells);
+    row->cells = NULL;
+    row->compressed = comp;
+}
+
+/* Decodes the next character of a compressed row's text */
+static inline uint32_t
+text_next(const uint8_t **text)
+{
+    uint32_t v = 0;
+    for (int shift = 0; ; shift += 7) {
+        const uint8_t b = *(*text)++;
+        v |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return v;
+    }
+}
+
+void
+grid_row_decode(const struct row *row, struct cell cells[])
+{
+    const struct row_compressed *comp = row->compressed;
+    xassert(comp != NULL);
+
+    for (uint32_t i = 0, c = 0; i < comp->run_count; i++) {
+        const struct attr_run *run = &comp->runs[i];
+        for (uint32_t j = 0; j < run->count; j++, c++)
+            cells[c].attrs = run->attrs;
+    }
+
+    const uint8_t *text = (const uint8_t *)&comp->runs[comp->run_count];
+    uint32_t c = 0;
+
+    for (; c < comp->chars; c++)
+        cells[c].wc = text_next(&text);
+
+    for (; c < comp->cols; c++)
+        cells[c].wc = 0;
+}
+
+void
+grid_mark_attrs(const struct grid *grid, bool used[], size_t count)
+{
+    for (int r = 0; r < grid->num_rows; r++) {
+        const struct row *row = grid_ring_get(grid, r);
+        if (row == NULL)
+            continue;
+
+        if (row->cells == NULL) {
+            const struct row_compressed *comp = row->compressed;
+            for (uint32_t i = 0; i < comp->run_count; i++) {
+                const uint32_t idx = comp->runs[i].attrs.idx;
+                if (idx < count)
+                    used[idx] = true;
+            }
+            continue;
+        }
+
+        for (int c = 0; c < grid->num_cols; c++) {
+            const uint32_t idx = row->cells[c].attrs.idx;
+            if (idx < count)
+                used[idx] = true;
+        }
+    }
+}
+
+static inline void
+mark_composed(wchar_t wc, bool used[], size_t count)
+{
+    if (wc >= CELL_COMB_CHARS_LO && wc < CELL_COMB_CHARS_LO + count)
+        used[wc - CELL_COMB_CHARS_LO] = true;
+}
+
+void
+grid_mark_composed(const struct grid *grid, bool used[], size_t count)
+{
+    for (int r = 0; r < grid->num_rows; r++) {
+        const struct row *row = grid_ring_get(grid, r);
+        if (row == NULL)
+            continue;
+
+        if (row->cells == NULL) {
+            const struct row_compressed *comp = row->compressed;
+            if (comp->composed == 0)
+                continue;
+
+            const uint8_t *text = (const uint8_t *)&comp->runs[comp->run_count];
+            for (uint32_t c = 0; c < comp->chars; c++)
+                mark_composed(text_next(&text), used, count);
+            continue;
+        }
+
+        for (int c = 0; c < grid->num_cols; c++)
+            mark_composed(row->cells[c].wc, used, count);
+    }
+}
+
+static void
+remember_decompressed(struct grid *grid, int row_idx)
+{
+    if (grid->decompressed.count >= grid->decompressed.size) {
+        size_t new_size = grid->decompressed.size > 0
+            ? grid->decompressed.size * 2 : 64;
+        grid->decompressed.idx = xrealloc(
+            grid->decompressed.idx,
+            new_size * sizeof(grid->decompressed.idx[0]));
+        grid->decompressed.size = new_size;
+    }
+
+    grid->decompressed.idx[grid->decompressed.count++] = row_idx;
+}
+
+static void
+row_decompress(struct slab *cell_slab, struct row *row)
+{
+    xassert(row->cells == NULL);
+
+    row->cells = slab_alloc(cell_slab);
+    grid_row_decode(row, row->cells);
+
+    free(row->compressed);
+    row->compressed = NULL;
+
+    /* Decoded cells are never clean */
+    row->dirty = true;
+}
+
+void
+grid_row_decompress(struct grid *grid, int row_idx)
+{
+    struct row *row = grid_ring_get(grid, row_idx);
+    xassert(row->compressed->cols == grid->num_cols);
+
+    row_decompress(&grid->cell_slab, row);
+    remember_decompressed(grid, row_idx);
+}
+
+void
+grid_row_discard_compressed(struct grid *grid, struct row *row)
+{
+    xassert(row->cells == NULL);
+
+    free(row->compressed);
+    row->compressed = NULL;
+    row->dirty = true;
+    row->cells = slab_alloc(&grid->cell_slab);
+}
+
+static bool
+row_is_cold(const struct grid *grid, int row_idx, int screen_rows)
+{
+    /* Number of lines above the screen's first line */
+    const int rel = grid_row_wrap(grid, row_idx - grid->offset);
+    const int age = grid->num_rows - rel;
+
+    return rel >= screen_rows && age > screen_rows;
+}
+
+static bool
+row_is_in_view(const struct grid *grid, int row_idx, int screen_rows)
+{
+    return grid_row_wrap(grid, row_idx - grid->view) < screen_rows;
+}
+
+/* Compresses the row, if cold. Returns false if cold, but in the view */
+static bool
+maybe_compress(struct grid *grid, int row_idx, int screen_rows)
+{
+    struct row *row = grid_ring_get(grid, row_idx);
+
+    if (row == NULL || row->cells == NULL)
+        return true;
+    if (!row_is_cold(grid, row_idx, screen_rows))
+        return true;
+    if (row_is_in_view(grid, row_idx, screen_rows))
+        return false;
+
+    row_compress(&grid->cell_slab, grid->num_cols, row);
+    return true;
+}
+
+void
+grid_compress_scrollback(struct grid *grid, int screen_rows, int scrolled)
+{
+    /* Rows that just became cold */
+    int idx = grid_row_absolute(grid, -screen_rows);
+    for (int i = 1; i <= scrolled; i++) {
+        idx = grid_row_wrap(grid, idx - 1);
+        if (!maybe_compress(grid, idx, screen_rows))
+            remember_decompressed(grid, idx);
+    }
+
+    /* Compress rows decompressed on demand again, unless still in view */
+    size_t kept = 0;
+    for (size_t i = 0; i < grid->decompressed.count; i++) {
+        const int idx = grid->decompressed.idx[i];
+        if (!maybe_compress(grid, idx, screen_rows))
+            grid->decompressed.idx[kept++] = idx;
+    }
+    grid->decompressed.count = kept;
+}
+
 struct grid *
 grid_snapshot(const struct grid *grid)
 {
@@ -24,28 +544,39 @@ grid_snapshot(const struct grid *grid)
     clone->offset = grid->offset;
     clone->view = grid->view;
     clone->cursor = grid->cursor;
-    clone->rows = xcalloc(grid->num_rows, sizeof(clone->rows[0]));
+    clone->chunks = chunks_alloc(grid->num_rows);
     memset(&clone->scroll_damage, 0, sizeof(clone->scroll_damage));
     memset(&clone->sixel_images, 0, sizeof(clone->sixel_images));
+    memset(&clone->decompressed, 0, sizeof(clone->decompressed));
+    slab_init(&clone->row_slab, sizeof(struct row));
+    cell_slab_init(&clone->cell_slab, grid->num_cols);
 
     tll_foreach(grid->scroll_damage, it)
         tll_push_back(clone->scroll_damage, it->item);
 
     for (int r = 0; r < grid->num_rows; r++) {
-        const struct row *row = grid->rows[r];
+        const struct row *row = grid_ring_get(grid, r);
 
         if (row == NULL)
             continue;
 
-        struct row *clone_row = xmalloc(sizeof(*row));
-        clone->rows[r] = clone_row;
+        struct row *clone_row = slab_alloc(&clone->row_slab);
+        grid_ring_set(clone, r, clone_row);
 
-        clone_row->cells = xmalloc(grid->num_cols * sizeof(clone_row->cells[0]));
         clone_row->linebreak = row->linebreak;
         clone_row->dirty = row->dirty;
 
-        for (int c = 0; c < grid->num_cols; c++)
-            clone_row->cells[c] = row->cells[c];
+        if (row->cells == NULL) {
+            clone_row->cells = NULL;
+            clone_row->compressed = xmalloc(row->compressed->size);
+            memcpy(clone_row->compressed, row->compressed, row->compressed->size);
+        } else {
+            clone_row->cells = slab_alloc(&clone->cell_slab);
+            clone_row->compressed = NULL;
+
+            for (int c = 0; c < grid->num_cols; c++)
+                clone_row->cells[c] = row->cells[c];
+        }
 
         if (row->extra != NULL) {
             const struct row_data *extra = row->extra;
@@ -100,15 +631,23 @@ grid_snapshot(const struct grid *grid)
 void
 grid_free(struct grid *grid)
 {
-    for (int r = 0; r < grid->num_rows; r++)
-        grid_row_free(grid->rows[r]);
+    for (int r = 0; r < grid->num_rows; r++) {
+        struct row *row = grid_ring_get(grid, r);
+        if (row != NULL)
+            row_free_data(row);
+    }
 
     tll_foreach(grid->sixel_images, it) {
         sixel_destroy(&it->item);
         tll_remove(grid->sixel_images, it);
     }
 
-    free(grid->rows);
+    /* Releases all rows, and cells, at once */
+    slab_destroy(&grid->row_slab);
+    slab_destroy(&grid->cell_slab);
+
+    chunks_free(grid->chunks, grid->num_rows);
+    free(grid->decompressed.idx);
     tll_free(grid->scroll_damage);
 }
 
@@ -118,44 +657,68 @@ grid_swap_row(struct grid *grid, int row_a, int row_b)
     xassert(grid->offset >= 0);
     xassert(row_a != row_b);
 
-    int real_a = (grid->offset + row_a) & (grid->num_rows - 1);
-    int real_b = (grid->offset + row_b) & (grid->num_rows - 1);
+    int real_a = grid_row_absolute(grid, row_a);
+    int real_b = grid_row_absolute(grid, row_b);
 
-    struct row *a = grid->rows[real_a];
-    struct row *b = grid->rows[real_b];
+    struct row *a = grid_ring_get(grid, real_a);
+    struct row *b = grid_ring_get(grid, real_b);
 
-    grid->rows[real_a] = b;
-    grid->rows[real_b] = a;
+    grid_ring_set(grid, real_a, b);
+    grid_ring_set(grid, real_b, a);
 }
 
-struct row *
-grid_row_alloc(int cols, bool initialize)
+/*
+ * Allocates a row, with its cells carved from 'cell_slab' (sized for
+ * 'cols' cells). The row itself always comes from the grid's row
+ * slab; unlike the cells, it does not depend on the number of
+ * columns.
+ */
+static struct row *
+row_alloc(struct grid *grid, struct slab *cell_slab, int cols, bool initialize)
 {
-    struct row *row = xmalloc(sizeof(*row));
+    if (unlikely(grid->row_slab.block_size == 0))
+        slab_init(&grid->row_slab, sizeof(struct row));
+
+    struct row *row = slab_alloc(&grid->row_slab);
     row->dirty = false;
     row->linebreak = false;
     row->extra = NULL;
+    row->compressed = NULL;
+    row->cells = slab_alloc(cell_slab);
 
     if (initialize) {
-        row->cells = xcalloc(cols, sizeof(row->cells[0]));
+        memset(row->cells, 0, cols * sizeof(row->cells[0]));
         for (size_t c = 0; c < cols; c++)
             row->cells[c].attrs.clean = 1;
-    } else
-        row->cells = xmalloc(cols * sizeof(row->cells[0]));
+    }
 
     return row;
 }
 
-void
-grid_row_free(struct row *row)
+static void
+row_free(struct grid *grid, struct slab *cell_slab, struct row *row)
 {
     if (row == NULL)
         return;
 
-    grid_row_reset_extra(row);
-    free(row->extra);
-    free(row->cells);
-    free(row);
+    row_free_data(row);
+    slab_free(cell_slab, row->cells);
+    slab_free(&grid->row_slab, row);
+}
+
+struct row *
+grid_row_alloc(struct grid *grid, bool initialize)
+{
+    if (unlikely(grid->cell_slab.block_size == 0))
+        cell_slab_init(&grid->cell_slab, grid->num_cols);
+
+    return row_alloc(grid, &grid->cell_slab, grid->num_cols, initialize);
+}
+
+void
+grid_row_free(struct grid *grid, struct row *row)
+{
+    row_free(grid, &grid->cell_slab, row);
 }
 
 void
@@ -163,11 +726,16 @@ grid_resize_without_reflow(
     struct grid *grid, int new_rows, int new_cols,
     int old_screen_rows, int new_screen_rows)
 {
-    struct row *const *old_grid = grid->rows;
+    xassert(new_rows >= new_screen_rows);
+
+    struct row ***old_grid = grid->chunks;
     const int old_rows = grid->num_rows;
     const int old_cols = grid->num_cols;
 
-    struct row **new_grid = xcalloc(new_rows, sizeof(new_grid[0]));
+    struct row ***new_grid = chunks_alloc(new_rows);
+
+    struct slab new_cell_slab;
+    cell_slab_init(&new_cell_slab, new_cols);
 
     tll(struct sixel) untranslated_sixels = tll_init();
     tll_foreach(grid->sixel_images, it)
@@ -178,14 +746,14 @@ grid_resize_without_reflow(
 
     /* Copy old lines, truncating them if old rows were longer */
     for (int r = 0, n = min(old_screen_rows, new_screen_rows); r < n; r++) {
-        const int old_row_idx = (grid->offset + r) & (old_rows - 1);
-        const int new_row_idx = (new_offset + r) & (new_rows - 1);
+        const int old_row_idx = grid_row_absolute(grid, r);
+        const int new_row_idx = (new_offset + r) % new_rows;
 
-        const struct row *old_row = old_grid[old_row_idx];
+        const struct row *old_row = grid_row_at(grid, old_row_idx);
         xassert(old_row != NULL);
 
-        struct row *new_row = grid_row_alloc(new_cols, false);
-        new_grid[new_row_idx] = new_row;
+        struct row *new_row = row_alloc(grid, &new_cell_slab, new_cols, false);
+        chunks_set(new_grid, new_row_idx, new_row);
 
         memcpy(new_row->cells,
                old_row->cells,
@@ -242,21 +810,31 @@ grid_resize_without_reflow(
 
     /* Clear "new" lines */
     for (int r = min(old_screen_rows, new_screen_rows); r < new_screen_rows; r++) {
-        struct row *new_row = grid_row_alloc(new_cols, false);
-        new_grid[(new_offset + r) & (new_rows - 1)] = new_row;
+        struct row *new_row = row_alloc(grid, &new_cell_slab, new_cols, false);
+        chunks_set(new_grid, (new_offset + r) % new_rows, new_row);
 
         memset(new_row->cells, 0, sizeof(struct cell) * new_cols);
         new_row->dirty = true;
     }
 
-    /* Free old grid */
-    for (int r = 0; r < grid->num_rows; r++)
-        grid_row_free(old_grid[r]);
-    free(grid->rows);
+    /* Free old grid; all old cells are released with their slab */
+    for (int r = 0; r < old_rows; r++) {
+        struct row *row = chunks_get(old_grid, r);
+        if (row == NULL)
+            continue;
+
+        row_free_data(row);
+        slab_free(&grid->row_slab, row);
+    }
+    chunks_free(old_grid, old_rows);
+
+    slab_destroy(&grid->cell_slab);
+    grid->cell_slab = new_cell_slab;
 
-    grid->rows = new_grid;
+    grid->chunks = new_grid;
     grid->num_rows = new_rows;
     grid->num_cols = new_cols;
+    grid->decompressed.count = 0;
 
     grid->view = grid->offset = new_offset;
 
@@ -277,7 +855,7 @@ grid_resize_without_reflow(
     saved_cursor.col = min(saved_cursor.col, new_cols - 1);
     grid->saved_cursor.point = saved_cursor;
 
-    grid->cur_row = new_grid[(grid->offset + cursor.row) & (new_rows - 1)];
+    grid->cur_row = grid_row(grid, cursor.row);
     grid->cursor.lcf = false;
     grid->saved_cursor.lcf = false;
 
@@ -319,23 +897,31 @@ reflow_uri_range_end(struct row_uri_range *range, struct row *new_row,
 }
 
 static struct row *
-_line_wrap(struct grid *old_grid, struct row **new_grid, struct row *row,
+_line_wrap(struct grid *old_grid, struct slab *cell_slab,
+           struct row ***new_grid, struct row *row,
            int *row_idx, int *col_idx, int row_count, int col_count)
 {
     *col_idx = 0;
-    *row_idx = (*row_idx + 1) & (row_count - 1);
+    *row_idx = (*row_idx + 1) % row_count;
 
-    struct row *new_row = new_grid[*row_idx];
+    struct row *new_row = chunks_get(new_grid, *row_idx);
 
     if (new_row == NULL) {
         /* Scrollback not yet full, allocate a completely new row */
-        new_row = grid_row_alloc(col_count, false);
-        new_grid[*row_idx] = new_row;
+        new_row = row_alloc(old_grid, cell_slab, col_count, false);
+        chunks_set(new_grid, *row_idx, new_row);
     } else {
         /* Scrollback is full, need to re-use a row */
         grid_row_reset_extra(new_row);
         new_row->linebreak = false;
 
+        if (new_row->cells == NULL) {
+            /* Compressed by reflow_compress_cold(); overwritten anyway */
+            free(new_row->compressed);
+            new_row->compressed = NULL;
+            new_row->cells = slab_alloc(cell_slab);
+        }
+
         tll_foreach(old_grid->sixel_images, it) {
             if (it->item.pos.row == *row_idx) {
                 sixel_destroy(&it->item);
@@ -373,6 +959,27 @@ _line_wrap(struct grid *old_grid, struct row **new_grid, struct row *row,
     return new_row;
 }
 
+/*
+ * Compresses the reflowed row two screens above 'row_idx', the row
+ * just started. The last reflowed row, which ends up at the bottom of
+ * the screen, is at least that far below it. I.e. the row is cold
+ * (see row_is_cold()).
+ */
+static void
+reflow_compress_cold(struct row ***new_grid, struct slab *cell_slab,
+                     int row_idx, int row_count, int col_count,
+                     int screen_rows)
+{
+    if (2 * screen_rows >= row_count)
+        return;
+
+    const int idx = (row_idx - 2 * screen_rows + row_count) % row_count;
+    struct row *row = chunks_get(new_grid, idx);
+
+    if (row != NULL && row->cells != NULL)
+        row_compress(cell_slab, col_count, row);
+}
+
 static struct {
     int scrollback_start;
     int rows;
@@ -387,8 +994,8 @@ tp_cmp(const void *_a, const void *_b)
     int scrollback_start = tp_cmp_ctx.scrollback_start;
     int num_rows = tp_cmp_ctx.rows;
 
-    int a_row = (a->row - scrollback_start + num_rows) & (num_rows - 1);
-    int b_row = (b->row - scrollback_start + num_rows) & (num_rows - 1);
+    int a_row = (a->row - scrollback_start + num_rows) % num_rows;
+    int b_row = (b->row - scrollback_start + num_rows) % num_rows;
 
     xassert(a_row >= 0);
     xassert(a_row < num_rows || num_rows == 0);
@@ -414,7 +1021,7 @@ tp_cmp(const void *_a, const void *_b)
 void
 grid_resize_and_reflow(
     struct grid *grid, int new_rows, int new_cols,
-    int old_screen_rows, int new_screen_rows,
+    int old_screen_rows, int new_screen_rows, bool compress,
     size_t tracking_points_count,
     struct coord *const _tracking_points[static tracking_points_count],
     size_t compose_count, const struct
@@ -425,7 +1032,9 @@ grid_resize_and_reflow(
     gettimeofday(&start, NULL);
 #endif
 
-    struct row *const *old_grid = grid->rows;
+    xassert(new_rows >= new_screen_rows);
+
+    struct row ***old_grid = grid->chunks;
     const int old_rows = grid->num_rows;
     const int old_cols = grid->num_cols;
 
@@ -435,16 +1044,18 @@ grid_resize_and_reflow(
     int new_col_idx = 0;
     int new_row_idx = 0;
 
-    struct row **new_grid = xcalloc(new_rows, sizeof(new_grid[0]));
-    struct row *new_row = new_grid[new_row_idx];
+    struct row ***new_grid = chunks_alloc(new_rows);
 
-    xassert(new_row == NULL);
-    new_row = grid_row_alloc(new_cols, false);
-    new_grid[new_row_idx] = new_row;
+    /* Old rows' cells are freed to the old slab, as they're reflowed */
+    struct slab new_cell_slab;
+    cell_slab_init(&new_cell_slab, new_cols);
+
+    struct row *new_row = row_alloc(grid, &new_cell_slab, new_cols, false);
+    chunks_set(new_grid, new_row_idx, new_row);
 
     /* Start at the beginning of the old grid's scrollback. That is,
      * at the output that is *oldest* */
-    int offset = grid->offset + old_screen_rows;
+    int offset = old_rows > 0 ? grid_row_absolute(grid, old_screen_rows) : 0;
 
     tll(struct sixel) untranslated_sixels = tll_init();
     tll_foreach(grid->sixel_images, it)
@@ -453,12 +1064,12 @@ grid_resize_and_reflow(
 
     /* Turn cursor coordinates into grid absolute coordinates */
     struct coord cursor = grid->cursor.point;
-    cursor.row += grid->offset;
-    cursor.row &= old_rows - 1;
-
     struct coord saved_cursor = grid->saved_cursor.point;
-    saved_cursor.row += grid->offset;
-    saved_cursor.row &= old_rows - 1;
+
+    if (old_rows > 0) {
+        cursor.row = grid_row_absolute(grid, cursor.row);
+        saved_cursor.row = grid_row_absolute(grid, saved_cursor.row);
+    }
 
     size_t tp_count =
         tracking_points_count +
@@ -487,6 +1098,9 @@ grid_resize_and_reflow(
     tracking_points[tp_count - 1] = &terminator;
     struct coord **next_tp = &tracking_points[0];
 
+    /* Compressed old rows are decoded into this, not decompressed */
+    struct cell old_cells_buf[old_cols > 0 ? old_cols : 1];
+
     LOG_DBG("scrollback-start=%d", offset);
     for (size_t i = 0; i < tp_count - 1; i++) {
         LOG_DBG("TP #%zu: row=%d, col=%d",
@@ -498,13 +1112,19 @@ grid_resize_and_reflow(
      */
     for (int r = 0; r < old_rows; r++) {
 
-        const size_t old_row_idx = (offset + r) & (old_rows - 1);
+        const int old_row_idx = (offset + r) % old_rows;
 
         /* Unallocated (empty) rows we can simply skip */
-        const struct row *old_row = old_grid[old_row_idx];
+        struct row *old_row = chunks_get(old_grid, old_row_idx);
         if (old_row == NULL)
             continue;
 
+        const struct cell *old_cells = old_row->cells;
+        if (old_cells == NULL) {
+            grid_row_decode(old_row, old_cells_buf);
+            old_cells = old_cells_buf;
+        }
+
         /* Map sixels on current "old" row to current "new row" */
         tll_foreach(untranslated_sixels, it) {
             if (it->item.pos.row != old_row_idx)
@@ -518,14 +1138,21 @@ grid_resize_and_reflow(
         }
 
 #define line_wrap()                                                 \
-        new_row = _line_wrap(                                       \
-            grid, new_grid, new_row, &new_row_idx, &new_col_idx,    \
-            new_rows, new_cols)
+        do {                                                        \
+            new_row = _line_wrap(                                   \
+                grid, &new_cell_slab, new_grid, new_row,            \
+                &new_row_idx, &new_col_idx, new_rows, new_cols);    \
+            if (compress) {                                         \
+                reflow_compress_cold(                               \
+                    new_grid, &new_cell_slab, new_row_idx,          \
+                    new_rows, new_cols, new_screen_rows);           \
+            }                                                       \
+        } while (0)
 
         /* Find last non-empty cell */
         int col_count = 0;
         for (int c = old_cols - 1; c >= 0; c--) {
-            const struct cell *cell = &old_row->cells[c];
+            const struct cell *cell = &old_cells[c];
             if (!(cell->wc == 0 || cell->wc == CELL_SPACER)) {
                 col_count = c + 1;
                 break;
@@ -640,7 +1267,7 @@ grid_resize_and_reflow(
                         unlikely(
                             amount > 1 &&
                             from + amount < old_cols &&
-                            old_row->cells[from + amount].wc >= CELL_SPACER + 1))
+                            old_cells[from + amount].wc >= CELL_SPACER + 1))
                     {
                         amount--;
                         spacers++;
@@ -648,14 +1275,14 @@ grid_resize_and_reflow(
 
                     xassert(
                         amount == 1 ||
-                        old_row->cells[from + amount - 1].wc <= CELL_SPACER + 1);
+                        old_cells[from + amount - 1].wc <= CELL_SPACER + 1);
                 }
 
                 xassert(new_col_idx + amount <= new_cols);
                 xassert(from + amount <= old_cols);
 
                 memcpy(
-                    &new_row->cells[new_col_idx], &old_row->cells[from],
+                    &new_row->cells[new_col_idx], &old_cells[from],
                     amount * sizeof(struct cell));
 
                 count -= amount;
@@ -667,7 +1294,7 @@ grid_resize_and_reflow(
                 if (unlikely(spacers > 0)) {
                     xassert(new_col_idx + spacers == new_cols);
 
-                    const struct cell *cell = &old_row->cells[from - 1];
+                    const struct cell *cell = &old_cells[from - 1];
 
                     for (int i = 0; i < spacers; i++, new_col_idx++) {
                         new_row->cells[new_col_idx].wc = CELL_SPACER;
@@ -728,8 +1355,8 @@ grid_resize_and_reflow(
             line_wrap();
         }
 
-        grid_row_free(old_grid[old_row_idx]);
-        grid->rows[old_row_idx] = NULL;
+        grid_row_free(grid, old_row);
+        grid_ring_set(grid, old_row_idx, NULL);
 
 #undef line_wrap
     }
@@ -747,7 +1374,7 @@ grid_resize_and_reflow(
 #if defined(_DEBUG)
     /* Verify all URI ranges have been “closed” */
     for (int r = 0; r < new_rows; r++) {
-        const struct row *row = new_grid[r];
+        const struct row *row = chunks_get(new_grid, r);
 
         if (row == NULL)
             continue;
@@ -760,21 +1387,23 @@ grid_resize_and_reflow(
 
     /* Verify all old rows have been free:d */
     for (int i = 0; i < old_rows; i++)
-        xassert(grid->rows[i] == NULL);
+        xassert(chunks_get(old_grid, i) == NULL);
 #endif
 
     /* Set offset such that the last reflowed row is at the bottom */
     grid->offset = new_row_idx - new_screen_rows + 1;
     while (grid->offset < 0)
         grid->offset += new_rows;
-    while (new_grid[grid->offset] == NULL)
-        grid->offset = (grid->offset + 1) & (new_rows - 1);
+    while (chunks_get(new_grid, grid->offset) == NULL)
+        grid->offset = (grid->offset + 1) % new_rows;
 
     /* Ensure all visible rows have been allocated */
     for (int r = 0; r < new_screen_rows; r++) {
-        int idx = (grid->offset + r) & (new_rows - 1);
-        if (new_grid[idx] == NULL)
-            new_grid[idx] = grid_row_alloc(new_cols, true);
+        int idx = (grid->offset + r) % new_rows;
+        if (chunks_get(new_grid, idx) == NULL) {
+            chunks_set(new_grid, idx,
+                       row_alloc(grid, &new_cell_slab, new_cols, true));
+        }
     }
 
     grid->view = view_follows ? grid->offset : viewport.row;
@@ -782,25 +1411,30 @@ grid_resize_and_reflow(
     /* If enlarging the window, the old viewport may be too far down,
      * with unallocated rows. Make sure this cannot happen */
     while (true) {
-        int idx = (grid->view + new_screen_rows - 1) & (new_rows - 1);
-        if (new_grid[idx] != NULL)
+        int idx = (grid->view + new_screen_rows - 1) % new_rows;
+        if (chunks_get(new_grid, idx) != NULL)
             break;
         grid->view--;
         if (grid->view < 0)
             grid->view += new_rows;
     }
     for (size_t r = 0; r < new_screen_rows; r++) {
-        int UNUSED idx = (grid->view + r) & (new_rows - 1);
-        xassert(new_grid[idx] != NULL);
+        int UNUSED idx = (grid->view + r) % new_rows;
+        xassert(chunks_get(new_grid, idx) != NULL);
     }
 
     /* Free old grid (rows already free:d) */
-    free(grid->rows);
+    chunks_free(old_grid, old_rows);
 
-    grid->rows = new_grid;
+    grid->chunks = new_grid;
     grid->num_rows = new_rows;
     grid->num_cols = new_cols;
 
+    slab_destroy(&grid->cell_slab);
+    grid->cell_slab = new_cell_slab;
+
+    grid->decompressed.count = 0;
+
     /* Convert absolute coordinates to screen relative */
     cursor.row -= grid->offset;
     while (cursor.row < 0)
@@ -814,7 +1448,7 @@ grid_resize_and_reflow(
     saved_cursor.row = min(saved_cursor.row, new_screen_rows - 1);
     saved_cursor.col = min(saved_cursor.col, new_cols - 1);
 
-    grid->cur_row = new_grid[(grid->offset + cursor.row) & (new_rows - 1)];
+    grid->cur_row = grid_row(grid, cursor.row);
     grid->cursor.point = cursor;
     grid->saved_cursor.point = saved_cursor;
 
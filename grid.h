@@ -8,31 +8,147 @@ struct grid *grid_snapshot(const struct grid *grid);
 void grid_free(struct grid *grid);
 
 void grid_swap_row(struct grid *grid, int row_a, int row_b);
-struct row *grid_row_alloc(int cols, bool initialize);
-void grid_row_free(struct row *row);
+struct row *grid_row_alloc(struct grid *grid, bool initialize);
+void grid_row_free(struct grid *grid, struct row *row);
+
+/*
+ * Scrollback compression. Rows that are more than a screen's worth of
+ * lines above the screen, and not in the view, are stored compressed.
+ *
+ * grid_row_decompress() decompresses a row in place, and remembers
+ * it, so that it can be compressed again once it is out of the view.
+ * grid_row_decode() decodes a compressed row into a caller supplied
+ * buffer, without decompressing it. grid_row_discard_compressed()
+ * drops the row's contents, leaving it with uninitialized cells.
+ *
+ * grid_compress_scrollback() is called after the grid has been
+ * scrolled 'scrolled' lines, and compresses the rows that became
+ * cold.
+ */
+void grid_row_decompress(struct grid *grid, int row_idx);
+void grid_row_discard_compressed(struct grid *grid, struct row *row);
+void grid_row_decode(const struct row *row, struct cell cells[]);
+void grid_compress_scrollback(struct grid *grid, int screen_rows, int scrolled);
+
+/*
+ * Sets used[i] for each attribute index (cell_attrs.idx), or composed
+ * character chain (wc - CELL_COMB_CHARS_LO), below 'count' that is
+ * referenced by the grid. For the attribute and chain tables' garbage
+ * collection.
+ *
+ * Compressed rows are not decoded; only their attribute runs are
+ * scanned, and their text only if it has composed characters. Since
+ * all but a couple of screens' worth of rows are compressed, the
+ * cost is mostly proportional to the number of lines, not cells.
+ */
+void grid_mark_attrs(const struct grid *grid, bool used[], size_t count);
+void grid_mark_composed(const struct grid *grid, bool used[], size_t count);
+
+/*
+ * The row ring is a directory of chunks, each holding GRID_CHUNK_SIZE
+ * row pointers, making it possible to size it exactly, and to only
+ * allocate the chunks that rows are actually stored in.
+ *
+ * Chunks that have not been allocated are grid_empty_chunk, which is
+ * shared, all NULL, and never written to. This keeps row lookups
+ * branch-free; only storing a row may have to allocate its chunk.
+ */
+#define GRID_CHUNK_SHIFT 8
+#define GRID_CHUNK_SIZE (1 << GRID_CHUNK_SHIFT)
+
+extern struct row *grid_empty_chunk[GRID_CHUNK_SIZE];
+
+/* Allocates an empty ring, with 'num_rows' slots, for a new grid */
+void grid_ring_init(struct grid *grid, int num_rows);
+
+/* Allocates the chunk at 'chunk' (which must be grid_empty_chunk) */
+void grid_chunk_alloc(struct row ***chunk);
+
+/* Releases all chunks that have no rows, after rows have been freed */
+void grid_release_chunks(struct grid *grid);
+
+/*
+ * Inserts 'count' empty slots into the row ring, right below the
+ * screen (i.e. before the oldest row), or, with a negative 'count',
+ * removes -'count' (empty) slots from there. This moves rows to other
+ * indices; the grid's own indices (offset, view, sixels...) are
+ * updated, as are the tracking points'.
+ */
+void grid_resize_ring(
+    struct grid *grid, int count, int screen_rows,
+    size_t tracking_points_count,
+    struct coord *const tracking_points[static tracking_points_count]);
 
 void grid_resize_without_reflow(
     struct grid *grid, int new_rows, int new_cols,
     int old_screen_rows, int new_screen_rows);
 
+/*
+ * Compressed rows are decoded one at a time while reflowing. With
+ * 'compress', the reflowed rows are compressed as soon as they are
+ * cold, rather than when the reflow is done.
+ */
 void grid_resize_and_reflow(
     struct grid *grid, int new_rows, int new_cols,
-    int old_screen_rows, int new_screen_rows,
+    int old_screen_rows, int new_screen_rows, bool compress,
     size_t tracking_points_count,
     struct coord *const _tracking_points[static tracking_points_count],
     size_t compose_count,
     const struct composed composed[static compose_count]);
 
+/*
+ * Wraps a row index, in the range [-num_rows, 3 * num_rows), to an
+ * absolute (ring) index. The upper bound covers offset + row numbers
+ * up to twice the screen (reverse scrolling), when the ring is no
+ * larger than the screen (the alt grid).
+ */
+static inline int
+grid_row_wrap(const struct grid *grid, int row_idx)
+{
+    const int num_rows = grid->num_rows;
+
+    xassert(row_idx >= -num_rows && row_idx < 3 * num_rows);
+
+    row_idx += num_rows & -(row_idx < 0);
+    row_idx -= num_rows & -(row_idx >= num_rows);
+    row_idx -= num_rows & -(row_idx >= num_rows);
+    return row_idx;
+}
+
 static inline int
 grid_row_absolute(const struct grid *grid, int row_no)
 {
-    return (grid->offset + row_no) & (grid->num_rows - 1);
+    return grid_row_wrap(grid, grid->offset + row_no);
 }
 
 static inline int
 grid_row_absolute_in_view(const struct grid *grid, int row_no)
 {
-    return (grid->view + row_no) & (grid->num_rows - 1);
+    return grid_row_wrap(grid, grid->view + row_no);
+}
+
+/* The row in the ring slot 'row_idx' (absolute), as is (may be NULL) */
+static inline struct row *
+grid_ring_get(const struct grid *grid, int row_idx)
+{
+    xassert(row_idx >= 0 && row_idx < grid->num_rows);
+    return grid->chunks[row_idx >> GRID_CHUNK_SHIFT]
+                       [row_idx & (GRID_CHUNK_SIZE - 1)];
+}
+
+static inline void
+grid_ring_set(struct grid *grid, int row_idx, struct row *row)
+{
+    xassert(row_idx >= 0 && row_idx < grid->num_rows);
+
+    struct row ***chunk = &grid->chunks[row_idx >> GRID_CHUNK_SHIFT];
+    if (unlikely(*chunk == grid_empty_chunk)) {
+        if (row == NULL)
+            return;
+        grid_chunk_alloc(chunk);
+    }
+
+    (*chunk)[row_idx & (GRID_CHUNK_SIZE - 1)] = row;
 }
 
 static inline struct row *
@@ -41,11 +157,17 @@ _grid_row_maybe_alloc(struct grid *grid, int row_no, bool alloc_if_null)
     xassert(grid->offset >= 0);
 
     int real_row = grid_row_absolute(grid, row_no);
-    struct row *row = grid->rows[real_row];
+    struct row *row = grid_ring_get(grid, real_row);
 
     if (row == NULL && alloc_if_null) {
-        row = grid_row_alloc(grid->num_cols, false);
-        grid->rows[real_row] = row;
+        row = grid_row_alloc(grid, false);
+        grid_ring_set(grid, real_row, row);
+    } else if (unlikely(row != NULL && row->cells == NULL)) {
+        /* Like newly allocated rows, the cells' contents are undefined */
+        if (alloc_if_null)
+            grid_row_discard_compressed(grid, row);
+        else
+            grid_row_decompress(grid, real_row);
     }
 
     xassert(row != NULL);
@@ -70,12 +192,42 @@ grid_row_in_view(struct grid *grid, int row_no)
     xassert(grid->view >= 0);
 
     int real_row = grid_row_absolute_in_view(grid, row_no);
-    struct row *row = grid->rows[real_row];
+    struct row *row = grid_ring_get(grid, real_row);
 
     xassert(row != NULL);
+
+    if (unlikely(row->cells == NULL))
+        grid_row_decompress(grid, real_row);
+
     return row;
 }
 
+/* Returns the row at the absolute index 'row_idx' (may be NULL) */
+static inline struct row *
+grid_row_at(struct grid *grid, int row_idx)
+{
+    struct row *row = grid_ring_get(grid, row_idx);
+
+    if (unlikely(row != NULL && row->cells == NULL))
+        grid_row_decompress(grid, row_idx);
+
+    return row;
+}
+
+/*
+ * Returns the row's cells, for reading. Compressed rows are decoded
+ * into 'buf', which must be large enough for a row of the grid.
+ */
+static inline const struct cell *
+grid_row_cells(const struct row *row, struct cell buf[])
+{
+    if (likely(row->cells != NULL))
+        return row->cells;
+
+    grid_row_decode(row, buf);
+    return buf;
+}
+
 void grid_row_add_uri_range(struct row *row, struct row_uri_range range);
 
 static inline void
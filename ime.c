@@ -9,11 +9,14 @@
 #define LOG_MODULE "ime"
 #define LOG_ENABLE_DBG 0
 #include "log.h"
+#include "attrs.h"
+#include "grid.h"
 #include "render.h"
 #include "search.h"
 #include "terminal.h"
 #include "util.h"
 #include "wayland.h"
+#include "wcwidth.h"
 #include "xmalloc.h"
 
 static void
@@ -178,7 +181,7 @@ done(void *data, struct zwp_text_input_v3 *zwp_text_input_v3,
     size_t widths[wchars + 1];
 
     for (size_t i = 0; i < wchars; i++) {
-        int width = max(wcwidth(seat->ime.preedit.text[i]), 1);
+        int width = max(my_wcwidth(seat->ime.preedit.text[i]), 1);
         widths[i] = width;
         cell_count += width;
     }
@@ -195,12 +198,12 @@ done(void *data, struct zwp_text_input_v3 *zwp_text_input_v3,
         int width = widths[i];
 
         cell->wc = seat->ime.preedit.text[i];
-        cell->attrs = (struct attributes){.clean = 0};
+        cell->attrs = (struct cell_attrs){.idx = ATTRS_DEFAULT};
 
         for (int j = 1; j < width; j++) {
             cell = &seat->ime.preedit.cells[cell_idx + j];
             cell->wc = CELL_SPACER + width - j;
-            cell->attrs = (struct attributes){.clean = 1};
+            cell->attrs = (struct cell_attrs){.idx = ATTRS_DEFAULT, .clean = 1};
         }
 
         cell_idx += width;
@@ -306,7 +309,7 @@ done(void *data, struct zwp_text_input_v3 *zwp_text_input_v3,
     for (size_t i = 0, cell_idx = 0; i < wchars; cell_idx += widths[i], i++) {
         if (hidden || start == end || cell_idx < start || cell_idx >= end) {
             struct cell *cell = &seat->ime.preedit.cells[cell_idx];
-            cell->attrs.underline = true;
+            cell->attrs.idx = ATTRS_UNDERLINE;
         }
     }
 
@@ -462,7 +465,7 @@ ime_update_cursor_rect(struct seat *seat)
     int row = term->grid->cursor.point.row;
     row += term->grid->offset;
     row -= term->grid->view;
-    row &= term->grid->num_rows - 1;
+    row = grid_row_wrap(term->grid, row);
     x = term->margins.left + col * term->cell_width;
     y = term->margins.top + row * term->cell_height;
 
@@ -704,21 +704,11 @@ start_repeater(struct seat *seat, uint32_t key)
     if (seat->kbd.repeat.rate == 0)
         return true;
 
-    struct itimerspec t = {
-        .it_value = {.tv_sec = 0, .tv_nsec = seat->kbd.repeat.delay * 1000000},
-        .it_interval = {.tv_sec = 0, .tv_nsec = 1000000000 / seat->kbd.repeat.rate},
-    };
-
-    if (t.it_value.tv_nsec >= 1000000000) {
-        t.it_value.tv_sec += t.it_value.tv_nsec / 1000000000;
-        t.it_value.tv_nsec %= 1000000000;
-    }
-    if (t.it_interval.tv_nsec >= 1000000000) {
-        t.it_interval.tv_sec += t.it_interval.tv_nsec / 1000000000;
-        t.it_interval.tv_nsec %= 1000000000;
-    }
-    if (timerfd_settime(seat->kbd.repeat.fd, 0, &t, NULL) < 0) {
-        LOG_ERRNO("%s: failed to arm keyboard repeat timer", seat->name);
+    if (!fdm_timer_set(seat->wayl->fdm, seat->kbd.repeat.timer,
+                       (uint64_t)seat->kbd.repeat.delay * 1000000,
+                       1000000000 / seat->kbd.repeat.rate))
+    {
+        LOG_ERR("%s: failed to arm keyboard repeat timer", seat->name);
         return false;
     }
 
@@ -732,12 +722,7 @@ stop_repeater(struct seat *seat, uint32_t key)
     if (key != -1 && key != seat->kbd.repeat.key)
         return true;
 
-    if (timerfd_settime(seat->kbd.repeat.fd, 0, &(struct itimerspec){{0}}, NULL) < 0) {
-        LOG_ERRNO("%s: failed to disarm keyboard repeat timer", seat->name);
-        return false;
-    }
-
-    return true;
+    return fdm_timer_set(seat->wayl->fdm, seat->kbd.repeat.timer, 0, 0);
 }
 
 static void
@@ -8,6 +8,7 @@
 #define LOG_MODULE "osc"
 #define LOG_ENABLE_DBG 0
 #include "log.h"
+#include "attrs.h"
 #include "base64.h"
 #include "config.h"
 #include "grid.h"
@@ -548,6 +549,10 @@ update_color_in_grids(struct terminal *term, uint32_t old_color,
      * TODO(?): for performance reasons, we only update the current
      * screen rows (of both grids). I.e. scrollback is *not* updated.
      */
+    /* Attributes are interned; remember the last translation */
+    uint32_t last_idx = ATTRS_DEFAULT;
+    uint32_t last_new_idx = ATTRS_DEFAULT;
+
     for (size_t i = 0; i < 2; i++) {
         struct grid *grid = i == 0 ? &term->normal : &term->alt;
 
@@ -557,18 +562,34 @@ update_color_in_grids(struct terminal *term, uint32_t old_color,
 
             for (size_t c = 0; c < term->grid->num_cols; c++) {
                 struct cell *cell = &row->cells[c];
-                if (cell->attrs.have_fg &&
-                    cell->attrs.fg == old_color)
-                {
-                    cell->attrs.fg = new_color;
-                    cell->attrs.clean = 0;
-                    row->dirty = true;
+
+                if (cell->attrs.idx == last_idx) {
+                    if (last_new_idx != last_idx) {
+                        cell->attrs.idx = last_new_idx;
+                        cell->attrs.clean = 0;
+                        row->dirty = true;
+                    }
+                    continue;
                 }
 
-                if ( cell->attrs.have_bg &&
-                    cell->attrs.bg == old_color)
-                {
-                    cell->attrs.bg = new_color;
+                struct attributes attrs = *attrs_of(term, cell);
+                bool changed = false;
+
+                if (attrs.have_fg && attrs.fg == old_color) {
+                    attrs.fg = new_color;
+                    changed = true;
+                }
+
+                if (attrs.have_bg && attrs.bg == old_color) {
+                    attrs.bg = new_color;
+                    changed = true;
+                }
+
+                last_idx = cell->attrs.idx;
+                last_new_idx = changed ? attrs_get(term, &attrs) : last_idx;
+
+                if (changed) {
+                    cell->attrs.idx = last_new_idx;
                     cell->attrs.clean = 0;
                     row->dirty = true;
                 }
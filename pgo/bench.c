@@ -0,0 +1,287 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+
+#include <tllist.h>
+
+#include "config.h"
+#include "grid.h"
+#include "headless.h"
+#include "terminal.h"
+#include "vt.h"
+
+/*
+ * Headless throughput benchmark. Replays corpora through the same
+ * path as a real PTY read (fdm_ptmx() -> vt_from_slave()), with
+ * Wayland, rendering and the FDM stubbed out (see stubs.c).
+ *
+ * After each fdm_ptmx() call, a "frame" is emulated: dirty cells in
+ * the view are counted and marked clean, and the accumulated scroll
+ * damage is counted and discarded. Only the time spent in
+ * fdm_ptmx() is measured.
+ */
+
+extern bool fdm_ptmx(struct fdm *fdm, int fd, int events, void *data);
+
+/* Keep in sync with scripts/generate-bench-corpus.py */
+static const int row_count = 67;
+static const int col_count = 135;
+static const int grid_row_count = 16384;
+
+struct stats {
+    double elapsed;     /* Seconds spent in fdm_ptmx() */
+    uint64_t cells;     /* Dirty cells, as seen by the renderer */
+    uint64_t scrolls;   /* Scrolled lines */
+};
+
+static void
+print_usage(const char *prog_name)
+{
+    printf(
+        "Usage: %s [OPTIONS...] corpus1 corpus2 ... corpusN\n"
+        "\n"
+        "Options:\n"
+        "  -i,--iterations=N      number of times to replay each corpus (5)\n"
+        "  -h,--help              show this help and exit\n"
+        "\n"
+        "Prints the best iteration's MB/s, cells/s and scrolled lines/s,\n"
+        "for each corpus\n",
+        prog_name);
+}
+
+static void
+emulate_frame(struct terminal *term, struct stats *stats)
+{
+    tll_foreach(term->normal.scroll_damage, it)
+        stats->scrolls += it->item.lines;
+    tll_foreach(term->alt.scroll_damage, it)
+        stats->scrolls += it->item.lines;
+
+    tll_free(term->normal.scroll_damage);
+    tll_free(term->alt.scroll_damage);
+
+    for (int r = 0; r < term->rows; r++) {
+        struct row *row = grid_row_in_view(term->grid, r);
+        if (!row->dirty)
+            continue;
+
+        for (int c = 0; c < term->cols; c++) {
+            struct cell *cell = &row->cells[c];
+            if (cell->attrs.clean)
+                continue;
+
+            cell->attrs.clean = 1;
+            stats->cells++;
+        }
+
+        row->dirty = false;
+    }
+}
+
+static bool
+replay(struct terminal *term, int fd, off_t size, struct stats *stats)
+{
+    /* Start every iteration from the same state */
+    static const char reset[] = "\033[?1049l\033[m\033[r\033[H\033[2J";
+    vt_from_slave(term, (const uint8_t *)reset, sizeof(reset) - 1);
+    emulate_frame(term, &(struct stats){0});
+
+    *stats = (struct stats){0};
+    lseek(fd, 0, SEEK_SET);
+
+    while (lseek(fd, 0, SEEK_CUR) < size) {
+        struct timespec start, stop;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        if (!fdm_ptmx(NULL, -1, EPOLLIN, term)) {
+            fprintf(stderr, "error: fdm_ptmx() failed\n");
+            return false;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+
+        stats->elapsed +=
+            (stop.tv_sec - start.tv_sec) +
+            (stop.tv_nsec - start.tv_nsec) / 1000000000.;
+
+        emulate_frame(term, stats);
+    }
+
+    return true;
+}
+
+static int
+load_corpus(const char *path, off_t *size)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "error: %s: failed to open: %s\n",
+                path, strerror(errno));
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        fprintf(stderr, "error: %s: failed to stat: %s\n",
+                path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    /*
+     * Copy the corpus to a memory backed FD, to keep file system
+     * reads out of the measurements.
+     */
+#if defined(MEMFD_CREATE)
+    int mem_fd = memfd_create("foot-bench-ptmx", MFD_CLOEXEC);
+#elif defined(__FreeBSD__)
+    // memfd_create on FreeBSD 13 is SHM_ANON without sealing support
+    int mem_fd = shm_open(SHM_ANON, O_RDWR | O_CLOEXEC, 0600);
+#else
+    char name[] = "/tmp/foot-bench-ptmx-XXXXXX";
+    int mem_fd = mkostemp(name, O_CLOEXEC);
+    unlink(name);
+#endif
+    if (mem_fd < 0) {
+        fprintf(stderr, "error: failed to create memory FD\n");
+        close(fd);
+        return -1;
+    }
+
+    uint8_t buf[64 * 1024];
+    ssize_t count;
+    while ((count = read(fd, buf, sizeof(buf))) > 0) {
+        if (write(mem_fd, buf, count) != count) {
+            fprintf(stderr, "error: failed to write memory FD\n");
+            goto err;
+        }
+    }
+
+    if (count < 0) {
+        fprintf(stderr, "error: %s: failed to read: %s\n",
+                path, strerror(errno));
+        goto err;
+    }
+
+    close(fd);
+    *size = st.st_size;
+    return mem_fd;
+
+err:
+    close(fd);
+    close(mem_fd);
+    return -1;
+}
+
+int
+main(int argc, char *const *argv)
+{
+    const char *const prog_name = argv[0];
+
+    static const struct option longopts[] = {
+        {"iterations", required_argument, NULL, 'i'},
+        {"help",       no_argument,       NULL, 'h'},
+        {NULL,         no_argument,       NULL,   0},
+    };
+
+    int iterations = 5;
+
+    while (true) {
+        int c = getopt_long(argc, argv, "i:h", longopts, NULL);
+
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 'i':
+            iterations = atoi(optarg);
+            if (iterations <= 0) {
+                fprintf(stderr, "error: %s: invalid iteration count\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+
+        case 'h':
+            print_usage(prog_name);
+            return EXIT_SUCCESS;
+
+        case '?':
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (optind >= argc) {
+        print_usage(prog_name);
+        return EXIT_FAILURE;
+    }
+
+    struct config conf = {
+        .tweak = {
+            .delayed_render_lower_ns = 500000,         /* 0.5ms */
+            .delayed_render_upper_ns = 16666666 / 2,   /* half a frame period (60Hz) */
+        },
+    };
+
+    struct wayland wayl = {
+        .seats = tll_init(),
+        .monitors = tll_init(),
+        .terms = tll_init(),
+    };
+
+    struct terminal term;
+    headless_term_init(
+        &term, &conf, &wayl, col_count, row_count, grid_row_count - row_count);
+
+    int ret = EXIT_FAILURE;
+
+    printf("%-24s %10s %10s %12s %12s\n",
+           "corpus", "bytes", "MB/s", "cells/s", "scrolls/s");
+
+    for (int i = optind; i < argc; i++) {
+        off_t size;
+        int fd = load_corpus(argv[i], &size);
+        if (fd < 0)
+            goto out;
+
+        term.ptmx = fd;
+
+        struct stats best = {0};
+        for (int j = 0; j < iterations; j++) {
+            struct stats stats;
+            if (!replay(&term, fd, size, &stats)) {
+                close(fd);
+                goto out;
+            }
+
+            if (j == 0 || stats.elapsed < best.elapsed)
+                best = stats;
+        }
+
+        close(fd);
+
+        const char *name = strrchr(argv[i], '/');
+        name = name != NULL ? name + 1 : argv[i];
+
+        printf("%-24s %10lld %10.1f %12.0f %12.0f\n",
+               name, (long long)size,
+               size / best.elapsed / (1024. * 1024.),
+               best.cells / best.elapsed,
+               best.scrolls / best.elapsed);
+    }
+
+    ret = EXIT_SUCCESS;
+
+out:
+    headless_term_destroy(&term);
+    return ret;
+}
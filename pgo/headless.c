@@ -0,0 +1,103 @@
+#include "headless.h"
+
+#include <stdlib.h>
+
+#include <tllist.h>
+
+#include "attrs.h"
+#include "composed.h"
+#include "grid.h"
+#include "sixel.h"
+#include "spill.h"
+
+static void
+grid_init(struct grid *grid, int cols, int num_rows)
+{
+    *grid = (struct grid){
+        .num_cols = cols,
+        .scroll_damage = tll_init(),
+        .sixel_images = tll_init(),
+    };
+
+    grid_ring_init(grid, num_rows);
+    for (int i = 0; i < num_rows; i++)
+        grid_ring_set(grid, i, grid_row_alloc(grid, true));
+    grid->cur_row = grid_ring_get(grid, 0);
+}
+
+void
+headless_term_init(struct terminal *term, const struct config *conf,
+                   struct wayland *wayl, int cols, int rows,
+                   int scrollback_lines)
+{
+    *term = (struct terminal){
+        .conf = conf,
+        .wl = wayl,
+        .grid = &term->normal,
+        .scale = 1,
+        .width = cols * 8,
+        .height = rows * 15,
+        .cols = cols,
+        .rows = rows,
+        .cell_width = 8,
+        .cell_height = 15,
+        .scroll_region = {
+            .start = 0,
+            .end = rows,
+        },
+        .selection = {
+            .start = {-1, -1},
+            .end = {-1, -1},
+            .pivot = {
+                .start = {-1, -1},
+                .end = {-1, -1},
+            },
+        },
+        .render = {
+            .scrollback_lines = scrollback_lines,
+        },
+        .reverse_wrap = true,
+        .auto_margin = true,
+        .vt = {
+            .osc8 = {.begin = {-1, -1}},
+        },
+        .sixel = {
+            .scrolling = true,
+            .use_private_palette = true,
+            .palette_size = SIXEL_MAX_COLORS,
+            .max_width = SIXEL_MAX_WIDTH,
+            .max_height = SIXEL_MAX_HEIGHT,
+        },
+    };
+
+    grid_init(&term->normal, cols, rows + scrollback_lines);
+    grid_init(&term->alt, cols, rows);
+
+    for (int c = 0; c < cols; c += 8)
+        tll_push_back(term->tab_stops, c);
+
+    term_update_ascii_printer(term);
+    attrs_init(term);
+
+    tll_push_back(wayl->terms, term);
+}
+
+void
+headless_term_destroy(struct terminal *term)
+{
+    tll_foreach(term->wl->terms, it) {
+        if (it->item == term)
+            tll_remove(term->wl->terms, it);
+    }
+
+    free(term->vt.osc.data);
+    free(term->vt.osc8.uri);
+    grid_free(&term->normal);
+    grid_free(&term->alt);
+    spill_reset(term);
+    composed_free(term);
+    attrs_free(term);
+    free(term->window_title);
+    tll_free_and_free(term->window_title_stack, free);
+    tll_free(term->tab_stops);
+}
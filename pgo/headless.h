@@ -0,0 +1,19 @@
+#pragma once
+
+#include "config.h"
+#include "terminal.h"
+#include "wayland.h"
+
+/*
+ * A terminal without a window, PTY or renderer, for the PGO helper,
+ * foot-bench, foot-render-bench and the tests. 'cols' x 'rows' cells,
+ * of 8x15 pixels, with 'scrollback_lines' lines of scrollback, all
+ * allocated up front.
+ *
+ * The terminal is added to 'wayl', and removed from it again by
+ * headless_term_destroy().
+ */
+void headless_term_init(
+    struct terminal *term, const struct config *conf, struct wayland *wayl,
+    int cols, int rows, int scrollback_lines);
+void headless_term_destroy(struct terminal *term);
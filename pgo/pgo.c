@@ -7,15 +7,11 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/epoll.h>
-#include <sys/timerfd.h>
 #include <sys/mman.h>
 #include <fcntl.h>
 
-#include "async.h"
 #include "config.h"
-#include "reaper.h"
-#include "sixel.h"
-#include "user-notification.h"
+#include "headless.h"
 #include "vt.h"
 
 extern bool fdm_ptmx(struct fdm *fdm, int fd, int events, void *data);
@@ -28,120 +24,6 @@ usage(const char *prog_name)
         prog_name);
 }
 
-enum async_write_status
-async_write(int fd, const void *data, size_t len, size_t *idx)
-{
-    return ASYNC_WRITE_DONE;
-}
-
-bool
-fdm_add(struct fdm *fdm, int fd, int events, fdm_fd_handler_t handler, void *data)
-{
-    return true;
-}
-
-bool
-fdm_del(struct fdm *fdm, int fd)
-{
-    return true;
-}
-
-bool
-fdm_event_add(struct fdm *fdm, int fd, int events)
-{
-    return true;
-}
-
-bool
-fdm_event_del(struct fdm *fdm, int fd, int events)
-{
-    return true;
-}
-
-bool
-render_resize_force(struct terminal *term, int width, int height)
-{
-    return true;
-}
-
-void render_refresh(struct terminal *term) {}
-void render_refresh_csd(struct terminal *term) {}
-void render_refresh_title(struct terminal *term) {}
-
-bool
-render_xcursor_set(struct seat *seat, struct terminal *term, const char *xcursor)
-{
-    return true;
-}
-
-struct wl_window *
-wayl_win_init(struct terminal *term)
-{
-    return NULL;
-}
-
-void wayl_win_destroy(struct wl_window *win) {}
-bool wayl_win_set_urgent(struct wl_window *win) { return true; }
-
-bool
-spawn(struct reaper *reaper, const char *cwd, char *const argv[],
-      int stdin_fd, int stdout_fd, int stderr_fd)
-{
-    return true;
-}
-
-pid_t
-slave_spawn(
-    int ptmx, int argc, const char *cwd, char *const *argv, const char *term_env,
-    const char *conf_shell, bool login_shell,
-    const user_notifications_t *notifications)
-{
-    return 0;
-}
-
-int
-render_worker_thread(void *_ctx)
-{
-    return 0;
-}
-
-struct extraction_context *
-extract_begin(enum selection_kind kind, bool strip_trailing_empty)
-{
-    return NULL;
-}
-
-bool
-extract_one(
-    const struct terminal *term, const struct row *row, const struct cell *cell,
-    int col, void *context)
-{
-    return true;
-}
-
-bool
-extract_finish(struct extraction_context *context, char **text, size_t *len)
-{
-    return true;
-}
-
-void cmd_scrollback_up(struct terminal *term, int rows) {}
-void cmd_scrollback_down(struct terminal *term, int rows) {}
-
-void ime_enable(struct seat *seat) {}
-void ime_disable(struct seat *seat) {}
-void ime_reset_preedit(struct seat *seat) {}
-
-void
-notify_notify(const struct terminal *term, const char *title, const char *body)
-{
-}
-
-void reaper_add(struct reaper *reaper, pid_t pid, reaper_cb cb, void *cb_data) {}
-void reaper_del(struct reaper *reaper, pid_t pid) {}
-
-void urls_reset(struct terminal *term) {}
-
 int
 main(int argc, const char *const *argv)
 {
@@ -154,22 +36,6 @@ main(int argc, const char *const *argv)
     const int col_count = 135;
     const int grid_row_count = 16384;
 
-    int lower_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
-    if (lower_fd < 0)
-        return EXIT_FAILURE;
-
-    int upper_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
-    if (upper_fd < 0) {
-        close(lower_fd);
-        return EXIT_FAILURE;
-    }
-
-    struct row **rows = calloc(grid_row_count, sizeof(rows[0]));
-    for (int i = 0; i < grid_row_count; i++) {
-        rows[i] = calloc(1, sizeof(*rows[i]));
-        rows[i]->cells = calloc(col_count, sizeof(rows[i]->cells[0]));
-    }
-
     struct config conf = {
         .tweak = {
             .delayed_render_lower_ns = 500000,         /* 0.5ms */
@@ -183,49 +49,9 @@ main(int argc, const char *const *argv)
         .terms = tll_init(),
     };
 
-    struct terminal term = {
-        .conf = &conf,
-        .wl = &wayl,
-        .grid = &term.normal,
-        .normal = {
-            .num_rows = grid_row_count,
-            .num_cols = col_count,
-            .rows = rows,
-            .cur_row = rows[0],
-        },
-        .alt = {
-            .num_rows = grid_row_count,
-            .num_cols = col_count,
-            .rows = rows,
-            .cur_row = rows[0],
-        },
-        .scale = 1,
-        .width = col_count * 8,
-        .height = row_count * 15,
-        .cols = col_count,
-        .rows = row_count,
-        .cell_width = 8,
-        .cell_height = 15,
-        .scroll_region = {
-            .start = 0,
-            .end = row_count,
-        },
-        .selection = {
-            .start = {-1, -1},
-            .end = {-1, -1},
-        },
-        .delayed_render_timer = {
-            .lower_fd = lower_fd,
-            .upper_fd = upper_fd
-        },
-        .sixel = {
-            .palette_size = SIXEL_MAX_COLORS,
-            .max_width = SIXEL_MAX_WIDTH,
-            .max_height = SIXEL_MAX_HEIGHT,
-        },
-    };
-
-    tll_push_back(wayl.terms, &term);
+    struct terminal term;
+    headless_term_init(
+        &term, &conf, &wayl, col_count, row_count, grid_row_count - row_count);
 
     int ret = EXIT_FAILURE;
 
@@ -302,15 +128,6 @@ main(int argc, const char *const *argv)
     ret = EXIT_SUCCESS;
 
 out:
-    tll_free(wayl.terms);
-
-    for (int i = 0; i < grid_row_count; i++) {
-        free(rows[i]->cells);
-        free(rows[i]);
-    }
-
-    free(rows);
-    close(lower_fd);
-    close(upper_fd);
+    headless_term_destroy(&term);
     return ret;
 }
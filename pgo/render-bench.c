@@ -0,0 +1,942 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <tllist.h>
+#include <fcft/fcft.h>
+#include <pixman.h>
+#include <wayland-client.h>
+
+#include "config.h"
+#include "headless.h"
+#include "render.h"
+#include "selection.h"
+#include "shm.h"
+#include "sixel.h"
+#include "terminal.h"
+#include "user-notification.h"
+#include "util.h"
+#include "vt.h"
+#include "xmalloc.h"
+
+/*
+ * Headless render benchmark. Renders frames through the real
+ * grid_render() (via the renderer's FDM hook) and the real SHM buffer
+ * code, into memory backed pixman images.
+ *
+ * The compositor is replaced by stand-ins for the libwayland-client
+ * proxy functions, that the generated protocol code calls into. The
+ * fake compositor holds on to the last committed buffer until the
+ * next one is committed (like a real compositor; optionally, the last
+ * few committed buffers, like one that is lagging), fires the frame
+ * callback immediately after each frame, and keeps track of the
+ * damaged area.
+ *
+ * Each scenario mutates the terminal state through the VT parser,
+ * and/or the selection and search APIs, before each frame. Only the
+ * FDM hook (i.e. the frame) is measured.
+ */
+
+struct fake_proxy {
+    const struct wl_interface *interface;
+    uint32_t version;
+    const void *listener;
+    void *data;
+
+    /* wl_buffer */
+    int width;
+    int height;
+
+    /* wl_surface */
+    struct fake_proxy *attached;
+    struct fake_proxy *held[8];     /* Committed buffers, oldest first */
+    size_t held_count;
+    pixman_region32_t damage;
+};
+
+static struct {
+    tll(struct fake_proxy *) surfaces;
+    tll(struct fake_proxy *) frame_callbacks;
+    bool immediate_release;
+    size_t held_buffers;
+    uint64_t damaged_pixels;
+} compositor;
+
+static struct fake_proxy *
+fake_proxy_create(const struct wl_interface *interface, uint32_t version)
+{
+    struct fake_proxy *proxy = xcalloc(1, sizeof(*proxy));
+    proxy->interface = interface;
+    proxy->version = version;
+
+    if (interface == &wl_surface_interface) {
+        pixman_region32_init(&proxy->damage);
+        tll_push_back(compositor.surfaces, proxy);
+    } else if (interface == &wl_callback_interface)
+        tll_push_back(compositor.frame_callbacks, proxy);
+
+    return proxy;
+}
+
+static void
+buffer_release(struct fake_proxy *buf)
+{
+    const struct wl_buffer_listener *listener = buf->listener;
+    if (listener != NULL && listener->release != NULL)
+        listener->release(buf->data, (struct wl_buffer *)buf);
+}
+
+static void
+surface_commit(struct fake_proxy *surf)
+{
+    struct fake_proxy *buf = surf->attached;
+    surf->attached = NULL;
+
+    if (buf != NULL) {
+        pixman_region32_intersect_rect(
+            &surf->damage, &surf->damage, 0, 0, buf->width, buf->height);
+
+        int count;
+        const pixman_box32_t *boxes =
+            pixman_region32_rectangles(&surf->damage, &count);
+
+        for (int i = 0; i < count; i++) {
+            compositor.damaged_pixels +=
+                (uint64_t)(boxes[i].x2 - boxes[i].x1) *
+                (boxes[i].y2 - boxes[i].y1);
+        }
+
+        if (compositor.immediate_release)
+            buffer_release(buf);
+        else if (surf->held_count == 0 ||
+                 surf->held[surf->held_count - 1] != buf)
+        {
+            if (surf->held_count == compositor.held_buffers) {
+                buffer_release(surf->held[0]);
+                memmove(&surf->held[0], &surf->held[1],
+                        --surf->held_count * sizeof(surf->held[0]));
+            }
+            surf->held[surf->held_count++] = buf;
+        }
+    }
+
+    pixman_region32_clear(&surf->damage);
+}
+
+static struct wl_proxy *
+fake_request(struct fake_proxy *proxy, uint32_t opcode,
+             const struct wl_interface *interface, uint32_t version,
+             va_list ap)
+{
+    struct fake_proxy *new_proxy = NULL;
+
+    if (interface != NULL)
+        new_proxy = fake_proxy_create(interface, version);
+
+    if (proxy->interface == &wl_shm_pool_interface &&
+        opcode == WL_SHM_POOL_CREATE_BUFFER)
+    {
+        (void)va_arg(ap, void *);   /* new_id */
+        (void)va_arg(ap, int32_t);  /* offset */
+        new_proxy->width = va_arg(ap, int32_t);
+        new_proxy->height = va_arg(ap, int32_t);
+    }
+
+    else if (proxy->interface == &wl_surface_interface) {
+        switch (opcode) {
+        case WL_SURFACE_ATTACH:
+            proxy->attached = (struct fake_proxy *)va_arg(ap, struct wl_buffer *);
+            break;
+
+        case WL_SURFACE_DAMAGE_BUFFER: {
+            int32_t x = va_arg(ap, int32_t);
+            int32_t y = va_arg(ap, int32_t);
+            int32_t width = va_arg(ap, int32_t);
+            int32_t height = va_arg(ap, int32_t);
+
+            /* Clamp, to avoid overflowing when damaging INT32_MAX x INT32_MAX */
+            pixman_region32_union_rect(
+                &proxy->damage, &proxy->damage,
+                x, y, min(width, 0xffff), min(height, 0xffff));
+            break;
+        }
+
+        case WL_SURFACE_COMMIT:
+            surface_commit(proxy);
+            break;
+        }
+    }
+
+    return (struct wl_proxy *)new_proxy;
+}
+
+struct wl_proxy *
+wl_proxy_marshal_flags(struct wl_proxy *proxy, uint32_t opcode,
+                       const struct wl_interface *interface,
+                       uint32_t version, uint32_t flags, ...)
+{
+    va_list ap;
+    va_start(ap, flags);
+    struct wl_proxy *ret = fake_request(
+        (struct fake_proxy *)proxy, opcode, interface, version, ap);
+    va_end(ap);
+
+    if (flags & WL_MARSHAL_FLAG_DESTROY)
+        wl_proxy_destroy(proxy);
+    return ret;
+}
+
+/* Used by code generated with wayland-scanner < 1.20 */
+void
+wl_proxy_marshal(struct wl_proxy *proxy, uint32_t opcode, ...)
+{
+    va_list ap;
+    va_start(ap, opcode);
+    fake_request((struct fake_proxy *)proxy, opcode, NULL, 0, ap);
+    va_end(ap);
+}
+
+struct wl_proxy *
+wl_proxy_marshal_constructor(struct wl_proxy *proxy, uint32_t opcode,
+                             const struct wl_interface *interface, ...)
+{
+    va_list ap;
+    va_start(ap, interface);
+    struct wl_proxy *ret = fake_request(
+        (struct fake_proxy *)proxy, opcode, interface,
+        wl_proxy_get_version(proxy), ap);
+    va_end(ap);
+    return ret;
+}
+
+struct wl_proxy *
+wl_proxy_marshal_constructor_versioned(struct wl_proxy *proxy, uint32_t opcode,
+                                       const struct wl_interface *interface,
+                                       uint32_t version, ...)
+{
+    va_list ap;
+    va_start(ap, version);
+    struct wl_proxy *ret = fake_request(
+        (struct fake_proxy *)proxy, opcode, interface, version, ap);
+    va_end(ap);
+    return ret;
+}
+
+int
+wl_proxy_add_listener(struct wl_proxy *_proxy,
+                      void (**implementation)(void), void *data)
+{
+    struct fake_proxy *proxy = (struct fake_proxy *)_proxy;
+    proxy->listener = implementation;
+    proxy->data = data;
+    return 0;
+}
+
+uint32_t
+wl_proxy_get_version(struct wl_proxy *proxy)
+{
+    return ((struct fake_proxy *)proxy)->version;
+}
+
+void
+wl_proxy_destroy(struct wl_proxy *_proxy)
+{
+    struct fake_proxy *proxy = (struct fake_proxy *)_proxy;
+
+    tll_foreach(compositor.frame_callbacks, it) {
+        if (it->item == proxy)
+            tll_remove(compositor.frame_callbacks, it);
+    }
+
+    tll_foreach(compositor.surfaces, it) {
+        struct fake_proxy *surf = it->item;
+
+        if (surf == proxy) {
+            pixman_region32_fini(&surf->damage);
+            tll_remove(compositor.surfaces, it);
+            continue;
+        }
+
+        if (surf->attached == proxy)
+            surf->attached = NULL;
+        for (size_t i = 0; i < surf->held_count; i++) {
+            if (surf->held[i] == proxy) {
+                memmove(&surf->held[i], &surf->held[i + 1],
+                        (surf->held_count - i - 1) * sizeof(surf->held[0]));
+                surf->held_count--;
+                break;
+            }
+        }
+    }
+
+    free(proxy);
+}
+
+/* "Presents" the last frame */
+static void
+compositor_frame_done(void)
+{
+    while (tll_length(compositor.frame_callbacks) > 0) {
+        struct fake_proxy *cb = tll_pop_front(compositor.frame_callbacks);
+        const struct wl_callback_listener *listener = cb->listener;
+
+        /* The listener destroys the callback */
+        if (listener != NULL)
+            listener->done(cb->data, (struct wl_callback *)cb, 0);
+        else
+            free(cb);
+    }
+}
+
+/* Like an unmapped window; releases all buffers */
+static void
+compositor_release_all(void)
+{
+    tll_foreach(compositor.surfaces, it) {
+        struct fake_proxy *surf = it->item;
+        for (size_t i = 0; i < surf->held_count; i++)
+            buffer_release(surf->held[i]);
+        surf->held_count = 0;
+    }
+}
+
+static fdm_hook_t refresh_hook;
+static void *refresh_hook_data;
+
+bool
+fdm_hook_add(struct fdm *fdm, fdm_hook_t hook, void *data,
+             enum fdm_hook_priority priority)
+{
+    refresh_hook = hook;
+    refresh_hook_data = data;
+    return true;
+}
+
+bool
+fdm_hook_del(struct fdm *fdm, fdm_hook_t hook, enum fdm_hook_priority priority)
+{
+    refresh_hook = NULL;
+    refresh_hook_data = NULL;
+    return true;
+}
+
+/*
+ * Scenarios
+ */
+
+struct scenario {
+    const char *name;
+    void (*setup)(struct terminal *term);
+    void (*frame)(struct terminal *term, int frame_no);
+    void (*teardown)(struct terminal *term);
+};
+
+static void
+write_str(struct terminal *term, const char *s)
+{
+    vt_from_slave(term, (const uint8_t *)s, strlen(s));
+}
+
+static void
+write_fmt(struct terminal *term, const char *fmt, ...)
+{
+    char buf[1024];
+
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+
+    write_str(term, buf);
+}
+
+static uint32_t
+rand_next(uint32_t *state)
+{
+    /* Deterministic; every run renders the same content */
+    *state = *state * 1103515245 + 12345;
+    return *state >> 16;
+}
+
+/* Writes a line of words, with a sprinkle of SGR attributes */
+static void
+write_line(struct terminal *term, uint32_t seed)
+{
+    static const char *const words[] = {
+        "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog",
+        "lorem", "ipsum", "dolor", "sit", "amet", "foo", "bar", "baz",
+        "/usr/bin/foot", "--help", "42", "0x7f", "&&", "{", "}", "==",
+        "─────", "│", "漢字", "テキスト", "e\xcc\x81", "\xf0\x9f\x99\x82",
+    };
+
+    uint32_t state = seed;
+    int col = 0;
+
+    while (col < term->cols - 12) {
+        const char *word = words[rand_next(&state) % ALEN(words)];
+
+        switch (rand_next(&state) % 8) {
+        case 0: write_fmt(term, "\033[%um", 31 + rand_next(&state) % 7); break;
+        case 1: write_fmt(term, "\033[38;5;%um", rand_next(&state) % 256); break;
+        case 2: write_fmt(term, "\033[%um", 1 + rand_next(&state) % 4); break;
+        case 3: write_fmt(term, "\033[%um", 41 + rand_next(&state) % 7); break;
+        case 4: write_str(term, "\033[m"); break;
+        }
+
+        write_fmt(term, "%s ", word);
+        col += strlen(word) + 1;
+    }
+
+    write_str(term, "\033[m\033[K");
+}
+
+static void
+fill_screen(struct terminal *term)
+{
+    write_str(term, "\033[H\033[2J");
+    for (int r = 0; r < term->rows; r++) {
+        write_fmt(term, "\033[%d;1H", r + 1);
+        write_line(term, r);
+    }
+    write_str(term, "\033[H");
+}
+
+static void
+full_redraw_frame(struct terminal *term, int frame_no)
+{
+    term_damage_view(term);
+}
+
+static void
+single_line_frame(struct terminal *term, int frame_no)
+{
+    write_fmt(term, "\033[%d;1H", term->rows / 2);
+    write_line(term, frame_no);
+}
+
+static void
+scroll_status_setup(struct terminal *term)
+{
+    fill_screen(term);
+
+    /* Everything but the last line scrolls */
+    write_fmt(term, "\033[1;%dr", term->rows - 1);
+}
+
+static void
+scroll_status_frame(struct terminal *term, int frame_no)
+{
+    write_fmt(term, "\033[%d;1H", term->rows - 1);
+    for (int i = 0; i < 3; i++) {
+        write_str(term, "\r\n");
+        write_line(term, frame_no * 3 + i);
+    }
+
+    write_fmt(term, "\0337\033[%d;1H\033[7m status: frame %d \033[K\033[m\0338",
+              term->rows, frame_no);
+}
+
+static void
+scroll_status_teardown(struct terminal *term)
+{
+    write_str(term, "\033[r");
+}
+
+static void
+selection_setup(struct terminal *term)
+{
+    fill_screen(term);
+    selection_start(term, 4, term->rows / 4, SELECTION_CHAR_WISE, false);
+}
+
+static void
+selection_frame(struct terminal *term, int frame_no)
+{
+    /* Drag the selection's end point back and forth */
+    const int range = term->rows / 2;
+    const int step = frame_no % (2 * range);
+    const int row = term->rows / 4 + 1 + (step < range ? step : 2 * range - step);
+
+    selection_update(term, (frame_no * 7) % term->cols, row);
+}
+
+static void
+selection_teardown(struct terminal *term)
+{
+    selection_cancel(term);
+}
+
+static void
+search_setup(struct terminal *term)
+{
+    fill_screen(term);
+
+    /* Only the dimming; the search box itself isn't rendered */
+    term->is_searching = true;
+}
+
+static void
+search_teardown(struct terminal *term)
+{
+    term->is_searching = false;
+}
+
+static void
+write_sixel(struct terminal *term, int row, int col, int width, int height)
+{
+    write_fmt(term, "\033[%d;%dH\033P;1q\"1;1;%d;%d", row, col, width, height);
+    write_str(term, "#1;2;100;50;0#2;2;0;50;100#3;2;20;80;20");
+
+    for (int band = 0; band < (height + 5) / 6; band++) {
+        write_fmt(term, "#%d!%d~$#%d!%dA-",
+                  1 + band % 3, width, 1 + (band + 1) % 3, width / 2);
+    }
+
+    write_str(term, "\033\\");
+}
+
+static void
+sixel_setup(struct terminal *term)
+{
+    fill_screen(term);
+
+    const int width = term->cols * term->cell_width / 3;
+    const int height = term->rows * term->cell_height / 3;
+
+    write_sixel(term, 2, 2, width, height);
+    write_sixel(term, term->rows / 2, term->cols / 2, width, height);
+}
+
+static const struct scenario scenarios[] = {
+    {"full-redraw", &fill_screen, &full_redraw_frame, NULL},
+    {"single-line", &fill_screen, &single_line_frame, NULL},
+    {"scroll-status", &scroll_status_setup, &scroll_status_frame, &scroll_status_teardown},
+    {"selection", &selection_setup, &selection_frame, &selection_teardown},
+    {"search", &search_setup, &full_redraw_frame, &search_teardown},
+    {"sixel", &sixel_setup, &full_redraw_frame, NULL},
+};
+
+/*
+ * Terminal setup
+ */
+
+static bool
+load_fonts(struct terminal *term, const struct config *conf)
+{
+    static const char *const styles[4] = {
+        "", ":weight=bold", ":slant=italic", ":weight=bold:slant=italic",
+    };
+
+    for (size_t i = 0; i < 4; i++) {
+        /* Fallback to the regular font, with bold/italic attributes */
+        const bool custom = tll_length(conf->fonts[i]) > 0;
+        const size_t idx = custom ? i : 0;
+        const size_t count = tll_length(conf->fonts[idx]);
+
+        char **names = xcalloc(count, sizeof(names[0]));
+
+        size_t j = 0;
+        tll_foreach(conf->fonts[idx], it) {
+            char size[64];
+            if (it->item.px_size > 0)
+                snprintf(size, sizeof(size), ":pixelsize=%d", it->item.px_size);
+            else
+                snprintf(size, sizeof(size), ":size=%.2f", it->item.pt_size);
+
+            names[j] = xmalloc(strlen(it->item.pattern) + strlen(size) + 1);
+            strcpy(names[j], it->item.pattern);
+            strcat(names[j], size);
+            j++;
+        }
+
+        char attrs[64];
+        snprintf(attrs, sizeof(attrs), "dpi=%.2f%s",
+                 term->font_dpi, custom ? "" : styles[i]);
+
+        term->fonts[i] = fcft_from_name(count, (const char **)names, attrs);
+
+        for (j = 0; j < count; j++)
+            free(names[j]);
+        free(names);
+
+        if (term->fonts[i] == NULL) {
+            fprintf(stderr, "error: failed to load fonts\n");
+            return false;
+        }
+    }
+
+    term->cell_width =
+        (term->fonts[0]->space_advance.x > 0
+         ? term->fonts[0]->space_advance.x
+         : term->fonts[0]->max_advance.x)
+        + term_pt_or_px_as_pixels(term, &conf->letter_spacing);
+
+    term->cell_height = term->font_line_height.px >= 0
+        ? term_pt_or_px_as_pixels(term, &term->font_line_height)
+        : max(term->fonts[0]->height,
+              term->fonts[0]->ascent + term->fonts[0]->descent);
+
+    term->font_x_ofs = term_pt_or_px_as_pixels(term, &conf->horizontal_letter_offset);
+    term->font_y_ofs = term_pt_or_px_as_pixels(term, &conf->vertical_letter_offset);
+    return true;
+}
+
+static void
+set_worker_count(struct terminal *term, size_t count)
+{
+    /* The buffers have one pixman instance per thread */
+    compositor_release_all();
+    shm_purge(term->wl->shm, shm_cookie_grid(term));
+    term->render.last_buf = NULL;
+
+    /* Start each run with cold glyph caches */
+    render_glyph_caches_invalidate();
+
+    /* The renderer spawns its threads on demand */
+    term->render.workers.count = count;
+}
+
+/*
+ * Measurements
+ */
+
+struct stats {
+    int frames;
+    double total;
+    double reapply;
+    double scroll;
+    double sixel;
+    double rows;
+    double commit;
+    uint64_t threads;
+    uint64_t damaged_pixels;
+};
+
+static double
+timespec_to_secs(const struct timespec *ts)
+{
+    return ts->tv_sec + ts->tv_nsec / 1000000000.;
+}
+
+static void
+render_frame(struct terminal *term, struct stats *stats)
+{
+    render_refresh(term);
+
+    uint64_t damaged_pixels = compositor.damaged_pixels;
+
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    refresh_hook(NULL, refresh_hook_data);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+
+    compositor_frame_done();
+
+    if (stats == NULL)
+        return;
+
+    stats->frames++;
+    stats->total +=
+        (stop.tv_sec - start.tv_sec) +
+        (stop.tv_nsec - start.tv_nsec) / 1000000000.;
+    stats->reapply += timespec_to_secs(&term->render.timings.reapply);
+    stats->scroll += timespec_to_secs(&term->render.timings.scroll);
+    stats->sixel += timespec_to_secs(&term->render.timings.sixel);
+    stats->rows += timespec_to_secs(&term->render.timings.rows);
+    stats->commit += timespec_to_secs(&term->render.timings.commit);
+    stats->threads += term->render.timings.threads;
+    stats->damaged_pixels += compositor.damaged_pixels - damaged_pixels;
+}
+
+static void
+run_scenario(struct terminal *term, const struct scenario *scenario,
+             int frames, struct stats *stats)
+{
+    /* Start every scenario from the same state */
+    write_str(term, "\033[?1049l\033[m\033[r\033[H\033[2J");
+    scenario->setup(term);
+
+    /* Warm up the glyph caches, and get past the initial full repaint */
+    for (int i = 0; i < 10; i++) {
+        scenario->frame(term, i);
+        render_frame(term, NULL);
+    }
+
+    *stats = (struct stats){0};
+    for (int i = 0; i < frames; i++) {
+        scenario->frame(term, 10 + i);
+        render_frame(term, stats);
+    }
+
+    if (scenario->teardown != NULL)
+        scenario->teardown(term);
+    render_frame(term, NULL);
+}
+
+static void
+print_usage(const char *prog_name)
+{
+    printf(
+        "Usage: %s [OPTIONS...] [scenario1 scenario2 ... scenarioN]\n"
+        "\n"
+        "Options:\n"
+        "  -c,--config=PATH               load configuration from PATH (/dev/null)\n"
+        "  -f,--frames=N                  number of frames to render per scenario (500)\n"
+        "  -w,--workers=N[,N...]          render worker counts to run each scenario with (1,2,4,8)\n"
+        "  -s,--size=COLSxROWS            terminal size, in cells (135x67)\n"
+        "  -r,--immediate-release         compositor releases buffers immediately after commit\n"
+        "  -H,--held-buffers=N            number of committed buffers the compositor holds on to (1)\n"
+        "  -h,--help                      show this help and exit\n"
+        "\n"
+        "Scenarios:\n",
+        prog_name);
+
+    for (size_t i = 0; i < ALEN(scenarios); i++)
+        printf("  %s\n", scenarios[i].name);
+
+    printf(
+        "\n"
+        "Prints frames/s, and the average time (µs) spent in each phase of a\n"
+        "frame, for each scenario and worker count. 'damage' is the average\n"
+        "part of the window damaged by each frame\n");
+}
+
+int
+main(int argc, char *const *argv)
+{
+    const char *const prog_name = argv[0];
+
+    static const struct option longopts[] = {
+        {"config",            required_argument, NULL, 'c'},
+        {"frames",            required_argument, NULL, 'f'},
+        {"workers",           required_argument, NULL, 'w'},
+        {"size",              required_argument, NULL, 's'},
+        {"immediate-release", no_argument,       NULL, 'r'},
+        {"held-buffers",      required_argument, NULL, 'H'},
+        {"help",              no_argument,       NULL, 'h'},
+        {NULL,                no_argument,       NULL,   0},
+    };
+
+    const char *conf_path = "/dev/null";
+    int frames = 500;
+    const char *workers = "1,2,4,8";
+    int cols = 135;
+    int rows = 67;
+
+    compositor.held_buffers = 1;
+
+    while (true) {
+        int c = getopt_long(argc, argv, "c:f:w:s:rH:h", longopts, NULL);
+
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 'c':
+            conf_path = optarg;
+            break;
+
+        case 'f':
+            frames = atoi(optarg);
+            if (frames <= 0) {
+                fprintf(stderr, "error: %s: invalid frame count\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+
+        case 'w':
+            workers = optarg;
+            break;
+
+        case 's':
+            if (sscanf(optarg, "%dx%d", &cols, &rows) != 2 ||
+                cols < 16 || rows < 8)
+            {
+                fprintf(stderr, "error: %s: invalid size\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+
+        case 'r':
+            compositor.immediate_release = true;
+            break;
+
+        case 'H': {
+            int held = atoi(optarg);
+            if (held <= 0 || (size_t)held > ALEN(((struct fake_proxy *)NULL)->held)) {
+                fprintf(stderr, "error: %s: invalid held buffer count\n", optarg);
+                return EXIT_FAILURE;
+            }
+            compositor.held_buffers = held;
+            break;
+        }
+
+        case 'h':
+            print_usage(prog_name);
+            return EXIT_SUCCESS;
+
+        case '?':
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* Validate scenario names before doing anything expensive */
+    for (int i = optind; i < argc; i++) {
+        bool found = false;
+        for (size_t j = 0; j < ALEN(scenarios); j++)
+            found = found || strcmp(argv[i], scenarios[j].name) == 0;
+
+        if (!found) {
+            fprintf(stderr, "error: %s: no such scenario\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    struct config conf = {0};
+    user_notifications_t user_notifications = tll_init();
+    config_override_t overrides = tll_init();
+
+    if (!config_load(&conf, conf_path, &user_notifications, &overrides, true)) {
+        config_free(conf);
+        return EXIT_FAILURE;
+    }
+
+    shm_set_max_pool_size(conf.tweak.max_shm_pool_size);
+
+    int ret = EXIT_FAILURE;
+
+    struct wayland wayl = {
+        .conf = &conf,
+        .shm = (struct wl_shm *)fake_proxy_create(&wl_shm_interface, 1),
+        .seats = tll_init(),
+        .monitors = tll_init(),
+        .terms = tll_init(),
+    };
+
+    struct wl_window win = {
+        .surface = (struct wl_surface *)fake_proxy_create(&wl_surface_interface, 4),
+        .use_csd = CSD_NO,
+        .is_configured = true,
+    };
+
+    struct terminal term;
+    headless_term_init(&term, &conf, &wayl, cols, rows, conf.scrollback.lines);
+
+    term.window = &win;
+    term.font_dpi = 96.;
+    term.font_line_height = conf.line_height;
+    term.font_subpixel = conf.colors.alpha == 0xffff
+        ? FCFT_SUBPIXEL_DEFAULT
+        : FCFT_SUBPIXEL_NONE;
+    term.colors = (struct term_colors){
+        .fg = conf.colors.fg,
+        .bg = conf.colors.bg,
+        .alpha = conf.colors.alpha,
+        .selection_fg = conf.colors.selection_fg,
+        .selection_bg = conf.colors.selection_bg,
+        .use_custom_selection = conf.colors.use_custom.selection,
+    };
+    term.cursor_style = conf.cursor.style;
+    term.cursor_blink.state = CURSOR_BLINK_ON;
+    term.cursor_color.text = conf.cursor.color.text;
+    term.cursor_color.cursor = conf.cursor.color.cursor;
+    term.visual_focus = true;
+    term.kbd_focus = true;
+
+    memcpy(term.colors.table, conf.colors.table, sizeof(term.colors.table));
+
+    mtx_init(&term.render.workers.lock, mtx_plain);
+
+    struct renderer *renderer = NULL;
+
+    if (!load_fonts(&term, &conf))
+        goto out;
+
+    term.margins.left = term.margins.right = conf.pad_x;
+    term.margins.top = term.margins.bottom = conf.pad_y;
+    term.width = cols * term.cell_width + 2 * conf.pad_x;
+    term.height = rows * term.cell_height + 2 * conf.pad_y;
+
+    renderer = render_init(NULL, &wayl);
+    if (renderer == NULL || refresh_hook == NULL)
+        goto out;
+
+    printf("%-16s %7s %9s %9s %9s %9s %9s %9s %9s %7s %7s\n",
+           "scenario", "workers", "frames/s", "total", "reapply",
+           "scroll", "sixel", "rows", "commit", "threads", "damage");
+
+    for (size_t i = 0; i < ALEN(scenarios); i++) {
+        const struct scenario *scenario = &scenarios[i];
+
+        bool selected = optind >= argc;
+        for (int j = optind; j < argc; j++)
+            selected = selected || strcmp(argv[j], scenario->name) == 0;
+
+        if (!selected)
+            continue;
+
+        for (const char *w = workers; *w != '\0'; ) {
+            char *end;
+            long count = strtol(w, &end, 10);
+
+            if (end == w || count < 0 || (*end != ',' && *end != '\0')) {
+                fprintf(stderr, "error: %s: invalid worker count list\n", workers);
+                goto out;
+            }
+
+            w = *end == ',' ? end + 1 : end;
+
+            set_worker_count(&term, count);
+
+            struct stats stats;
+            run_scenario(&term, scenario, frames, &stats);
+
+            const double n = stats.frames;
+            printf("%-16s %7ld %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %7.1f %6.1f%%\n",
+                   scenario->name, count,
+                   n / stats.total,
+                   stats.total / n * 1000000.,
+                   stats.reapply / n * 1000000.,
+                   stats.scroll / n * 1000000.,
+                   stats.sixel / n * 1000000.,
+                   stats.rows / n * 1000000.,
+                   stats.commit / n * 1000000.,
+                   stats.threads / n,
+                   100. * stats.damaged_pixels / n / ((double)term.width * term.height));
+            fflush(stdout);
+        }
+    }
+
+    ret = EXIT_SUCCESS;
+
+out:
+    render_destroy(renderer);
+    compositor_release_all();
+    shm_fini();
+
+    headless_term_destroy(&term);
+
+    for (size_t i = 0; i < ALEN(term.fonts); i++)
+        fcft_destroy(term.fonts[i]);
+
+    for (size_t i = 0; i < ALEN(term.box_drawing); i++) {
+        if (term.box_drawing[i] == NULL)
+            continue;
+        free(pixman_image_get_data(term.box_drawing[i]->pix));
+        pixman_image_unref(term.box_drawing[i]->pix);
+        free(term.box_drawing[i]);
+    }
+
+    mtx_destroy(&term.render.workers.lock);
+
+    wl_proxy_destroy((struct wl_proxy *)win.surface);
+    wl_proxy_destroy((struct wl_proxy *)wayl.shm);
+
+    config_free(conf);
+    user_notifications_free(&user_notifications);
+    return ret;
+}
@@ -0,0 +1,24 @@
+#include "render.h"
+
+/*
+ * Renderer stubs, for the binaries that only exercise the VT and grid
+ * code (the PGO helper, and foot-bench).
+ */
+
+bool
+render_resize_force(struct terminal *term, int width, int height)
+{
+    return true;
+}
+
+void render_refresh(struct terminal *term) {}
+void render_refresh_csd(struct terminal *term) {}
+void render_refresh_title(struct terminal *term) {}
+
+bool
+render_xcursor_set(struct seat *seat, struct terminal *term, const char *xcursor)
+{
+    return true;
+}
+
+void render_glyph_caches_invalidate(void) {}
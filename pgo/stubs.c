@@ -0,0 +1,180 @@
+#include <sys/types.h>
+
+#include "async.h"
+#include "config.h"
+#include "reaper.h"
+#include "user-notification.h"
+#include "vt.h"
+#include "xmalloc.h"
+
+/*
+ * Stubs for everything the VT and grid code (pgolib) needs, but that
+ * requires a compositor, a shell, or a running FDM. Used by the PGO
+ * helper, foot-bench and foot-render-bench.
+ *
+ * The renderer is stubbed out separately, in stubs-render.c, since
+ * foot-render-bench links the real one.
+ */
+
+enum async_write_status
+async_write(int fd, const void *data, size_t len, size_t *idx)
+{
+    return ASYNC_WRITE_DONE;
+}
+
+bool
+fdm_add(struct fdm *fdm, int fd, int events, fdm_fd_handler_t handler, void *data)
+{
+    return true;
+}
+
+bool
+fdm_del(struct fdm *fdm, int fd)
+{
+    return true;
+}
+
+bool
+fdm_del_no_close(struct fdm *fdm, int fd)
+{
+    return true;
+}
+
+bool
+fdm_event_add(struct fdm *fdm, int fd, int events)
+{
+    return true;
+}
+
+bool
+fdm_event_del(struct fdm *fdm, int fd, int events)
+{
+    return true;
+}
+
+bool
+fdm_set_low_priority(struct fdm *fdm, int fd)
+{
+    return true;
+}
+
+void
+fdm_lock(struct fdm *fdm)
+{
+}
+
+void
+fdm_unlock(struct fdm *fdm)
+{
+}
+
+void
+fdm_wake(struct fdm *fdm)
+{
+}
+
+/* Timers never expire; all that is needed is a unique handle */
+struct fdm_timer *
+fdm_timer_add(struct fdm *fdm, fdm_timer_handler_t handler, void *data)
+{
+    return xmalloc(1);
+}
+
+bool
+fdm_timer_del(struct fdm *fdm, struct fdm_timer *timer)
+{
+    free(timer);
+    return true;
+}
+
+bool
+fdm_timer_set(struct fdm *fdm, struct fdm_timer *timer,
+              uint64_t value_ns, uint64_t interval_ns)
+{
+    return true;
+}
+
+uint64_t
+fdm_timer_remaining(const struct fdm_timer *timer)
+{
+    return 0;
+}
+
+struct wl_window *
+wayl_win_init(struct terminal *term)
+{
+    return NULL;
+}
+
+void wayl_win_destroy(struct wl_window *win) {}
+bool wayl_win_set_urgent(struct wl_window *win) { return true; }
+
+bool
+wayl_win_subsurface_new(struct wl_window *win, struct wl_surf_subsurf *surf)
+{
+    return false;
+}
+
+void wayl_win_subsurface_destroy(struct wl_surf_subsurf *surf) {}
+
+bool
+spawn(struct reaper *reaper, const char *cwd, char *const argv[],
+      int stdin_fd, int stdout_fd, int stderr_fd)
+{
+    return true;
+}
+
+pid_t
+slave_spawn(
+    int ptmx, int argc, const char *cwd, char *const *argv, const char *term_env,
+    const char *conf_shell, bool login_shell,
+    const user_notifications_t *notifications)
+{
+    return 0;
+}
+
+struct extraction_context *
+extract_begin(enum selection_kind kind, bool strip_trailing_empty)
+{
+    return NULL;
+}
+
+bool
+extract_one(
+    const struct terminal *term, const struct row *row, const struct cell *cell,
+    int col, void *context)
+{
+    return true;
+}
+
+bool
+extract_one_composed(
+    const struct terminal *term, const struct row *row, const struct cell *cell,
+    const struct composed *composed, int col, void *context)
+{
+    return true;
+}
+
+bool
+extract_finish(struct extraction_context *context, char **text, size_t *len)
+{
+    return true;
+}
+
+void cmd_scrollback_up(struct terminal *term, int rows) {}
+void cmd_scrollback_down(struct terminal *term, int rows) {}
+
+void ime_enable(struct seat *seat) {}
+void ime_disable(struct seat *seat) {}
+void ime_reset_preedit(struct seat *seat) {}
+void ime_update_cursor_rect(struct seat *seat) {}
+
+void
+notify_notify(const struct terminal *term, const char *title, const char *body)
+{
+}
+
+void reaper_add(struct reaper *reaper, pid_t pid, reaper_cb cb, void *cb_data) {}
+void reaper_del(struct reaper *reaper, pid_t pid) {}
+
+void urls_reset(struct terminal *term) {}
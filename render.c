@@ -1,6 +1,10 @@
 #include "render.h"
 
 #include <string.h>
+#include <math.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <wctype.h>
 #include <unistd.h>
 #include <signal.h>
@@ -39,6 +43,7 @@
 #include "sixel.h"
 #include "url-mode.h"
 #include "util.h"
+#include "wcwidth.h"
 #include "xmalloc.h"
 
 #define TIME_SCROLL_DAMAGE 0
@@ -55,7 +60,105 @@ static struct {
     size_t two;   /* commits presented in two or more frame intervals */
 } presentation_statistics = {0};
 
+/*
+ * A render thread's share of a frame's dirty rows; [begin, end)
+ * indices into workers.rows, packed into a single word. The owner
+ * takes rows from the front, other threads steal from the back.
+ */
+struct render_worker_deque {
+    alignas(64) _Atomic uint64_t range;  /* Own cache line */
+};
+
+/* A dirty row in the frame being rendered */
+struct dirty_row {
+    int row_no;     /* View relative */
+    int first_col;  /* Left-most dirty cell, or -1 if there is none */
+    int last_col;   /* Right-most cell painted when rendering the dirty cells */
+    struct row *live;   /* The grid row it was copied from, see snapshot_rows() */
+};
+
+/*
+ * Render threads, shared by all terminals (i.e. all windows, in
+ * server mode). Frames are rendered one at a time, by the main
+ * thread, which wakes as many threads as the frame's dirty rows
+ * warrant, and renders rows itself too.
+ *
+ * Threads are spawned on demand, up to the largest worker count of
+ * any terminal, and live until the renderer is destroyed.
+ */
+static struct {
+    bool initialized;
+    size_t count;
+    thrd_t *threads;
+    sem_t start;
+    sem_t done;
+    _Atomic bool quit;
+
+    /* The frame currently being rendered */
+    struct terminal *term;
+    struct buffer *buf;
+    struct coord cursor;
+    size_t thread_count;            /* Including the main thread */
+    _Atomic int next_id;            /* Hands out pixman instances and deques to woken threads */
+    struct dirty_row *rows;
+    int rows_size;
+    struct render_worker_deque *deques;  /* One per thread, plus one for the main thread */
+    _Atomic long long busy_ns;      /* Time spent in render_rows(), by all threads */
+    _Atomic bool blinking;          /* Rendered a blinking cell, with no blink timer armed */
+
+    /*
+     * Frame cost model, see render_workers_for_frame(). Calibrated
+     * when threads are spawned, and then continuously, from the
+     * frames we render.
+     */
+    struct {
+        double ns_per_px;           /* Time to render one pixel of a dirty cell */
+        double wake_ns;             /* Overhead added by each woken thread */
+    } cost;
+} workers = {
+    .cost = {
+        .ns_per_px = 2.,
+        .wake_ns = 20000.,
+    },
+};
+
+/*
+ * pixman glyph caches aren't thread safe, so each thread has its
+ * own. They are keyed on glyph pointers, and must be dropped when
+ * glyphs are freed; threads do this lazily, by comparing their
+ * cache's generation with the global one.
+ */
+static atomic_uint glyph_cache_generation = 0;
+static _Thread_local pixman_glyph_cache_t *thread_glyph_cache = NULL;
+static _Thread_local unsigned thread_glyph_cache_generation = 0;
+
+static void
+timespec_sub(const struct timespec *a, const struct timespec *b,
+             struct timespec *res)
+{
+    res->tv_sec = a->tv_sec - b->tv_sec;
+    res->tv_nsec = a->tv_nsec - b->tv_nsec;
+
+    if (res->tv_nsec < 0) {
+        res->tv_sec--;
+        res->tv_nsec += 1000000000;
+    }
+}
+
+static long long
+timespec_to_usecs(const struct timespec *ts)
+{
+    return (long long)ts->tv_sec * 1000000 + ts->tv_nsec / 1000;
+}
+
+static long long
+timespec_to_nsecs(const struct timespec *ts)
+{
+    return (long long)ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
 static void fdm_hook_refresh_pending_terminals(struct fdm *fdm, void *data);
+static int render_worker_thread(void *_id);
 
 struct renderer *
 render_init(struct fdm *fdm, struct wayland *wayl)
@@ -91,6 +194,33 @@ render_destroy(struct renderer *renderer)
     fdm_hook_del(renderer->fdm, &fdm_hook_refresh_pending_terminals,
                  FDM_HOOK_PRIORITY_NORMAL);
 
+    if (workers.initialized) {
+        atomic_store(&workers.quit, true);
+        for (size_t i = 0; i < workers.count; i++)
+            sem_post(&workers.start);
+        for (size_t i = 0; i < workers.count; i++)
+            thrd_join(workers.threads[i], NULL);
+
+        sem_destroy(&workers.start);
+        sem_destroy(&workers.done);
+        free(workers.threads);
+        free(workers.rows);
+        free(workers.deques);
+
+        workers.initialized = false;
+        workers.count = 0;
+        workers.threads = NULL;
+        workers.rows = NULL;
+        workers.rows_size = 0;
+        workers.deques = NULL;
+        atomic_store(&workers.quit, false);
+    }
+
+    if (thread_glyph_cache != NULL) {
+        pixman_glyph_cache_destroy(thread_glyph_cache);
+        thread_glyph_cache = NULL;
+    }
+
     free(renderer);
 }
 
@@ -219,10 +349,10 @@ static const struct wp_presentation_feedback_listener presentation_feedback_list
 };
 
 static struct fcft_font *
-attrs_to_font(const struct terminal *term, const struct attributes *attrs)
+attrs_to_font(const struct render_snapshot *snap, const struct attributes *attrs)
 {
     int idx = attrs->italic << 1 | attrs->bold;
-    return term->fonts[idx];
+    return snap->fonts[idx];
 }
 
 static inline pixman_color_t
@@ -259,9 +389,10 @@ color_brighten(const struct terminal *term, uint32_t color)
      * find a match, return the corresponding bright color.
      */
     if (term->conf->bold_in_bright.palette_based) {
+        const struct term_colors *colors = &term->render.snapshot.colors;
         for (size_t i = 0; i < 8; i++) {
-            if (term->colors.table[i] == color)
-                return term->colors.table[i + 8];
+            if (colors->table[i] == color)
+                return colors->table[i + 8];
         }
     }
 
@@ -278,6 +409,13 @@ color_dim_for_search(pixman_color_t *color)
     color->blue /= 2;
 }
 
+static inline bool
+color_eq(const pixman_color_t *a, const pixman_color_t *b)
+{
+    return a->red == b->red && a->green == b->green &&
+           a->blue == b->blue && a->alpha == b->alpha;
+}
+
 static inline int
 font_baseline(const struct terminal *term)
 {
@@ -300,26 +438,26 @@ draw_unfocused_block(const struct terminal *term, pixman_image_t *pix,
 
 static void
 draw_beam_cursor(const struct terminal *term, pixman_image_t *pix,
-                 const struct fcft_font *font,
+                 const struct fcft_font *primary,
                  const pixman_color_t *color, int x, int y)
 {
-    int baseline = y + font_baseline(term) - term->fonts[0]->ascent;
+    int top = y + term->font_y_ofs;
     pixman_image_fill_rectangles(
         PIXMAN_OP_SRC, pix, color,
         1, &(pixman_rectangle16_t){
-            x, baseline,
+            x, top,
             term_pt_or_px_as_pixels(term, &term->conf->cursor.beam_thickness),
-            term->fonts[0]->ascent + term->fonts[0]->descent});
+            primary->ascent + primary->descent});
 }
 
 static void
 draw_underline_with_thickness(
     const struct terminal *term, pixman_image_t *pix,
-    const struct fcft_font *font,
+    const struct fcft_font *font, int baseline,
     const pixman_color_t *color, int x, int y, int cols, int thickness)
 {
     /* Make sure the line isn't positioned below the cell */
-    int y_ofs = font_baseline(term) - font->underline.position;
+    int y_ofs = baseline - font->underline.position;
     y_ofs = min(y_ofs, term->cell_height - thickness);
 
     pixman_image_fill_rectangles(
@@ -330,7 +468,7 @@ draw_underline_with_thickness(
 
 static void
 draw_underline_cursor(const struct terminal *term, pixman_image_t *pix,
-               const struct fcft_font *font,
+                      const struct fcft_font *font, int baseline,
                       const pixman_color_t *color, int x, int y, int cols)
 {
     int thickness = term->conf->cursor.underline_thickness.px >= 0
@@ -339,51 +477,67 @@ draw_underline_cursor(const struct terminal *term, pixman_image_t *pix,
         : font->underline.thickness;
 
     draw_underline_with_thickness(
-        term, pix, font, color, x, y + font->underline.thickness, cols,
-        thickness);
+        term, pix, font, baseline, color, x, y + font->underline.thickness,
+        cols, thickness);
 }
 
 static void
 draw_underline(const struct terminal *term, pixman_image_t *pix,
-               const struct fcft_font *font,
+               const struct fcft_font *font, int baseline,
                const pixman_color_t *color, int x, int y, int cols)
 {
     draw_underline_with_thickness(
-        term, pix, font, color, x, y, cols, font->underline.thickness);
+        term, pix, font, baseline, color, x, y, cols,
+        font->underline.thickness);
 }
 
 static void
 draw_strikeout(const struct terminal *term, pixman_image_t *pix,
-               const struct fcft_font *font,
+               const struct fcft_font *font, int baseline,
                const pixman_color_t *color, int x, int y, int cols)
 {
     pixman_image_fill_rectangles(
         PIXMAN_OP_SRC, pix, color,
         1, &(pixman_rectangle16_t){
-            x, y + font_baseline(term) - font->strikeout.position,
+            x, y + baseline - font->strikeout.position,
             cols * term->cell_width, font->strikeout.thickness});
 }
 
+/*
+ * A cell's attributes, from the snapshot's copy of the attribute
+ * table. Cells not (yet) in the copy get the default attributes.
+ */
+static inline const struct attributes *
+cell_attrs(const struct render_snapshot *snap, const struct cell *cell)
+{
+    static const struct attributes none = {0};
+
+    return likely(cell->attrs.idx < snap->attrs_count)
+        ? &snap->attrs[cell->attrs.idx]
+        : &none;
+}
+
 static void
 cursor_colors_for_cell(const struct terminal *term, const struct cell *cell,
               const pixman_color_t *fg, const pixman_color_t *bg,
               pixman_color_t *cursor_color, pixman_color_t *text_color)
 {
+    const struct render_snapshot *snap = &term->render.snapshot;
     bool is_selected = cell->attrs.selected;
 
-    if (term->cursor_color.cursor >> 31) {
-        *cursor_color = color_hex_to_pixman(term->cursor_color.cursor);
+    if (snap->cursor_color_cursor >> 31) {
+        *cursor_color = color_hex_to_pixman(snap->cursor_color_cursor);
         *text_color = color_hex_to_pixman(
-            term->cursor_color.text >> 31
-            ? term->cursor_color.text : term->colors.bg);
+            snap->cursor_color_text >> 31
+            ? snap->cursor_color_text : snap->colors.bg);
 
-        if (cell->attrs.reverse ^ is_selected) {
+        if (cell_attrs(snap, cell)->reverse ^ is_selected) {
             pixman_color_t swap = *cursor_color;
             *cursor_color = *text_color;
             *text_color = swap;
         }
 
-        if (term->is_searching && !is_selected) {
+        if (snap->is_searching && !is_selected) {
             color_dim_for_search(cursor_color);
             color_dim_for_search(text_color);
         }
@@ -402,12 +556,14 @@ draw_cursor(const struct terminal *term, const struct cell *cell,
     pixman_color_t text_color;
     cursor_colors_for_cell(term, cell, fg, bg, &cursor_color, &text_color);
 
-    switch (term->cursor_style) {
+    const struct render_snapshot *snap = &term->render.snapshot;
+
+    switch (snap->cursor_style) {
     case CURSOR_BLOCK:
-        if (unlikely(!term->kbd_focus))
+        if (unlikely(!snap->kbd_focus))
             draw_unfocused_block(term, pix, &cursor_color, x, y, cols);
 
-        else if (likely(term->cursor_blink.state == CURSOR_BLINK_ON)) {
+        else if (likely(snap->cursor_blink_on)) {
             *fg = text_color;
             pixman_image_fill_rectangles(
                 PIXMAN_OP_SRC, pix, &cursor_color, 1,
@@ -416,86 +572,252 @@ draw_cursor(const struct terminal *term, const struct cell *cell,
         break;
 
     case CURSOR_BEAM:
-        if (likely(term->cursor_blink.state == CURSOR_BLINK_ON ||
-                   !term->kbd_focus))
+        if (likely(snap->cursor_blink_on || !snap->kbd_focus))
         {
-            draw_beam_cursor(term, pix, font, &cursor_color, x, y);
+            draw_beam_cursor(term, pix, snap->fonts[0], &cursor_color, x, y);
         }
         break;
 
     case CURSOR_UNDERLINE:
-        if (likely(term->cursor_blink.state == CURSOR_BLINK_ON ||
-                   !term->kbd_focus))
+        if (likely(snap->cursor_blink_on || !snap->kbd_focus))
         {
-            draw_underline_cursor(term, pix, font, &cursor_color, x, y, cols);
+            draw_underline_cursor(
+                term, pix, font, snap->font_baseline, &cursor_color, x, y, cols);
         }
         break;
     }
 }
 
-static int
-render_cell(struct terminal *term, pixman_image_t *pix,
-            struct row *row, int col, int row_no, bool has_cursor)
+/*
+ * Glyphs queued by render_cell(), to be composited with a single
+ * pixman call, rather than one clip region, solid fill image and
+ * composite per cell.
+ *
+ * Only glyphs that fit inside their own cell(s) are queued. This
+ * means the queued glyphs never overlap each other, and we don't
+ * have to clip them.
+ *
+ * Cells rendered with a glyph run have had their background painted
+ * by render_row().
+ */
+struct glyph_run {
+    pixman_glyph_cache_t *cache;
+    pixman_color_t fg;
+    bool subpixel;          /* Component alpha glyphs */
+    int last_col;           /* Left-most queued column (rows are rendered right-to-left) */
+    pixman_box32_t extents;
+    size_t count;
+    pixman_glyph_t glyphs[256];
+};
+
+static pixman_glyph_cache_t *
+glyph_cache_get(void)
 {
-    struct cell *cell = &row->cells[col];
-    if (cell->attrs.clean)
-        return 0;
+    const unsigned generation = atomic_load_explicit(
+        &glyph_cache_generation, memory_order_relaxed);
 
-    cell->attrs.clean = 1;
+    if (unlikely(thread_glyph_cache != NULL &&
+                 thread_glyph_cache_generation != generation))
+    {
+        pixman_glyph_cache_destroy(thread_glyph_cache);
+        thread_glyph_cache = NULL;
+    }
 
-    int width = term->cell_width;
-    int height = term->cell_height;
-    int x = term->margins.left + col * width;
-    int y = term->margins.top + row_no * height;
+    if (unlikely(thread_glyph_cache == NULL)) {
+        thread_glyph_cache = pixman_glyph_cache_create();
+        thread_glyph_cache_generation = generation;
+    }
 
-    xassert(cell->attrs.selected == 0 || cell->attrs.selected == 1);
-    bool is_selected = cell->attrs.selected;
+    return thread_glyph_cache;
+}
+
+void
+render_glyph_caches_invalidate(void)
+{
+    /* Render threads are idle; they see this when woken up next */
+    atomic_fetch_add_explicit(&glyph_cache_generation, 1, memory_order_relaxed);
+}
+
+static void
+glyph_run_flush(struct glyph_run *run, pixman_image_t *pix)
+{
+    if (run->count == 0)
+        return;
+
+    pixman_image_t *clr_pix = pixman_image_create_solid_fill(&run->fg);
+
+    if (run->subpixel) {
+        /* Needs a component alpha mask */
+        pixman_composite_glyphs(
+            PIXMAN_OP_OVER, clr_pix, pix, PIXMAN_a8r8g8b8, 0, 0, 0, 0,
+            run->extents.x1, run->extents.y1,
+            run->extents.x2 - run->extents.x1,
+            run->extents.y2 - run->extents.y1,
+            run->cache, run->count, run->glyphs);
+    } else {
+        pixman_composite_glyphs_no_mask(
+            PIXMAN_OP_OVER, clr_pix, pix, 0, 0, 0, 0,
+            run->cache, run->count, run->glyphs);
+    }
+
+    pixman_image_unref(clr_pix);
+    run->count = 0;
+}
+
+static bool
+glyph_run_add(struct glyph_run *run, pixman_image_t *pix,
+              struct fcft_font *font, const struct fcft_glyph *glyph,
+              const pixman_color_t *fg, int col, int x, int y)
+{
+    if (unlikely(run->cache == NULL))
+        return false;
+
+    const void *cached = pixman_glyph_cache_lookup(
+        run->cache, font, (void *)glyph);
+
+    if (unlikely(cached == NULL)) {
+        cached = pixman_glyph_cache_insert(
+            run->cache, font, (void *)glyph, 0, 0, glyph->pix);
+
+        if (cached == NULL)
+            return false;
+    }
+
+    /* fcft's subpixel antialiased glyphs are x8r8g8b8 */
+    const bool subpixel = PIXMAN_FORMAT_A(pixman_image_get_format(glyph->pix)) == 0;
+
+    if (run->count > 0 &&
+        (run->count >= ALEN(run->glyphs) ||
+         run->subpixel != subpixel ||
+         !color_eq(&run->fg, fg)))
+    {
+        glyph_run_flush(run, pix);
+    }
+
+    const pixman_box32_t box = {x, y, x + glyph->width, y + glyph->height};
+
+    if (run->count == 0) {
+        run->fg = *fg;
+        run->subpixel = subpixel;
+        run->extents = box;
+    } else {
+        run->extents.x1 = min(run->extents.x1, box.x1);
+        run->extents.y1 = min(run->extents.y1, box.y1);
+        run->extents.x2 = max(run->extents.x2, box.x2);
+        run->extents.y2 = max(run->extents.y2, box.y2);
+    }
+
+    run->glyphs[run->count++] = (pixman_glyph_t){.x = x, .y = y, .glyph = cached};
+    run->last_col = col;
+    return true;
+}
+
+/*
+ * Resolves a cell's colors, taking reverse video and selection into
+ * account. The foreground color has not yet been adjusted for dim,
+ * bold and blink.
+ */
+static void
+cell_colors(const struct terminal *term, const struct cell *cell,
+            uint32_t *fg, uint32_t *bg, bool *apply_alpha)
+{
+    const struct render_snapshot *snap = &term->render.snapshot;
+    const struct attributes *attrs = cell_attrs(snap, cell);
+    const bool is_selected = cell->attrs.selected;
 
     uint32_t _fg = 0;
     uint32_t _bg = 0;
 
-    bool apply_alpha = false;
+    *apply_alpha = false;
 
-    if (is_selected && term->colors.use_custom_selection) {
-        _fg = term->colors.selection_fg;
-        _bg = term->colors.selection_bg;
+    if (is_selected && snap->colors.use_custom_selection) {
+        _fg = snap->colors.selection_fg;
+        _bg = snap->colors.selection_bg;
     } else {
         /* Use cell specific color, if set, otherwise the default colors (possible reversed) */
-        _fg = cell->attrs.have_fg ? cell->attrs.fg : term->reverse ? term->colors.bg : term->colors.fg;
-        _bg = cell->attrs.have_bg ? cell->attrs.bg : term->reverse ? term->colors.fg : term->colors.bg;
+        _fg = attrs->have_fg ? attrs->fg : snap->reverse ? snap->colors.bg : snap->colors.fg;
+        _bg = attrs->have_bg ? attrs->bg : snap->reverse ? snap->colors.fg : snap->colors.bg;
 
-        if (cell->attrs.reverse ^ is_selected) {
+        if (attrs->reverse ^ is_selected) {
             uint32_t swap = _fg;
             _fg = _bg;
             _bg = swap;
         } else
-            apply_alpha = !cell->attrs.have_bg;
+            *apply_alpha = !attrs->have_bg;
     }
 
     if (unlikely(is_selected && _fg == _bg)) {
         /* Invert bg when selected/highlighted text has same fg/bg */
         _bg = ~_bg;
-        apply_alpha = false;
+        *apply_alpha = false;
     }
 
-    if (cell->attrs.dim)
+    *fg = _fg;
+    *bg = _bg;
+}
+
+static pixman_color_t
+cell_bg_color(const struct terminal *term, const struct cell *cell)
+{
+    uint32_t _fg, _bg;
+    bool apply_alpha;
+    cell_colors(term, cell, &_fg, &_bg, &apply_alpha);
+
+    const struct render_snapshot *snap = &term->render.snapshot;
+    pixman_color_t bg = color_hex_to_pixman_with_alpha(
+        _bg, apply_alpha ? snap->colors.alpha : 0xffff);
+
+    if (snap->is_searching && !cell->attrs.selected)
+        color_dim_for_search(&bg);
+
+    return bg;
+}
+
+static int
+render_cell(struct terminal *term, pixman_image_t *pix, struct glyph_run *run,
+            struct row *row, int col, int row_no, bool has_cursor)
+{
+    const struct render_snapshot *snap = &term->render.snapshot;
+
+    struct cell *cell = &row->cells[col];
+    if (cell->attrs.clean)
+        return 0;
+
+    cell->attrs.clean = 1;
+
+    int width = term->cell_width;
+    int height = term->cell_height;
+    int x = term->margins.left + col * width;
+    int y = term->margins.top + row_no * height;
+
+    xassert(cell->attrs.selected == 0 || cell->attrs.selected == 1);
+    bool is_selected = cell->attrs.selected;
+
+    const struct attributes *attrs = cell_attrs(snap, cell);
+
+    uint32_t _fg;
+    uint32_t _bg;
+    bool apply_alpha;
+    cell_colors(term, cell, &_fg, &_bg, &apply_alpha);
+
+    if (attrs->dim)
         _fg = color_dim(_fg);
-    if (term->conf->bold_in_bright.enabled && cell->attrs.bold)
+    if (term->conf->bold_in_bright.enabled && attrs->bold)
         _fg = color_brighten(term, _fg);
 
-    if (cell->attrs.blink && term->blink.state == BLINK_OFF)
+    if (attrs->blink && !snap->blink_on)
         _fg = color_dim(_fg);
 
     pixman_color_t fg = color_hex_to_pixman(_fg);
     pixman_color_t bg = color_hex_to_pixman_with_alpha(
-        _bg, apply_alpha ? term->colors.alpha : 0xffff);
+        _bg, apply_alpha ? snap->colors.alpha : 0xffff);
 
-    if (term->is_searching && !is_selected) {
+    if (snap->is_searching && !is_selected) {
         color_dim_for_search(&fg);
         color_dim_for_search(&bg);
     }
 
-    struct fcft_font *font = attrs_to_font(term, &cell->attrs);
+    struct fcft_font *font = attrs_to_font(snap, attrs);
     const struct fcft_glyph *glyph = NULL;
     const struct composed *composed = NULL;
 
@@ -503,9 +825,9 @@ render_cell(struct terminal *term, pixman_image_t *pix,
 
     if (base != 0) {
         if (base >= CELL_COMB_CHARS_LO &&
-            base < (CELL_COMB_CHARS_LO + term->composed_count))
+            base < (CELL_COMB_CHARS_LO + snap->composed_count))
         {
-            composed = &term->composed[base - CELL_COMB_CHARS_LO];
+            composed = &snap->composed[base - CELL_COMB_CHARS_LO];
             base = composed->base;
         }
 
@@ -551,7 +873,7 @@ render_cell(struct terminal *term, pixman_image_t *pix,
                 xassert(glyph != NULL);
             }
         } else
-            glyph = fcft_glyph_rasterize(font, base, term->font_subpixel);
+            glyph = fcft_glyph_rasterize(font, base, snap->font_subpixel);
     }
 
     const int cols_left = term->cols - col;
@@ -599,59 +921,97 @@ render_cell(struct terminal *term, pixman_image_t *pix,
         row->cells[col + 1].attrs.clean = 0;
     }
 
-    pixman_region32_t clip;
-    pixman_region32_init_rect(
-        &clip, x, y,
-        cell_cols * term->cell_width, term->cell_height);
-    pixman_image_set_clip_region32(pix, &clip);
+    const bool draw_glyph =
+        !(cell->wc == 0 || cell->wc >= CELL_SPACER || cell->wc == L'\t' ||
+          (unlikely(attrs->conceal) && !is_selected));
 
-    /* Background */
-    pixman_image_fill_rectangles(
-        PIXMAN_OP_SRC, pix, &bg, 1,
-        &(pixman_rectangle16_t){x, y, cell_cols * width, height});
+    const int letter_x_ofs = term->font_x_ofs;
+    int glyph_x = 0;
+    int glyph_y = 0;
+    bool glyph_fits = true;
 
-    if (cell->attrs.blink && term->blink.fd < 0) {
-        /* TODO: use a custom lock for this? */
-        mtx_lock(&term->render.workers.lock);
-        term_arm_blink_timer(term);
-        mtx_unlock(&term->render.workers.lock);
+    if (glyph != NULL) {
+        glyph_x = x + letter_x_ofs + glyph->x;
+        glyph_y = y + snap->font_baseline - glyph->y;
+        glyph_fits =
+            glyph_x >= x && glyph_x + glyph->width <= x + cell_cols * width &&
+            glyph_y >= y && glyph_y + glyph->height <= y + height;
+    }
+
+    /* We're about to paint over a cell with a queued glyph */
+    if (run != NULL && run->count > 0 && run->last_col < col + cell_cols)
+        glyph_run_flush(run, pix);
+
+    /*
+     * Clip to the cell only when we may draw outside of it;
+     * overflowing glyphs (e.g. italic overhang), combining
+     * characters, line decorations and the cursor.
+     */
+    const bool clip =
+        has_cursor ||
+        (draw_glyph &&
+         (!glyph_fits || composed != NULL ||
+          attrs->underline || attrs->strikethrough ||
+          cell->attrs.url));
+
+    pixman_region32_t clip_region;
+    if (clip) {
+        pixman_region32_init_rect(
+            &clip_region, x, y,
+            cell_cols * term->cell_width, term->cell_height);
+        pixman_image_set_clip_region32(pix, &clip_region);
+    }
+
+    /*
+     * Background. Already painted by render_row(), unless we're
+     * overflowing into the next cell.
+     */
+    if (run == NULL || cell_cols > 1) {
+        pixman_image_fill_rectangles(
+            PIXMAN_OP_SRC, pix, &bg, 1,
+            &(pixman_rectangle16_t){x, y, cell_cols * width, height});
     }
 
-    if (has_cursor && term->cursor_style == CURSOR_BLOCK && term->kbd_focus)
+    if (attrs->blink && !snap->blink_armed) {
+        /* Armed by grid_render(), with the FDM lock held */
+        atomic_store_explicit(&workers.blinking, true, memory_order_relaxed);
+    }
+
+    if (has_cursor && snap->cursor_style == CURSOR_BLOCK && snap->kbd_focus)
         draw_cursor(term, cell, font, pix, &fg, &bg, x, y, cell_cols);
 
-    if (cell->wc == 0 || cell->wc >= CELL_SPACER || cell->wc == L'\t' ||
-        (unlikely(cell->attrs.conceal) && !is_selected))
-    {
+    if (!draw_glyph)
         goto draw_cursor;
-    }
 
-    pixman_image_t *clr_pix = pixman_image_create_solid_fill(&fg);
+    pixman_image_t *clr_pix = NULL;
 
     if (glyph != NULL) {
-        const int letter_x_ofs = term->font_x_ofs;
-
         if (unlikely(pixman_image_get_format(glyph->pix) == PIXMAN_a8r8g8b8)) {
             /* Glyph surface is a pre-rendered image (typically a color emoji...) */
-            if (!(cell->attrs.blink && term->blink.state == BLINK_OFF)) {
+            if (!(attrs->blink && !snap->blink_on)) {
                 pixman_image_composite32(
                     PIXMAN_OP_OVER, glyph->pix, NULL, pix, 0, 0, 0, 0,
-                    x + letter_x_ofs + glyph->x, y + font_baseline(term) - glyph->y,
-                    glyph->width, glyph->height);
+                    glyph_x, glyph_y, glyph->width, glyph->height);
             }
+        } else if (!clip && run != NULL &&
+                   glyph_run_add(run, pix, font, glyph, &fg, col, glyph_x, glyph_y))
+        {
+            /* Queued; composited by glyph_run_flush() */
         } else {
+            clr_pix = pixman_image_create_solid_fill(&fg);
             pixman_image_composite32(
                 PIXMAN_OP_OVER, clr_pix, glyph->pix, pix, 0, 0, 0, 0,
-                x + letter_x_ofs + glyph->x, y + font_baseline(term) - glyph->y,
-                glyph->width, glyph->height);
-
+                glyph_x, glyph_y, glyph->width, glyph->height);
         }
 
         /* Combining characters */
         if (composed != NULL) {
+            if (clr_pix == NULL)
+                clr_pix = pixman_image_create_solid_fill(&fg);
+
             for (size_t i = 0; i < composed->count; i++) {
                 const struct fcft_glyph *g = fcft_glyph_rasterize(
-                    font, composed->combining[i], term->font_subpixel);
+                    font, composed->combining[i], snap->font_subpixel);
 
                 if (g == NULL)
                     continue;
@@ -679,44 +1039,99 @@ render_cell(struct terminal *term, pixman_image_t *pix,
 
                 pixman_image_composite32(
                     PIXMAN_OP_OVER, clr_pix, g->pix, pix, 0, 0, 0, 0,
-                    x + letter_x_ofs + x_ofs + g->x, y + font_baseline(term) - g->y,
+                    x + letter_x_ofs + x_ofs + g->x, y + snap->font_baseline - g->y,
                     g->width, g->height);
             }
         }
     }
 
-    pixman_image_unref(clr_pix);
+    if (clr_pix != NULL)
+        pixman_image_unref(clr_pix);
 
     /* Underline */
-    if (cell->attrs.underline)
-        draw_underline(term, pix, font, &fg, x, y, cell_cols);
+    if (attrs->underline)
+        draw_underline(term, pix, font, snap->font_baseline, &fg, x, y, cell_cols);
 
-    if (cell->attrs.strikethrough)
-        draw_strikeout(term, pix, font, &fg, x, y, cell_cols);
+    if (attrs->strikethrough)
+        draw_strikeout(term, pix, font, snap->font_baseline, &fg, x, y, cell_cols);
 
     if (unlikely(cell->attrs.url)) {
         pixman_color_t url_color = color_hex_to_pixman(
             term->conf->colors.use_custom.url
             ? term->conf->colors.url
-            : term->colors.table[3]
+            : snap->colors.table[3]
             );
-        draw_underline(term, pix, font, &url_color, x, y, cell_cols);
+        draw_underline(
+            term, pix, font, snap->font_baseline, &url_color, x, y, cell_cols);
     }
 
 draw_cursor:
-    if (has_cursor && (term->cursor_style != CURSOR_BLOCK || !term->kbd_focus))
+    if (has_cursor && (snap->cursor_style != CURSOR_BLOCK || !snap->kbd_focus))
         draw_cursor(term, cell, font, pix, &fg, &bg, x, y, cell_cols);
 
-    pixman_image_set_clip_region32(pix, NULL);
+    if (clip) {
+        pixman_image_set_clip_region32(pix, NULL);
+        pixman_region32_fini(&clip_region);
+    }
     return cell_cols;
 }
 
 static void
-render_row(struct terminal *term, pixman_image_t *pix, struct row *row,
+render_row_background(struct terminal *term, pixman_image_t *pix,
+                      const struct row *row, int row_no)
+{
+    const int y = term->margins.top + row_no * term->cell_height;
+
+    pixman_color_t bg = {0};
+    int start = -1;
+
+    /* One rectangle per run of dirty cells with the same background */
+    for (int col = 0; col <= term->cols; col++) {
+        const struct cell *cell = col < term->cols ? &row->cells[col] : NULL;
+        const bool dirty = cell != NULL && !cell->attrs.clean;
+
+        pixman_color_t cell_bg = {0};
+        if (dirty)
+            cell_bg = cell_bg_color(term, cell);
+
+        if (start >= 0 && (!dirty || !color_eq(&cell_bg, &bg))) {
+            pixman_image_fill_rectangles(
+                PIXMAN_OP_SRC, pix, &bg, 1,
+                &(pixman_rectangle16_t){
+                    term->margins.left + start * term->cell_width, y,
+                    (col - start) * term->cell_width, term->cell_height});
+            start = -1;
+        }
+
+        if (dirty && start < 0) {
+            start = col;
+            bg = cell_bg;
+        }
+    }
+}
+
+static void
+render_row(struct terminal *term, pixman_image_t *pix,
+           pixman_glyph_cache_t *glyph_cache, struct row *row,
            int row_no, int cursor_col)
 {
+    render_row_background(term, pix, row, row_no);
+
+    struct glyph_run run;
+    run.cache = glyph_cache;
+    run.count = 0;
+
+    /* Cached glyphs may not be evicted while we're referencing them */
+    if (glyph_cache != NULL)
+        pixman_glyph_cache_freeze(glyph_cache);
+
     for (int col = term->cols - 1; col >= 0; col--)
-        render_cell(term, pix, row, col, row_no, cursor_col == col);
+        render_cell(term, pix, &run, row, col, row_no, cursor_col == col);
+
+    glyph_run_flush(&run, pix);
+
+    if (glyph_cache != NULL)
+        pixman_glyph_cache_thaw(glyph_cache);
 }
 
 static void
@@ -990,7 +1405,7 @@ grid_render_scroll_reverse(struct terminal *term, struct buffer *buf,
 }
 
 static void
-render_sixel_chunk(struct terminal *term, pixman_image_t *pix, const struct sixel *sixel,
+render_sixel_chunk(struct terminal *term, struct buffer *buf, const struct sixel *sixel,
                    int term_start_row, int img_start_row, int count)
 {
     /* Translate row/column to x/y pixel values */
@@ -1021,20 +1436,25 @@ render_sixel_chunk(struct terminal *term, pixman_image_t *pix, const struct sixe
         sixel->opaque ? PIXMAN_OP_SRC : PIXMAN_OP_OVER,
         sixel->pix,
         NULL,
-        pix,
+        buf->pix[0],
         0, img_start_row * term->cell_height,
         0, 0,
         x, y,
         width, height);
 
     wl_surface_damage_buffer(term->window->surface, x, y, width, height);
+
+    /* The image may extend beyond the row's dirty cells */
+    pixman_region32_union_rect(&buf->dirty, &buf->dirty, x, y, width, height);
 }
 
 static void
-render_sixel(struct terminal *term, pixman_image_t *pix,
+render_sixel(struct terminal *term, struct buffer *buf,
              const struct coord *cursor, const struct sixel *sixel)
 {
-    const int view_end = (term->grid->view + term->rows - 1) & (term->grid->num_rows - 1);
+    pixman_image_t *pix = buf->pix[0];
+
+    const int view_end = grid_row_absolute_in_view(term->grid, term->rows - 1);
     const bool last_row_needs_erase = sixel->height % term->cell_height != 0;
     const bool last_col_needs_erase = sixel->width % term->cell_width != 0;
 
@@ -1045,7 +1465,7 @@ render_sixel(struct terminal *term, pixman_image_t *pix,
 #define maybe_emit_sixel_chunk_then_reset()                             \
     if (chunk_row_count != 0) {                                         \
         render_sixel_chunk(                                             \
-            term, pix, sixel,                                           \
+            term, buf, sixel,                                           \
             chunk_term_start, chunk_img_start, chunk_row_count);        \
         chunk_term_start = chunk_img_start = -1;                        \
         chunk_row_count = 0;                                            \
@@ -1073,10 +1493,9 @@ render_sixel(struct terminal *term, pixman_image_t *pix,
          _abs_row_no < sixel->pos.row + sixel->rows;
          _abs_row_no++)
     {
-        const int abs_row_no = _abs_row_no & (term->grid->num_rows - 1);
+        const int abs_row_no = grid_row_wrap(term->grid, _abs_row_no);
         const int term_row_no =
-            (abs_row_no - term->grid->view + term->grid->num_rows) &
-            (term->grid->num_rows - 1);
+            grid_row_wrap(term->grid, abs_row_no - term->grid->view);
 
         /* Check if row is in the visible viewport */
         if (view_end >= term->grid->view) {
@@ -1096,7 +1515,7 @@ render_sixel(struct terminal *term, pixman_image_t *pix,
         }
 
         /* Is the row dirty? */
-        struct row *row = term->grid->rows[abs_row_no];
+        struct row *row = grid_row_at(term->grid, abs_row_no);
         xassert(row != NULL);  /* Should be visible */
 
         if (!row->dirty) {
@@ -1123,7 +1542,8 @@ render_sixel(struct terminal *term, pixman_image_t *pix,
         if (!sixel->opaque) {
             /* TODO: multithreading */
             int cursor_col = cursor->row == term_row_no ? cursor->col : -1;
-            render_row(term, pix, row, term_row_no, cursor_col);
+            render_row(term, pix, glyph_cache_get(),
+                       row, term_row_no, cursor_col);
         } else {
             for (int col = sixel->pos.col;
                  col < min(sixel->pos.col + sixel->cols, term->cols);
@@ -1138,7 +1558,7 @@ render_sixel(struct terminal *term, pixman_image_t *pix,
                     if ((last_row_needs_erase && last_row) ||
                         (last_col_needs_erase && last_col))
                     {
-                        render_cell(term, pix, row, col, term_row_no, cursor_col == col);
+                        render_cell(term, pix, NULL, row, col, term_row_no, cursor_col == col);
                     } else
                         cell->attrs.clean = 1;
                 }
@@ -1159,19 +1579,16 @@ render_sixel(struct terminal *term, pixman_image_t *pix,
 }
 
 static void
-render_sixel_images(struct terminal *term, pixman_image_t *pix,
+render_sixel_images(struct terminal *term, struct buffer *buf,
                     const struct coord *cursor)
 {
     if (likely(tll_length(term->grid->sixel_images)) == 0)
         return;
 
-    const int scrollback_end
-        = (term->grid->offset + term->rows) & (term->grid->num_rows - 1);
+    const int scrollback_end = grid_row_absolute(term->grid, term->rows);
 
     const int view_start
-        = (term->grid->view
-           - scrollback_end
-           + term->grid->num_rows) & (term->grid->num_rows - 1);
+        = grid_row_wrap(term->grid, term->grid->view - scrollback_end);
 
     const int view_end = view_start + term->rows - 1;
 
@@ -1181,9 +1598,7 @@ render_sixel_images(struct terminal *term, pixman_image_t *pix,
     tll_foreach(term->grid->sixel_images, it) {
         const struct sixel *six = &it->item;
         const int start
-            = (six->pos.row
-               - scrollback_end
-               + term->grid->num_rows) & (term->grid->num_rows - 1);
+            = grid_row_wrap(term->grid, six->pos.row - scrollback_end);
         const int end = start + six->rows - 1;
 
         //LOG_DBG("  sixel: %d-%d", start, end);
@@ -1196,7 +1611,7 @@ render_sixel_images(struct terminal *term, pixman_image_t *pix,
             break;
         }
 
-        render_sixel(term, pix, cursor, &it->item);
+        render_sixel(term, buf, cursor, &it->item);
     }
 }
 
@@ -1216,7 +1631,7 @@ render_ime_preedit_for_seat(struct terminal *term, struct seat *seat,
     cursor = term->grid->cursor.point;
     cursor.row += term->grid->offset;
     cursor.row -= term->grid->view;
-    cursor.row &= term->grid->num_rows - 1;
+    cursor.row = grid_row_wrap(term->grid, cursor.row);
 
     if (cursor.row < 0 || cursor.row >= term->rows)
         return;
@@ -1301,12 +1716,12 @@ render_ime_preedit_for_seat(struct terminal *term, struct seat *seat,
         if (cell->wc >= CELL_SPACER)
             continue;
 
-        int width = max(1, wcwidth(cell->wc));
+        int width = max(1, my_wcwidth(cell->wc));
         if (col_idx + i + width > term->cols)
             break;
 
         row->cells[col_idx + i] = *cell;
-        render_cell(term, buf->pix[0], row, col_idx + i, row_idx, false);
+        render_cell(term, buf->pix[0], NULL, row, col_idx + i, row_idx, false);
     }
 
     int start = seat->ime.preedit.cursor.start - ime_ofs;
@@ -1328,8 +1743,9 @@ render_ime_preedit_for_seat(struct terminal *term, struct seat *seat,
         if (end == start) {
             /* Bar */
             if (start >= 0) {
-                struct fcft_font *font = attrs_to_font(term, &start_cell->attrs);
-                draw_beam_cursor(term, buf->pix[0], font, &cursor_color, x, y);
+                draw_beam_cursor(
+                    term, buf->pix[0], term->render.snapshot.fonts[0],
+                    &cursor_color, x, y);
             }
             term_ime_set_cursor_rect(term, x, y, 1, term->cell_height);
         }
@@ -1371,73 +1787,266 @@ render_ime_preedit(struct terminal *term, struct buffer *buf)
 #endif
 }
 
-int
-render_worker_thread(void *_ctx)
+static inline uint64_t
+deque_range(uint32_t begin, uint32_t end)
 {
-    struct render_worker_context *ctx = _ctx;
-    struct terminal *term = ctx->term;
-    const int my_id = ctx->my_id;
-    free(ctx);
+    return (uint64_t)begin << 32 | end;
+}
+
+/* Takes a row index from the front (owner) or back (thief) of the deque */
+static bool
+deque_take(struct render_worker_deque *deque, bool steal, int *idx)
+{
+    uint64_t range = atomic_load_explicit(&deque->range, memory_order_relaxed);
+
+    while (true) {
+        uint32_t begin = range >> 32;
+        uint32_t end = range & 0xffffffff;
+
+        if (begin >= end)
+            return false;
+
+        uint64_t new_range = steal
+            ? deque_range(begin, end - 1)
+            : deque_range(begin + 1, end);
+
+        /* The rows themselves were published by sem_post(start) */
+        if (atomic_compare_exchange_weak_explicit(
+                &deque->range, &range, new_range,
+                memory_order_relaxed, memory_order_relaxed))
+        {
+            *idx = steal ? end - 1 : begin;
+            return true;
+        }
+    }
+}
+
+/*
+ * Renders this thread's share of the frame's dirty rows, then steals
+ * from the other threads until all deques are empty. Deques are
+ * never refilled during a frame, so once all have been seen empty,
+ * we're done.
+ */
+static void
+render_rows(struct terminal *term, struct buffer *buf, int my_id,
+            struct coord cursor)
+{
+    const size_t thread_count = workers.thread_count;
+    struct render_worker_deque *deques = workers.deques;
+    const struct dirty_row *rows = workers.rows;
+
+    struct timespec start, end, busy;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pixman_image_t *pix = buf->pix[my_id];
+    pixman_glyph_cache_t *glyph_cache = glyph_cache_get();
+
+    for (size_t i = 0; i < thread_count; i++) {
+        struct render_worker_deque *deque = &deques[(my_id + i) % thread_count];
+        const bool steal = i > 0;
+
+        int idx;
+        while (deque_take(deque, steal, &idx)) {
+            int row_no = rows[idx].row_no;
+            struct row *row = &term->render.snapshot.rows[row_no];
+            int cursor_col = cursor.row == row_no ? cursor.col : -1;
+
+            render_row(term, pix, glyph_cache, row, row_no, cursor_col);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    timespec_sub(&end, &start, &busy);
+    atomic_fetch_add_explicit(
+        &workers.busy_ns, timespec_to_nsecs(&busy), memory_order_relaxed);
+}
+
+static int
+render_worker_thread(void *_id)
+{
+    const int thread_no = (intptr_t)_id;
 
     sigset_t mask;
     sigfillset(&mask);
     pthread_sigmask(SIG_SETMASK, &mask, NULL);
 
     char proc_title[16];
-    snprintf(proc_title, sizeof(proc_title), "foot:render:%d", my_id);
+    snprintf(proc_title, sizeof(proc_title), "foot:render:%d", thread_no);
 
     if (pthread_setname_np(pthread_self(), proc_title) < 0)
-        LOG_ERRNO("render worker %d: failed to set process title", my_id);
-
-    sem_t *start = &term->render.workers.start;
-    sem_t *done = &term->render.workers.done;
-    mtx_t *lock = &term->render.workers.lock;
+        LOG_ERRNO("render worker %d: failed to set process title", thread_no);
 
     while (true) {
-        sem_wait(start);
+        sem_wait(&workers.start);
+
+        if (atomic_load(&workers.quit))
+            break;
+
+        /*
+         * Whichever threads are woken up, they each get a pixman
+         * instance and deque of their own. A thread may be woken
+         * more than once per frame.
+         */
+        const int my_id = atomic_fetch_add_explicit(
+            &workers.next_id, 1, memory_order_relaxed);
+        xassert(my_id > 0 && (size_t)my_id < workers.thread_count);
+
+        /* No terminal means we're being calibrated */
+        if (workers.term != NULL)
+            render_rows(workers.term, workers.buf, my_id, workers.cursor);
+        sem_post(&workers.done);
+    }
+
+    if (thread_glyph_cache != NULL)
+        pixman_glyph_cache_destroy(thread_glyph_cache);
+    return 0;
+}
 
-        struct buffer *buf = term->render.workers.buf;
-        bool frame_done = false;
+static void
+render_workers_update_wake_cost(double wake_ns)
+{
+    /* Don't let a lucky frame convince us that waking threads is free */
+    wake_ns = max(wake_ns, 1000.);
+    workers.cost.wake_ns += (wake_ns - workers.cost.wake_ns) / 8.;
+}
 
-        /* Translate offset-relative cursor row to view-relative */
-        struct coord cursor = {-1, -1};
-        if (!term->hide_cursor) {
-            cursor = term->grid->cursor.point;
-            cursor.row += term->grid->offset;
-            cursor.row -= term->grid->view;
-            cursor.row &= term->grid->num_rows - 1;
+/*
+ * Measures the overhead of waking all threads, by running empty
+ * frames. The first round includes thread startup, and is ignored.
+ */
+static void
+render_workers_calibrate(void)
+{
+    if (workers.count == 0)
+        return;
+
+    workers.term = NULL;
+    workers.buf = NULL;
+    workers.thread_count = 1 + workers.count;
+
+    for (int round = 0; round < 2; round++) {
+        struct timespec start, end, elapsed;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        atomic_store_explicit(&workers.next_id, 1, memory_order_relaxed);
+        for (size_t i = 0; i < workers.count; i++)
+            sem_post(&workers.start);
+        for (size_t i = 0; i < workers.count; i++)
+            sem_wait(&workers.done);
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        timespec_sub(&end, &start, &elapsed);
+
+        if (round > 0) {
+            workers.cost.wake_ns = max(
+                (double)timespec_to_nsecs(&elapsed) / workers.count, 1000.);
         }
+    }
+}
 
-        while (!frame_done) {
-            mtx_lock(lock);
-            xassert(tll_length(term->render.workers.queue) > 0);
+/*
+ * Returns the number of threads, in addition to the main thread, to
+ * render a frame with.
+ *
+ * A frame rendered by n threads takes roughly cost/n + (n-1)*wake,
+ * where 'cost' is the time a single thread would need, and 'wake' is
+ * the overhead of waking one thread, and waiting for it. This is
+ * minimized at n = sqrt(cost/wake). Small frames (e.g. typing) thus
+ * don't wake any threads at all, while full redraws use all of them.
+ */
+static size_t
+render_workers_for_frame(const struct terminal *term, int dirty_rows,
+                         size_t dirty_cells)
+{
+    const double cost = (double)dirty_cells *
+        term->cell_width * term->cell_height * workers.cost.ns_per_px;
 
-            int row_no = tll_pop_front(term->render.workers.queue);
-            mtx_unlock(lock);
+    size_t thread_count = sqrt(cost / workers.cost.wake_ns);
 
-            switch (row_no) {
-            default: {
-                xassert(buf != NULL);
+    /* Rows are the unit of work */
+    thread_count = min(thread_count, (size_t)dirty_rows);
 
-                struct row *row = grid_row_in_view(term->grid, row_no);
-                int cursor_col = cursor.row == row_no ? cursor.col : -1;
+    size_t worker_count = thread_count > 0 ? thread_count - 1 : 0;
+    return min(worker_count, term->render.workers.count);
+}
 
-                render_row(term, buf->pix[my_id], row, row_no, cursor_col);
-                break;
-            }
+/* Refines the cost model with a rendered frame's actual timings */
+static void
+render_workers_update_cost(const struct terminal *term, size_t dirty_cells,
+                           size_t thread_count, const struct timespec *elapsed)
+{
+    /* Per-row overhead dominates tiny frames, which are rendered inline anyway */
+    if (dirty_cells < (size_t)term->cols)
+        return;
 
-            case -1:
-                frame_done = true;
-                sem_post(done);
-                break;
+    const double px = (double)dirty_cells * term->cell_width * term->cell_height;
 
-            case -2:
-                return 0;
-            }
+    const double busy_ns = atomic_load_explicit(&workers.busy_ns, memory_order_relaxed);
+    const double elapsed_ns = timespec_to_nsecs(elapsed);
+
+    workers.cost.ns_per_px += (busy_ns / px - workers.cost.ns_per_px) / 8.;
+
+    if (thread_count > 1) {
+        /* Whatever isn't perfectly parallelized rendering is overhead */
+        const double overhead_ns = elapsed_ns - busy_ns / thread_count;
+        render_workers_update_wake_cost(overhead_ns / (thread_count - 1));
+    }
+}
+
+/*
+ * Grows the thread pool to (at least) 'count' threads. Returns the
+ * number of threads available, which may be less than requested.
+ */
+static size_t
+render_workers_reserve(size_t count)
+{
+    if (count <= workers.count)
+        return count;
+
+    if (!workers.initialized) {
+        if (sem_init(&workers.start, 0, 0) < 0 ||
+            sem_init(&workers.done, 0, 0) < 0)
+        {
+            LOG_ERRNO("failed to instantiate render worker semaphores");
+            return 0;
         }
-    };
+        workers.initialized = true;
+    }
+
+    /* Threads are idle; it's safe to replace the deques */
+    const size_t deques_size = (1 + count) * sizeof(workers.deques[0]);
+    struct render_worker_deque *deques = aligned_alloc(
+        alignof(struct render_worker_deque), deques_size);
+    if (deques == NULL) {
+        LOG_ERRNO("failed to allocate render worker deques");
+        return workers.count;
+    }
+    memset(deques, 0, deques_size);
+    free(workers.deques);
+    workers.deques = deques;
+
+    workers.threads = xrealloc(
+        workers.threads, count * sizeof(workers.threads[0]));
+
+    while (workers.count < count) {
+        int ret = thrd_create(
+            &workers.threads[workers.count], &render_worker_thread,
+            (void *)(intptr_t)(1 + workers.count));
+
+        if (ret != thrd_success) {
+            LOG_ERR("failed to create render worker thread: %s (%d)",
+                    thrd_err_as_string(ret), ret);
+            break;
+        }
+
+        workers.count++;
+    }
 
-    return -1;
+    render_workers_calibrate();
+
+    LOG_DBG("render thread pool: %zu threads, %.0fns wake-up overhead",
+            workers.count, workers.cost.wake_ns);
+    return min(count, workers.count);
 }
 
 struct csd_data {
@@ -1922,17 +2531,17 @@ render_scrollback_position(struct terminal *term)
     xassert(win->scrollback_indicator.sub != NULL);
 
     /* Find absolute row number of the scrollback start */
-    int scrollback_start = term->grid->offset + term->rows;
+    int scrollback_start = grid_row_absolute(term->grid, term->rows);
     int empty_rows = 0;
-    while (term->grid->rows[scrollback_start & (term->grid->num_rows - 1)] == NULL) {
-        scrollback_start++;
+    while (grid_ring_get(term->grid, scrollback_start) == NULL) {
+        scrollback_start = grid_row_wrap(term->grid, scrollback_start + 1);
         empty_rows++;
     }
 
     /* Rebase viewport against scrollback start (so that 0 is at
      * the beginning of the scrollback) */
-    int rebased_view = term->grid->view - scrollback_start + term->grid->num_rows;
-    rebased_view &= term->grid->num_rows - 1;
+    int rebased_view =
+        grid_row_wrap(term->grid, term->grid->view - scrollback_start);
 
     /* How much of the scrollback is actually used? */
     int populated_rows = term->grid->num_rows - empty_rows;
@@ -2025,12 +2634,12 @@ render_scrollback_position(struct terminal *term)
 }
 
 static void
-render_render_timer(struct terminal *term, struct timeval render_time)
+render_render_timer(struct terminal *term, struct timespec render_time)
 {
     struct wl_window *win = term->window;
 
     wchar_t text[256];
-    double usecs = render_time.tv_sec * 1000000 + render_time.tv_usec;
+    double usecs = render_time.tv_sec * 1000000 + render_time.tv_nsec / 1000.;
     swprintf(text, sizeof(text) / sizeof(text[0]), L"%.2f µs", usecs);
 
     const int scale = term->scale;
@@ -2074,6 +2683,92 @@ force_full_repaint(struct terminal *term, struct buffer *buf)
     term_damage_view(term);
 }
 
+static bool
+is_reverse_scroll(const struct damage *dmg)
+{
+    return dmg->type == DAMAGE_SCROLL_REVERSE ||
+           dmg->type == DAMAGE_SCROLL_REVERSE_IN_VIEW;
+}
+
+/*
+ * Moves a region the same way grid_render_scroll() or
+ * grid_render_scroll_reverse() moves the buffer's pixels.
+ *
+ * The rows uncovered by the scroll keep whatever was there before;
+ * they are part of the region both before and after, since they
+ * hold what was scrolled past.
+ */
+static void
+region_scroll(const struct terminal *term, pixman_region32_t *region,
+              const struct damage *dmg)
+{
+    const int lines = dmg->region.end - dmg->region.start - dmg->lines;
+    if (lines <= 0)
+        return;
+
+    const int top = term->margins.top + dmg->region.start * term->cell_height;
+    const int height = (dmg->region.end - dmg->region.start) * term->cell_height;
+    const int dy = dmg->lines * term->cell_height;
+    const bool reverse = is_reverse_scroll(dmg);
+
+    pixman_region32_t moved;
+    pixman_region32_init_rect(&moved, 0, top, term->width, height);
+    pixman_region32_intersect(&moved, &moved, region);
+
+    pixman_region32_t uncovered;
+    pixman_region32_init_rect(
+        &uncovered, 0, reverse ? top : top + height - dy, term->width, dy);
+    pixman_region32_intersect(&uncovered, &uncovered, &moved);
+
+    pixman_region32_subtract(region, region, &moved);
+    pixman_region32_translate(&moved, 0, reverse ? dy : -dy);
+    pixman_region32_intersect_rect(&moved, &moved, 0, top, term->width, height);
+
+    pixman_region32_union(region, region, &moved);
+    pixman_region32_union(region, region, &uncovered);
+
+    pixman_region32_fini(&moved);
+    pixman_region32_fini(&uncovered);
+}
+
+/* Returns a new, empty, history entry, for the frame being rendered */
+static struct frame_damage *
+damage_history_push(struct terminal *term, size_t scroll_count)
+{
+    struct frame_damage *frames = term->render.damage_history.frames;
+    const size_t size = ALEN(term->render.damage_history.frames);
+    size_t *head = &term->render.damage_history.head;
+    size_t *count = &term->render.damage_history.count;
+
+    struct frame_damage *frame;
+
+    if (*count < size) {
+        frame = &frames[(*head + *count) % size];
+        pixman_region32_init(&frame->dirty);
+        (*count)++;
+    } else {
+        /* Recycle the oldest frame */
+        frame = &frames[*head];
+        *head = (*head + 1) % size;
+        pixman_region32_clear(&frame->dirty);
+        free(frame->scroll);
+    }
+
+    frame->scroll = xmalloc(scroll_count * sizeof(frame->scroll[0]));
+    frame->scroll_count = 0;
+    return frame;
+}
+
+/*
+ * Brings 'new', which is new->age frames old, up to date with 'old',
+ * the buffer we rendered the last frame to.
+ *
+ * The damage history is replayed, oldest frame first: each frame's
+ * scroll damage is re-applied to 'new', and moves the pixels known
+ * to be stale along with it. Then the frame's own dirty region is
+ * added to the stale pixels. Finally, all stale pixels are copied
+ * from 'old'.
+ */
 static void
 reapply_old_damage(struct terminal *term, struct buffer *new, struct buffer *old)
 {
@@ -2085,98 +2780,107 @@ reapply_old_damage(struct terminal *term, struct buffer *new, struct buffer *old
         have_warned = true;
     }
 
-    if (new->age > 1) {
+    const size_t history_size = ALEN(term->render.damage_history.frames);
+    const size_t history_count = term->render.damage_history.count;
+
+    if (new->age > history_count) {
         memcpy(new->mmapped, old->mmapped, new->size);
         return;
     }
 
     /*
-     * TODO: remove this frame’s damage from the region we copy from
-     * the old frame.
+     * Cells that are dirty in this frame will be repainted in full
+     * anyway; no need to copy them.
      *
-     * - this frame’s dirty region is only valid *after* we’ve applied
-     *   its scroll damage.
-     * - last frame’s dirty region is only valid *before* we’ve
-     *   applied this frame’s scroll damage.
-     *
-     * Can we transform one of the regions? It’s not trivial, since
-     * scroll damage isn’t just about counting lines; there may be
-     * multiple damage records, each with different scrolling regions.
+     * This frame's dirty region is only valid *after* this frame's
+     * scroll damage has been applied. Thus, we can only use it when
+     * there isn't any.
      */
-    pixman_region32_t dirty;
-    pixman_region32_init(&dirty);
+    pixman_region32_t repainted;
+    pixman_region32_init(&repainted);
 
     bool full_repaint_needed = true;
 
     for (int r = 0; r < term->rows; r++) {
         const struct row *row = grid_row_in_view(term->grid, r);
 
-        bool row_all_dirty = true;
-        for (int c = 0; c < term->cols; c++) {
-            if (row->cells[c].attrs.clean) {
-                row_all_dirty = false;
+        if (!row->dirty && !full_repaint_needed)
+            continue;
+
+        /* Dirty cells, in dirty rows, are repainted in full */
+        int run_start = -1;
+        for (int c = 0; c <= term->cols; c++) {
+            const bool clean = c == term->cols || row->cells[c].attrs.clean;
+
+            if (clean && c < term->cols)
                 full_repaint_needed = false;
-                break;
+
+            if (!clean) {
+                if (run_start < 0 && row->dirty)
+                    run_start = c;
+                continue;
             }
-        }
 
-        if (row_all_dirty) {
-            pixman_region32_union_rect(
-                &dirty, &dirty,
-                term->margins.left,
-                term->margins.top + r * term->cell_height,
-                term->width - term->margins.left - term->margins.right,
-                term->cell_height);
+            if (run_start >= 0) {
+                pixman_region32_union_rect(
+                    &repainted, &repainted,
+                    term->margins.left + run_start * term->cell_width,
+                    term->margins.top + r * term->cell_height,
+                    (c - run_start) * term->cell_width,
+                    term->cell_height);
+                run_start = -1;
+            }
         }
     }
 
     if (full_repaint_needed) {
+        pixman_region32_fini(&repainted);
         force_full_repaint(term, new);
         return;
     }
 
-    for (size_t i = 0; i < old->scroll_damage_count; i++) {
-        const struct damage *dmg = &old->scroll_damage[i];
+    pixman_region32_t stale;
+    pixman_region32_init(&stale);
 
-        switch (dmg->type) {
-        case DAMAGE_SCROLL:
-            if (term->grid->view == term->grid->offset)
-                grid_render_scroll(term, new, dmg);
-            break;
+    for (size_t i = history_count - new->age; i < history_count; i++) {
+        struct frame_damage *frame = &term->render.damage_history.frames[
+            (term->render.damage_history.head + i) % history_size];
 
-        case DAMAGE_SCROLL_REVERSE:
-            if (term->grid->view == term->grid->offset)
-                grid_render_scroll_reverse(term, new, dmg);
-            break;
+        for (size_t j = 0; j < frame->scroll_count; j++) {
+            const struct damage *dmg = &frame->scroll[j];
 
-        case DAMAGE_SCROLL_IN_VIEW:
-            grid_render_scroll(term, new, dmg);
-            break;
+            if (is_reverse_scroll(dmg))
+                grid_render_scroll_reverse(term, new, dmg);
+            else
+                grid_render_scroll(term, new, dmg);
 
-        case DAMAGE_SCROLL_REVERSE_IN_VIEW:
-            grid_render_scroll_reverse(term, new, dmg);
-            break;
+            region_scroll(term, &stale, dmg);
         }
+
+        pixman_region32_union(&stale, &stale, &frame->dirty);
     }
 
-    if (tll_length(term->grid->scroll_damage) == 0) {
-        pixman_region32_subtract(&dirty, &old->dirty, &dirty);
-        pixman_image_set_clip_region32(new->pix[0], &dirty);
-    } else
-        pixman_image_set_clip_region32(new->pix[0], &old->dirty);
+    if (tll_length(term->grid->scroll_damage) == 0)
+        pixman_region32_subtract(&stale, &stale, &repainted);
 
+    pixman_image_set_clip_region32(new->pix[0], &stale);
     pixman_image_composite32(
         PIXMAN_OP_SRC, old->pix[0], NULL, new->pix[0],
         0, 0, 0, 0, 0, 0, term->width, term->height);
-
     pixman_image_set_clip_region32(new->pix[0], NULL);
-    pixman_region32_fini(&dirty);
+
+    pixman_region32_fini(&stale);
+    pixman_region32_fini(&repainted);
 }
 
 static void
 dirty_old_cursor(struct terminal *term)
 {
-    if (term->render.last_cursor.row != NULL && !term->render.last_cursor.hidden) {
+    /* Compressed rows are fully dirtied when decompressed */
+    if (term->render.last_cursor.row != NULL &&
+        term->render.last_cursor.row->cells != NULL &&
+        !term->render.last_cursor.hidden)
+    {
         struct row *row = term->render.last_cursor.row;
         struct cell *cell = &row->cells[term->render.last_cursor.col];
         cell->attrs.clean = 0;
@@ -2203,15 +2907,276 @@ dirty_cursor(struct terminal *term)
     row->dirty = true;
 }
 
+/*
+ * Collects the view's dirty rows into workers.rows, along with the
+ * range of dirty columns in each. Returns the number of dirty rows,
+ * and the total number of dirty cells in them.
+ */
+static int
+collect_dirty_rows(struct terminal *term, size_t *dirty_cells)
+{
+    if (workers.rows_size < term->rows) {
+        workers.rows = xrealloc(
+            workers.rows, term->rows * sizeof(workers.rows[0]));
+        workers.rows_size = term->rows;
+    }
+
+    /* Overflowing glyphs paint the next cell too, see render_cell() */
+    const bool overflow =
+        term->conf->tweak.allow_overflowing_double_width_glyphs;
+
+    int count = 0;
+    *dirty_cells = 0;
+
+    for (int r = 0; r < term->rows; r++) {
+        const struct row *row = grid_row_in_view(term->grid, r);
+
+        if (!row->dirty)
+            continue;
+
+        int first_col = -1;
+        int last_col = -1;
+
+        for (int c = 0; c < term->cols; c++) {
+            if (row->cells[c].attrs.clean)
+                continue;
+
+            if (first_col < 0)
+                first_col = c;
+            last_col = c;
+            (*dirty_cells)++;
+        }
+
+        if (last_col >= 0) {
+            /* Double-width characters are rendered by their first cell */
+            while (last_col < term->cols - 1 &&
+                   row->cells[last_col + 1].wc >= CELL_SPACER)
+            {
+                last_col++;
+            }
+
+            if (overflow && last_col < term->cols - 1)
+                last_col++;
+        }
+
+        workers.rows[count++] = (struct dirty_row){
+            .row_no = r,
+            .first_col = first_col,
+            .last_col = last_col,
+        };
+    }
+
+    return count;
+}
+
+static void
+damage_cells(struct terminal *term, struct buffer *buf,
+             int row_no, int row_count, int first_col, int last_col)
+{
+    const int x = term->margins.left + first_col * term->cell_width;
+    const int y = term->margins.top + row_no * term->cell_height;
+    const int width = (last_col - first_col + 1) * term->cell_width;
+    const int height = row_count * term->cell_height;
+
+    wl_surface_damage_buffer(term->window->surface, x, y, width, height);
+    pixman_region32_union_rect(&buf->dirty, &buf->dirty, x, y, width, height);
+}
+
+/*
+ * Damages the dirty cells of the rows collected by
+ * collect_dirty_rows(), and clears the rows' dirty bit. Consecutive
+ * rows with the same dirty columns are damaged as a single
+ * rectangle.
+ *
+ * Rows without any dirty cells are dropped from workers.rows;
+ * returns the number of rows left to render.
+ */
+static int
+damage_dirty_rows(struct terminal *term, struct buffer *buf, int dirty_count)
+{
+    int count = 0;
+    int rect_row = -1;
+    int rect_rows = 0;
+    int rect_first_col = -1;
+    int rect_last_col = -1;
+
+    for (int i = 0; i < dirty_count; i++) {
+        const struct dirty_row *dirty = &workers.rows[i];
+        struct row *row = grid_row_in_view(term->grid, dirty->row_no);
+
+        row->dirty = false;
+
+        if (dirty->first_col < 0)
+            continue;
+
+        if (rect_rows > 0 &&
+            rect_row + rect_rows == dirty->row_no &&
+            rect_first_col == dirty->first_col &&
+            rect_last_col == dirty->last_col)
+        {
+            rect_rows++;
+        } else {
+            if (rect_rows > 0) {
+                damage_cells(term, buf, rect_row, rect_rows,
+                             rect_first_col, rect_last_col);
+            }
+
+            rect_row = dirty->row_no;
+            rect_rows = 1;
+            rect_first_col = dirty->first_col;
+            rect_last_col = dirty->last_col;
+        }
+
+        workers.rows[count++] = *dirty;
+    }
+
+    if (rect_rows > 0)
+        damage_cells(term, buf, rect_row, rect_rows, rect_first_col, rect_last_col);
+
+    return count;
+}
+
+/* Copies the state cells are rendered with, see struct render_snapshot */
+static void
+snapshot_state(struct terminal *term)
+{
+    struct render_snapshot *snap = &term->render.snapshot;
+
+    snap->colors = term->colors;
+    snap->cursor_color_text = term->cursor_color.text;
+    snap->cursor_color_cursor = term->cursor_color.cursor;
+    snap->cursor_style = term->cursor_style;
+    snap->cursor_blink_on = term->cursor_blink.state == CURSOR_BLINK_ON;
+    snap->reverse = term->reverse;
+    snap->blink_on = term->blink.state == BLINK_ON;
+    snap->blink_armed = term->blink.timer != NULL;
+    snap->kbd_focus = term->kbd_focus;
+    snap->is_searching = term->is_searching;
+
+    /*
+     * Fonts are reloaded on e.g. font size changes. Hold a reference,
+     * so that the ones we're rendering with aren't freed under us.
+     */
+    for (size_t i = 0; i < ALEN(snap->fonts); i++) {
+        if (snap->fonts[i] != term->fonts[i]) {
+            fcft_destroy(snap->fonts[i]);
+            snap->fonts[i] = fcft_clone(term->fonts[i]);
+        }
+    }
+    snap->font_baseline = font_baseline(term);
+    snap->font_subpixel = term->font_subpixel;
+
+    /* New chains are rare; don't copy them all every frame */
+    if (snap->composed_generation != term->composed_generation) {
+        if (snap->composed_size < term->composed_count) {
+            snap->composed = xrealloc(
+                snap->composed, term->composed_size * sizeof(snap->composed[0]));
+            snap->composed_size = term->composed_size;
+        }
+
+        if (term->composed_count > 0) {
+            memcpy(snap->composed, term->composed,
+                   term->composed_count * sizeof(snap->composed[0]));
+        }
+
+        snap->composed_count = term->composed_count;
+        snap->composed_generation = term->composed_generation;
+    }
+
+    /* Likewise for attributes; new ones are only added on SGR changes */
+    if (snap->attrs_generation != term->attrs_generation) {
+        if (snap->attrs_size < term->attrs_count) {
+            snap->attrs = xrealloc(
+                snap->attrs, term->attrs_size * sizeof(snap->attrs[0]));
+            snap->attrs_size = term->attrs_size;
+        }
+
+        if (term->attrs_count > 0) {
+            memcpy(snap->attrs, term->attrs,
+                   term->attrs_count * sizeof(snap->attrs[0]));
+        }
+
+        snap->attrs_count = term->attrs_count;
+        snap->attrs_generation = term->attrs_generation;
+    }
+}
+
+/*
+ * Copies the rows left in workers.rows to the snapshot, and marks
+ * their cells clean in the grid. From here on, the grid may be
+ * modified while the copies are being rendered.
+ */
+static void
+snapshot_rows(struct terminal *term, int dirty_count)
+{
+    struct render_snapshot *snap = &term->render.snapshot;
+    const int cols = term->cols;
+
+    if (snap->num_rows != term->rows || snap->num_cols != cols) {
+        free(snap->cells);
+        snap->cells = xmalloc(term->rows * cols * sizeof(snap->cells[0]));
+        snap->rows = xrealloc(snap->rows, term->rows * sizeof(snap->rows[0]));
+
+        for (int r = 0; r < term->rows; r++)
+            snap->rows[r] = (struct row){.cells = &snap->cells[r * cols]};
+
+        snap->num_rows = term->rows;
+        snap->num_cols = cols;
+    }
+
+    for (int i = 0; i < dirty_count; i++) {
+        struct dirty_row *dirty = &workers.rows[i];
+        struct row *live = grid_row_in_view(term->grid, dirty->row_no);
+        struct row *copy = &snap->rows[dirty->row_no];
+
+        memcpy(copy->cells, live->cells, cols * sizeof(copy->cells[0]));
+        copy->linebreak = live->linebreak;
+
+        for (int c = 0; c < cols; c++)
+            live->cells[c].attrs.clean = 1;
+
+        dirty->live = live;
+    }
+}
+
+/*
+ * Overflowing glyphs leave the cells they overflow into marked for
+ * re-rendering, see render_cell(). Carries those marks over to the
+ * grid, unless the row has been scrolled (or replaced) since the
+ * snapshot was taken.
+ */
+static void
+snapshot_rows_rendered(struct terminal *term, int dirty_count)
+{
+    if (!term->conf->tweak.allow_overflowing_double_width_glyphs)
+        return;
+
+    const struct render_snapshot *snap = &term->render.snapshot;
+
+    for (int i = 0; i < dirty_count; i++) {
+        const struct dirty_row *dirty = &workers.rows[i];
+        struct row *live = grid_row_in_view(term->grid, dirty->row_no);
+
+        if (live != dirty->live)
+            continue;
+
+        const struct row *copy = &snap->rows[dirty->row_no];
+        for (int c = 0; c < term->cols; c++) {
+            if (!copy->cells[c].attrs.clean)
+                live->cells[c].attrs.clean = 0;
+        }
+    }
+}
+
 static void
 grid_render(struct terminal *term)
 {
     if (term->is_shutting_down)
         return;
 
-    struct timeval start_time, start_double_buffering = {0}, stop_double_buffering = {0};
-    if (term->conf->tweak.render_timer_osd || term->conf->tweak.render_timer_log)
-        gettimeofday(&start_time, NULL);
+    /* Phase boundaries, see term->render.timings */
+    struct timespec start_time, reapply_done, scroll_done, sixel_done, rows_done;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
 
     xassert(term->width > 0);
     xassert(term->height > 0);
@@ -2242,15 +3207,10 @@ grid_render(struct terminal *term)
         xassert(term->render.last_buf->width == buf->width);
         xassert(term->render.last_buf->height == buf->height);
 
-        gettimeofday(&start_double_buffering, NULL);
         reapply_old_damage(term, buf, term->render.last_buf);
-        gettimeofday(&stop_double_buffering, NULL);
     }
 
-    if (term->render.last_buf != NULL) {
-        free(term->render.last_buf->scroll_damage);
-        term->render.last_buf->scroll_damage = NULL;
-    }
+    clock_gettime(CLOCK_MONOTONIC, &reapply_done);
 
     term->render.last_buf = buf;
     term->render.was_flashing = term->flash.active;
@@ -2258,38 +3218,28 @@ grid_render(struct terminal *term)
 
     buf->age = 0;
 
-    xassert(buf->scroll_damage == NULL);
-    buf->scroll_damage_count = tll_length(term->grid->scroll_damage);
-    buf->scroll_damage = xmalloc(
-        buf->scroll_damage_count * sizeof(buf->scroll_damage[0]));
-
-    {
-        size_t i = 0;
-        tll_foreach(term->grid->scroll_damage, it) {
-            buf->scroll_damage[i++] = it->item;
-
-            switch (it->item.type) {
-            case DAMAGE_SCROLL:
-                if (term->grid->view == term->grid->offset)
-                    grid_render_scroll(term, buf, &it->item);
-                break;
+    struct frame_damage *frame_damage = damage_history_push(
+        term, tll_length(term->grid->scroll_damage));
 
-            case DAMAGE_SCROLL_REVERSE:
-                if (term->grid->view == term->grid->offset)
-                    grid_render_scroll_reverse(term, buf, &it->item);
-                break;
+    tll_foreach(term->grid->scroll_damage, it) {
+        const struct damage *dmg = &it->item;
 
-            case DAMAGE_SCROLL_IN_VIEW:
-                grid_render_scroll(term, buf, &it->item);
-                break;
+        /* Scroll damage to the scrollback only applies when it's in view */
+        const bool applies =
+            dmg->type == DAMAGE_SCROLL_IN_VIEW ||
+            dmg->type == DAMAGE_SCROLL_REVERSE_IN_VIEW ||
+            term->grid->view == term->grid->offset;
 
-            case DAMAGE_SCROLL_REVERSE_IN_VIEW:
-                grid_render_scroll_reverse(term, buf, &it->item);
-                break;
-            }
+        if (applies) {
+            if (is_reverse_scroll(dmg))
+                grid_render_scroll_reverse(term, buf, dmg);
+            else
+                grid_render_scroll(term, buf, dmg);
 
-            tll_remove(term->grid->scroll_damage, it);
+            frame_damage->scroll[frame_damage->scroll_count++] = *dmg;
         }
+
+        tll_remove(term->grid->scroll_damage, it);
     }
 
     /*
@@ -2311,6 +3261,18 @@ grid_render(struct terminal *term)
      */
     selection_dirty_cells(term);
 
+    /* Sixels are rendered with it too */
+    snapshot_state(term);
+
+    /*
+     * Must be done before rendering sixels, since they clean the
+     * cells they cover, but still rely on the row being damaged.
+     */
+    size_t dirty_cells;
+    int dirty_count = collect_dirty_rows(term, &dirty_cells);
+
+    clock_gettime(CLOCK_MONOTONIC, &scroll_done);
+
     /* Translate offset-relative row to view-relative, unless cursor
      * is hidden, then we just set it to -1 */
     struct coord cursor = {-1, -1};
@@ -2318,78 +3280,116 @@ grid_render(struct terminal *term)
         cursor = term->grid->cursor.point;
         cursor.row += term->grid->offset;
         cursor.row -= term->grid->view;
-        cursor.row &= term->grid->num_rows - 1;
+        cursor.row = grid_row_wrap(term->grid, cursor.row);
     }
 
-    render_sixel_images(term, buf->pix[0], &cursor);
+    render_sixel_images(term, buf, &cursor);
 
-    if (term->render.workers.count > 0) {
-        mtx_lock(&term->render.workers.lock);
-        term->render.workers.buf = buf;
-        for (size_t i = 0; i < term->render.workers.count; i++)
-            sem_post(&term->render.workers.start);
+    clock_gettime(CLOCK_MONOTONIC, &sixel_done);
 
-        xassert(tll_length(term->render.workers.queue) == 0);
-    }
+    term->render.timings.threads = 1;
+    dirty_count = damage_dirty_rows(term, buf, dirty_count);
 
-    int first_dirty_row = -1;
-    for (int r = 0; r < term->rows; r++) {
-        struct row *row = grid_row_in_view(term->grid, r);
+    if (dirty_count > 0) {
+        struct timespec dispatch_start, dispatch_end, dispatch_time;
+        clock_gettime(CLOCK_MONOTONIC, &dispatch_start);
 
-        if (!row->dirty) {
-            if (first_dirty_row >= 0) {
-                int x = term->margins.left;
-                int y = term->margins.top + first_dirty_row * term->cell_height;
-                int width = term->width - term->margins.left - term->margins.right;
-                int height = (r - first_dirty_row) * term->cell_height;
-
-                wl_surface_damage_buffer(
-                    term->window->surface, x, y, width, height);
-                pixman_region32_union_rect(
-                    &buf->dirty, &buf->dirty, 0, y, buf->width, height);
+        size_t worker_count = render_workers_reserve(
+            render_workers_for_frame(term, dirty_count, dirty_cells));
+
+        /*
+         * Split the dirty rows into contiguous blocks, one per
+         * thread, including this one. Threads that run out of rows
+         * steal from the others.
+         */
+        const size_t thread_count = 1 + worker_count;
+        if (thread_count > 1) {
+            for (size_t i = 0; i < thread_count; i++) {
+                atomic_store_explicit(
+                    &workers.deques[i].range,
+                    deque_range(dirty_count * i / thread_count,
+                                dirty_count * (i + 1) / thread_count),
+                    memory_order_relaxed);
             }
-            first_dirty_row = -1;
-            continue;
         }
 
-        if (first_dirty_row < 0)
-            first_dirty_row = r;
+        snapshot_rows(term, dirty_count);
 
-        row->dirty = false;
+        /*
+         * Rows are rendered from the snapshot, so parser threads may
+         * update the grid in the meantime. Except in URL mode, where
+         * term->grid is the URL mode's grid snapshot, for now.
+         */
+        const bool unlock = !urls_mode_is_active(term);
+        if (unlock)
+            fdm_unlock(term->fdm);
+
+        workers.term = term;
+        workers.buf = buf;
+        workers.cursor = cursor;
+        workers.thread_count = thread_count;
+        atomic_store_explicit(&workers.next_id, 1, memory_order_relaxed);
+        atomic_store_explicit(&workers.busy_ns, 0, memory_order_relaxed);
+
+        for (size_t i = 0; i < worker_count; i++)
+            sem_post(&workers.start);
+
+        if (thread_count > 1)
+            render_rows(term, buf, 0, cursor);
+        else {
+            /* Not worth waking any threads */
+            pixman_glyph_cache_t *glyph_cache = glyph_cache_get();
+            for (int i = 0; i < dirty_count; i++) {
+                int r = workers.rows[i].row_no;
+                struct row *row = &term->render.snapshot.rows[r];
+                int cursor_col = cursor.row == r ? cursor.col : -1;
+                render_row(term, buf->pix[0], glyph_cache, row, r, cursor_col);
+            }
+        }
 
-        if (term->render.workers.count > 0)
-            tll_push_back(term->render.workers.queue, r);
+        for (size_t i = 0; i < worker_count; i++)
+            sem_wait(&workers.done);
 
-        else {
-            int cursor_col = cursor.row == r ? cursor.col : -1;
-            render_row(term, buf->pix[0], row, r, cursor_col);
+        if (unlock) {
+            fdm_lock(term->fdm);
+
+            /* For the IME pre-edit text, rendered from the live grid */
+            snapshot_state(term);
         }
-    }
 
-    if (first_dirty_row >= 0) {
-        int x = term->margins.left;
-        int y = term->margins.top + first_dirty_row * term->cell_height;
-        int width = term->width - term->margins.left - term->margins.right;
-        int height = (term->rows - first_dirty_row) * term->cell_height;
+        snapshot_rows_rendered(term, dirty_count);
 
-        wl_surface_damage_buffer(term->window->surface, x, y, width, height);
-        pixman_region32_union_rect(&buf->dirty, &buf->dirty, 0, y, buf->width, height);
-    }
+        clock_gettime(CLOCK_MONOTONIC, &dispatch_end);
+        timespec_sub(&dispatch_end, &dispatch_start, &dispatch_time);
+
+        if (thread_count == 1) {
+            atomic_store_explicit(
+                &workers.busy_ns, timespec_to_nsecs(&dispatch_time),
+                memory_order_relaxed);
+        }
 
-    /* Signal workers the frame is done */
-    if (term->render.workers.count > 0) {
-        for (size_t i = 0; i < term->render.workers.count; i++)
-            tll_push_back(term->render.workers.queue, -1);
-        mtx_unlock(&term->render.workers.lock);
+        render_workers_update_cost(term, dirty_cells, thread_count, &dispatch_time);
+        term->render.timings.threads = thread_count;
 
-        for (size_t i = 0; i < term->render.workers.count; i++)
-            sem_wait(&term->render.workers.done);
-        term->render.workers.buf = NULL;
+        workers.term = NULL;
+        workers.buf = NULL;
     }
 
+    clock_gettime(CLOCK_MONOTONIC, &rows_done);
+
+    timespec_sub(&reapply_done, &start_time, &term->render.timings.reapply);
+    timespec_sub(&scroll_done, &reapply_done, &term->render.timings.scroll);
+    timespec_sub(&sixel_done, &scroll_done, &term->render.timings.sixel);
+    timespec_sub(&rows_done, &sixel_done, &term->render.timings.rows);
+
     /* Render IME pre-edit text */
     render_ime_preedit(term, buf);
 
+    if (atomic_exchange_explicit(&workers.blinking, false, memory_order_relaxed))
+        term_arm_blink_timer(term);
+
+    pixman_region32_copy(&frame_damage->dirty, &buf->dirty);
+
     if (term->flash.active) {
         /* Note: alpha is pre-computed in each color component */
         /* TODO: dim while searching */
@@ -2405,22 +3405,28 @@ grid_render(struct terminal *term)
     render_scrollback_position(term);
 
     if (term->conf->tweak.render_timer_osd || term->conf->tweak.render_timer_log) {
-        struct timeval end_time;
-        gettimeofday(&end_time, NULL);
+        struct timespec end_time;
+        clock_gettime(CLOCK_MONOTONIC, &end_time);
 
-        struct timeval render_time;
-        timersub(&end_time, &start_time, &render_time);
-
-        struct timeval double_buffering_time;
-        timersub(&stop_double_buffering, &start_double_buffering, &double_buffering_time);
+        struct timespec render_time;
+        timespec_sub(&end_time, &start_time, &render_time);
 
         if (term->conf->tweak.render_timer_log) {
+            const struct timespec *reapply = &term->render.timings.reapply;
+            const struct timespec *scroll = &term->render.timings.scroll;
+            const struct timespec *sixel = &term->render.timings.sixel;
+            const struct timespec *rows = &term->render.timings.rows;
+
             LOG_INFO("frame rendered in %llds %lld µs "
-                     "(%llds %lld µs double buffering)",
+                     "(reapply: %lld µs, scroll: %lld µs, "
+                     "sixel: %lld µs, rows: %lld µs, threads: %zu)",
                      (long long)render_time.tv_sec,
-                     (long long)render_time.tv_usec,
-                     (long long)double_buffering_time.tv_sec,
-                     (long long)double_buffering_time.tv_usec);
+                     (long long)render_time.tv_nsec / 1000,
+                     timespec_to_usecs(reapply),
+                     timespec_to_usecs(scroll),
+                     timespec_to_usecs(sixel),
+                     timespec_to_usecs(rows),
+                     term->render.timings.threads);
         }
 
         if (term->conf->tweak.render_timer_osd)
@@ -2473,6 +3479,10 @@ grid_render(struct terminal *term)
 
     wl_surface_attach(term->window->surface, buf->wl_buf, 0, 0);
     wl_surface_commit(term->window->surface);
+
+    struct timespec commit_done;
+    clock_gettime(CLOCK_MONOTONIC, &commit_done);
+    timespec_sub(&commit_done, &rows_done, &term->render.timings.commit);
 }
 
 static void
@@ -2527,10 +3537,10 @@ render_search_box(struct terminal *term)
     /* Calculate the width of each character */
     int widths[text_len + 1];
     for (size_t i = 0; i < text_len; i++)
-        widths[i] = max(0, wcwidth(text[i]));
+        widths[i] = max(0, my_wcwidth(text[i]));
     widths[text_len] = 0;
 
-    const size_t total_cells = wcswidth(text, text_len);
+    const size_t total_cells = my_wcswidth(text, text_len);
     const size_t wanted_visible_cells = max(20, total_cells);
 
     xassert(term->scale >= 1);
@@ -2668,7 +3678,9 @@ render_search_box(struct terminal *term)
                     int count = min(ime_seat->ime.preedit.count, cells_left);
 
                     /* Underline the entire (visible part of) pre-edit text */
-                    draw_underline(term, buf->pix[0], font, &fg, x, y, count);
+                    draw_underline(
+                        term, buf->pix[0], font, font_baseline(term),
+                        &fg, x, y, count);
 
                     /* Bar-styled cursor, if in the visible area */
                     if (start >= 0 && start <= visible_cells) {
@@ -2687,8 +3699,12 @@ render_search_box(struct terminal *term)
                         min(ime_seat->ime.preedit.count - ime_seat->ime.preedit.cursor.end,
                             cells_left - end),
                         0);
-                    draw_underline(term, buf->pix[0], font, &fg, x, y, count1);
-                    draw_underline(term, buf->pix[0], font, &fg, x + end * term->cell_width, y, count2);
+                    draw_underline(
+                        term, buf->pix[0], font, font_baseline(term),
+                        &fg, x, y, count1);
+                    draw_underline(
+                        term, buf->pix[0], font, font_baseline(term),
+                        &fg, x + end * term->cell_width, y, count2);
 
                     /* TODO: how do we handle a partially hidden rectangle? */
                     if (start >= 0 && end <= visible_cells) {
@@ -2805,12 +3821,9 @@ render_urls(struct terminal *term)
     xassert(tll_length(win->urls) > 0);
 
     /* Calculate view start, counted from the *current* scrollback start */
-    const int scrollback_end
-        = (term->grid->offset + term->rows) & (term->grid->num_rows - 1);
+    const int scrollback_end = grid_row_absolute(term->grid, term->rows);
     const int view_start
-        = (term->grid->view
-           - scrollback_end
-           + term->grid->num_rows) & (term->grid->num_rows - 1);
+        = grid_row_wrap(term->grid, term->grid->view - scrollback_end);
     const int view_end = view_start + term->rows - 1;
 
     const bool show_url = term->urls_show_uri_on_jump_label;
@@ -2835,9 +3848,7 @@ render_urls(struct terminal *term)
         bool hide = false;
         const struct coord *pos = &url->start;
         const int _row
-            = (pos->row
-               - scrollback_end
-               + term->grid->num_rows) & (term->grid->num_rows - 1);
+            = grid_row_wrap(term->grid, pos->row - scrollback_end);
 
         if (_row < view_start || _row > view_end)
             hide = true;
@@ -2853,10 +3864,7 @@ render_urls(struct terminal *term)
         }
 
         int col = pos->col;
-        int row = pos->row - term->grid->view;
-        while (row < 0)
-            row += term->grid->num_rows;
-        row &= (term->grid->num_rows - 1);
+        int row = grid_row_wrap(term->grid, pos->row - term->grid->view);
 
         /* Position label slightly above and to the left */
         int x = col * term->cell_width - 15 * term->cell_width / 10;
@@ -2916,7 +3924,7 @@ render_urls(struct terminal *term)
         int cols = 0;
 
         for (size_t i = 0; i <= wcslen(label); i++) {
-            int _cols = wcswidth(label, i);
+            int _cols = my_wcswidth(label, i);
 
             if (_cols == (size_t)-1)
                 continue;
@@ -3228,9 +4236,9 @@ maybe_resize(struct terminal *term, int width, int height, bool force)
     const int new_cols = (term->width - 2 * pad_x) / term->cell_width;
     const int new_rows = (term->height - 2 * pad_y) / term->cell_height;
 
-    /* Grid rows/cols after resize */
-    const int new_normal_grid_rows = 1 << (32 - __builtin_clz(new_rows + scrollback_lines - 1));
-    const int new_alt_grid_rows = 1 << (32  - __builtin_clz(new_rows));
+    /* Grid rows (screen + scrollback) after resize */
+    const int new_normal_grid_rows = new_rows + scrollback_lines;
+    const int new_alt_grid_rows = new_rows;
 
     xassert(new_cols >= 1);
     xassert(new_rows >= 1);
@@ -3269,12 +4277,33 @@ maybe_resize(struct terminal *term, int width, int height, bool force)
         &term->selection.end,
     };
 
+    /*
+     * With scrollback.spill, lines paged in from the spill file
+     * become regular scrollback lines. The ring keeps the slots
+     * added for them, and is then shrunk to fit the rows actually
+     * kept (see term_spill_resized()).
+     */
+    const bool spill = term->conf->scrollback.spill;
+    if (spill)
+        spill_unload(term);
+
     /* Resize grids */
     grid_resize_and_reflow(
-        &term->normal, new_normal_grid_rows, new_cols, old_rows, new_rows,
+        &term->normal,
+        new_normal_grid_rows + (spill ? term->spill.grown : 0),
+        new_cols, old_rows, new_rows, term->conf->scrollback.compress,
         term->selection.end.row >= 0 ? ALEN(tracking_points) : 0, tracking_points,
         term->composed_count, term->composed);
 
+    /*
+     * Reflowing compresses all rows that are at least two screens
+     * above the last one; compress the remaining cold rows
+     */
+    if (term->conf->scrollback.compress) {
+        grid_compress_scrollback(
+            &term->normal, new_rows, term->normal.num_rows);
+    }
+
     grid_resize_without_reflow(
         &term->alt, new_alt_grid_rows, new_cols, old_rows, new_rows);
 
@@ -3286,6 +4315,9 @@ maybe_resize(struct terminal *term, int width, int height, bool force)
     term->cols = new_cols;
     term->rows = new_rows;
 
+    if (spill)
+        term_spill_resized(term, new_normal_grid_rows);
+
     sixel_reflow(term);
 
 #if defined(_DEBUG) && LOG_ENABLE_DBG
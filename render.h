@@ -19,8 +19,5 @@ void render_refresh_title(struct terminal *term);
 void render_refresh_urls(struct terminal *term);
 bool render_xcursor_set(struct seat *seat, struct terminal *term, const char *xcursor);
 
-struct render_worker_context {
-    int my_id;
-    struct terminal *term;
-};
-int render_worker_thread(void *_ctx);
+/* Call whenever glyphs that may have been rendered are freed */
+void render_glyph_caches_invalidate(void);
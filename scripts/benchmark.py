@@ -2,7 +2,10 @@
 
 import argparse
 import fcntl
+import importlib.util
+import io
 import os
+import random
 import statistics
 import struct
 import sys
@@ -11,22 +14,62 @@ import termios
 from datetime import datetime
 
 
+def load_corpus_generator():
+    # Same corpora as 'meson benchmark' (foot-bench)
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                        'generate-bench-corpus.py')
+    spec = importlib.util.spec_from_file_location('generate_bench_corpus', path)
+    module = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(module)
+    return module
+
+
+class GeneratedCorpus:
+    def __init__(self, generator, name, lines, cols, size):
+        self.name = name
+        self._generator = generator
+        self._opts = argparse.Namespace(rows=lines, cols=cols, size=size)
+
+    def read(self):
+        rng = random.Random()
+        rng.seed(a=0, version=2)
+
+        out = io.StringIO()
+        self._generator.generate(self.name, out, rng, self._opts)
+        return out.getvalue().encode('utf-8')
+
+
 def main():
+    generator = load_corpus_generator()
+
     parser = argparse.ArgumentParser()
-    parser.add_argument('files', type=argparse.FileType('rb'), nargs='+')
+    parser.add_argument('files', type=argparse.FileType('rb'), nargs='*')
     parser.add_argument('--iterations', type=int, default=20)
+    parser.add_argument('--corpus', action='append', default=[],
+                        choices=generator.CORPORA,
+                        help='benchmark a generated corpus (may be given multiple times)')
+    parser.add_argument('--corpus-size', type=int, default=4 * 1024**2,
+                        help='approximate size, in bytes, of generated corpora')
 
     args = parser.parse_args()
 
+    if not args.files and not args.corpus:
+        parser.error('no files, and no --corpus, given')
+
     lines, cols, height, width = struct.unpack(
         'HHHH',
         fcntl.ioctl(sys.stdout.fileno(),
                     termios.TIOCGWINSZ,
                     struct.pack('HHHH', 0, 0, 0, 0)))
 
-    times = {name: [] for name in [f.name for f in args.files]}
+    # Generated corpora are sized after the current window
+    corpora = args.files + [
+        GeneratedCorpus(generator, name, lines, cols, args.corpus_size)
+        for name in args.corpus]
+
+    times = {name: [] for name in [f.name for f in corpora]}
 
-    for f in args.files:
+    for f in corpora:
         bench_bytes = f.read()
 
         for i in range(args.iterations):
@@ -41,7 +84,7 @@ def main():
     print('\033[J')
     print(times)
     print(f'cols={cols}, lines={lines}, width={width}px, height={height}px')
-    for f in args.files:
+    for f in corpora:
         print(f'{os.path.basename(f.name)}: '
               f'{statistics.mean(times[f.name]):.3f}s '
               f'±{statistics.stdev(times[f.name]):.3f}')
@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+import argparse
+import random
+import sys
+
+
+CORPORA = ['ascii', 'ascii-short', 'sgr', 'cjk', 'combining', 'scroll-region', 'sixel']
+
+WORDS = ('the quick brown fox jumps over lazy dog lorem ipsum dolor sit amet '
+         'consectetur adipiscing elit sed do eiusmod tempor incididunt ut '
+         'labore et dolore magna aliqua foo bar baz qux 0 1 42 1337 0x7f '
+         '--help -v /usr/bin/foot ./configure && || ; { } ( ) [ ] = == !=').split()
+
+CJK = ('漢字中文字符测试日本語のテキスト한국어텍스트'
+       '東京大阪京都北海道沖縄上海北京香港台北首尔釜山')
+
+COMBINING = [
+    # Vietnamese, decomposed (NFD)
+    'Tiếng Việt có dấu',
+    'à á ã ả ạ ề ớ',
+    # Devanagari
+    'क्षत्रिय हिंदी',
+    # Zalgo
+    'Z͓͔͑͒a͕͖͗l͙͘g͚͛o͜',
+    # Plain, for contrast
+    'plain ascii words in between',
+]
+
+SIXELS = '?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`abcdefghijklmnopqrstuvwxyz{|}~'
+
+
+def gen_ascii(out, rng, opts):
+    while out.tell() < opts.size:
+        line = []
+        width = 0
+        while width < opts.cols * 2:
+            w = rng.choice(WORDS)
+            line.append(w)
+            width += len(w) + 1
+        out.write(' '.join(line) + '\r\n')
+
+
+def gen_ascii_short(out, rng, opts):
+    # Like 'ls', or a compiler's progress output: short runs of
+    # printable ASCII, broken up by tabs, and short lines
+    while out.tell() < opts.size:
+        fields = [rng.choice(WORDS) for _ in range(rng.randrange(1, 8))]
+        out.write('\t'.join(fields) + '\r\n')
+
+
+def sgr(rng):
+    kind = rng.randrange(6)
+    if kind == 0:
+        return '\033[m'
+    if kind == 1:
+        return f'\033[{rng.choice([30, 40, 90, 100]) + rng.randrange(8)}m'
+    if kind == 2:
+        return f'\033[{rng.choice([38, 48])};5;{rng.randrange(256)}m'
+    if kind == 3:
+        return (f'\033[{rng.choice([38, 48])}:2::{rng.randrange(256)}:'
+                f'{rng.randrange(256)}:{rng.randrange(256)}m')
+    if kind == 4:
+        return f'\033[{rng.choice([1, 2, 3, 4, 5, 7, 9])}m'
+    return f'\033[{rng.choice([22, 23, 24, 27, 29, 39, 49])}m'
+
+
+def gen_sgr(out, rng, opts):
+    while out.tell() < opts.size:
+        line = []
+        for _ in range(opts.cols // 6):
+            line.append(sgr(rng) + rng.choice(WORDS))
+        out.write(' '.join(line) + '\033[m\r\n')
+
+
+def gen_cjk(out, rng, opts):
+    while out.tell() < opts.size:
+        line = ''.join(rng.choice(CJK) for _ in range(opts.cols // 2))
+        out.write(line + '\r\n')
+
+
+def gen_combining(out, rng, opts):
+    while out.tell() < opts.size:
+        line = []
+        width = 0
+        while width < opts.cols:
+            s = rng.choice(COMBINING)
+            line.append(s)
+            width += len(s) + 1
+        out.write(' '.join(line) + '\r\n')
+
+
+def gen_scroll_region(out, rng, opts):
+    lines, cols = opts.rows, opts.cols
+
+    while out.tell() < opts.size:
+        top = rng.randrange(1, lines // 2)
+        bottom = rng.randrange(lines // 2 + 1, lines + 1)
+        out.write(f'\033[{top};{bottom}r\033[{bottom};1H')
+
+        for _ in range(rng.randrange(1, 64)):
+            action = rng.randrange(6)
+            text = ' '.join(rng.choice(WORDS) for _ in range(cols // 8))[:cols]
+
+            if action == 0:
+                # Linefeed at the bottom of the region
+                out.write(f'\r\n{text}')
+            elif action == 1:
+                out.write(f'\033[{rng.randrange(1, 8)}S')
+            elif action == 2:
+                out.write(f'\033[{rng.randrange(1, 8)}T')
+            elif action == 3:
+                # Reverse index at the top of the region
+                out.write(f'\033[{top};1H\033M{text}\033[{bottom};1H')
+            elif action == 4:
+                out.write(f'\033[{rng.randrange(top, bottom + 1)};1H'
+                          f'\033[{rng.randrange(1, 4)}L{text}')
+            else:
+                out.write(f'\033[{rng.randrange(top, bottom + 1)};1H'
+                          f'\033[{rng.randrange(1, 4)}M{text}')
+
+    out.write('\033[r')
+
+
+def gen_sixel(out, rng, opts):
+    # The bench binary hardcodes the cell size to 8x15 px
+    height, width = opts.rows * 15, opts.cols * 8
+
+    while out.tell() < opts.size:
+        six_width = rng.randrange(16, width // 2)
+        six_rows = rng.randrange(1, height // 2 // 6)
+
+        # Like an image viewer in a shell; each image is emitted at
+        # the cursor, and is eventually scrolled out
+        out.write(' '.join(rng.choice(WORDS) for _ in range(8)) + '\r\n')
+        out.write(f'\033Pq"1;1;{six_width};{six_rows * 6}')
+
+        for idx in range(16):
+            out.write(f'#{idx};2;{rng.randrange(101)};'
+                      f'{rng.randrange(101)};{rng.randrange(101)}')
+
+        for row in range(six_rows):
+            bands = rng.randrange(1, 5)
+            for band in range(bands):
+                out.write(f'#{rng.randrange(16)}')
+
+                pix_left = six_width
+                while pix_left > 0:
+                    if rng.randrange(2):
+                        count = rng.randrange(1, pix_left + 1)
+                        out.write(f'!{count}{rng.choice(SIXELS)}')
+                    else:
+                        count = min(pix_left, 8)
+                        out.write(''.join(rng.choice(SIXELS) for _ in range(count)))
+                    pix_left -= count
+
+                out.write('$' if band + 1 < bands else '-')
+
+        out.write('\033\\\r\n')
+
+
+GENERATORS = {
+    'ascii': gen_ascii,
+    'ascii-short': gen_ascii_short,
+    'sgr': gen_sgr,
+    'cjk': gen_cjk,
+    'combining': gen_combining,
+    'scroll-region': gen_scroll_region,
+    'sixel': gen_sixel,
+}
+
+
+def generate(corpus, out, rng, opts):
+    GENERATORS[corpus](out, rng, opts)
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('corpus', choices=CORPORA)
+    parser.add_argument('out', type=argparse.FileType(mode='w', encoding='utf-8'))
+    parser.add_argument('--rows', type=int, default=67)
+    parser.add_argument('--cols', type=int, default=135)
+    parser.add_argument('--size', type=int, default=4 * 1024**2,
+                        help='approximate size, in bytes, of the generated corpus')
+    parser.add_argument('--seed', type=int, default=0)
+
+    opts = parser.parse_args()
+
+    # Pin the seeding method, to keep the corpora stable across
+    # Python versions
+    rng = random.Random()
+    rng.seed(a=opts.seed, version=2)
+
+    generate(opts.corpus, opts.out, rng, opts)
+
+
+if __name__ == '__main__':
+    sys.exit(main())
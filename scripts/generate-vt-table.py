@@ -0,0 +1,222 @@
+#!/usr/bin/env python3
+import argparse
+import re
+import sys
+
+
+class State:
+    def __init__(self, name, anywhere, entry, exit):
+        self.name = name
+        self.anywhere = anywhere
+        self.entry = entry
+        self.exit = exit
+        self.transitions = [None] * 256
+        self.default = None
+
+
+def parse_bytes(spec, lineno):
+    result = []
+    for part in spec.split(','):
+        m = re.fullmatch(r'([0-9a-fA-F]{2})(?:-([0-9a-fA-F]{2}))?', part)
+        if m is None:
+            raise SyntaxError(f'{lineno}: invalid byte range: {part}')
+
+        first = int(m.group(1), 16)
+        last = int(m.group(2), 16) if m.group(2) is not None else first
+
+        if last < first:
+            raise SyntaxError(f'{lineno}: invalid byte range: {part}')
+
+        result += range(first, last + 1)
+    return result
+
+
+def parse_transition(words, lineno):
+    action = None
+    new_state = None
+
+    if '->' in words:
+        idx = words.index('->')
+        if idx != len(words) - 2:
+            raise SyntaxError(f'{lineno}: expected exactly one state after \'->\'')
+        new_state = words[-1]
+        words = words[:idx]
+
+    if len(words) > 1:
+        raise SyntaxError(f'{lineno}: expected at most one action')
+    if len(words) == 1:
+        action = words[0]
+
+    # 'ignore' is just that; a no-op
+    if action == 'ignore':
+        action = None
+
+    return action, new_state
+
+
+def parse(f):
+    states = {}
+    anywhere = [None] * 256
+    current = None
+    current_state = None
+
+    for lineno, line in enumerate(f, start=1):
+        line = line.split('#', 1)[0].strip()
+        if not line:
+            continue
+
+        words = line.split()
+
+        if words[0] == 'anywhere':
+            current = anywhere
+            current_state = None
+            continue
+
+        if words[0] == 'state':
+            name = words[1]
+            flags = {'anywhere': False, 'entry': None, 'exit': None}
+
+            for w in words[2:]:
+                if w == 'anywhere':
+                    flags['anywhere'] = True
+                elif '=' in w:
+                    key, value = w.split('=', 1)
+                    if key not in ('entry', 'exit'):
+                        raise SyntaxError(f'{lineno}: unknown state attribute: {key}')
+                    flags[key] = value
+                else:
+                    raise SyntaxError(f'{lineno}: unknown state attribute: {w}')
+
+            if name in states:
+                raise SyntaxError(f'{lineno}: {name}: state already defined')
+
+            current_state = State(name, **flags)
+            current = current_state.transitions
+            states[name] = current_state
+            continue
+
+        if current is None:
+            raise SyntaxError(f'{lineno}: transition outside of state')
+
+        transition = parse_transition(words[1:], lineno)
+
+        if words[0] == 'default':
+            if current_state is None:
+                raise SyntaxError(f'{lineno}: \'anywhere\' cannot have a default')
+            current_state.default = transition
+            continue
+
+        for b in parse_bytes(words[0], lineno):
+            if current[b] is not None:
+                raise SyntaxError(f'{lineno}: 0x{b:02x}: transition already defined')
+            current[b] = transition
+
+    return states, anywhere
+
+
+def resolve(states, anywhere):
+    """
+    Returns the unique action sequences, the unique transitions, and
+    the transition table.
+
+    An action sequence is a tuple of the actions to run (exit,
+    transition, entry), with empty actions removed. A transition is an
+    (action sequence ID, new state) tuple. The table maps each state
+    and byte to a transition ID.
+    """
+    actions = {(): 0}
+    transitions = {}
+    table = []
+
+    for state in states.values():
+        row = []
+
+        for b in range(256):
+            transition = state.transitions[b]
+            if transition is None and state.anywhere:
+                transition = anywhere[b]
+            if transition is None:
+                transition = state.default
+            if transition is None:
+                transition = (None, None)
+
+            action, new_state = transition
+
+            if new_state is None:
+                seq = (action,)
+                new_state = state.name
+            else:
+                if new_state not in states:
+                    raise SyntaxError(f'{state.name}: 0x{b:02x}: {new_state}: no such state')
+                seq = (state.exit, action, states[new_state].entry)
+
+            seq = tuple(a for a in seq if a is not None)
+            if seq not in actions:
+                actions[seq] = len(actions)
+
+            transition = (actions[seq], new_state)
+            if transition not in transitions:
+                transitions[transition] = len(transitions)
+
+            row.append(transitions[transition])
+
+        table.append(row)
+
+    return actions, transitions, table
+
+
+def action_id(seq):
+    return 'VT_ACTION_' + ('_'.join(seq) if seq else 'none').upper()
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('input', type=argparse.FileType('r'))
+    parser.add_argument('output', type=argparse.FileType('w'))
+    opts = parser.parse_args()
+
+    try:
+        states, anywhere = parse(opts.input)
+        actions, transitions, table = resolve(states, anywhere)
+    except SyntaxError as e:
+        print(f'{opts.input.name}:{e.msg}', file=sys.stderr)
+        sys.exit(1)
+
+    assert len(transitions) <= 256
+
+    out = opts.output
+    out.write(f'/* Generated by generate-vt-table.py from {opts.input.name.split("/")[-1]} */\n')
+    out.write('#pragma once\n\n')
+    out.write('#include <stdint.h>\n\n')
+
+    out.write('enum state {\n')
+    for name in states:
+        out.write(f'    STATE_{name.upper()},\n')
+    out.write('};\n\n')
+
+    out.write('/* Exit action, transition action, entry action */\n')
+    out.write('enum vt_action {\n')
+    for seq in actions:
+        out.write(f'    {action_id(seq)},\n')
+    out.write('};\n\n')
+
+    action_names = list(actions)
+
+    out.write('/* Transition ID -> action, new state */\n')
+    out.write('#define VT_TRANSITIONS(X) \\\n')
+    for (action, new_state), idx in transitions.items():
+        out.write(f'    X({idx}, {action_id(action_names[action])}, STATE_{new_state.upper()}) \\\n')
+    out.write('\n')
+
+    out.write('/* State, byte -> transition ID */\n')
+    out.write('static const uint8_t vt_table[][256] = {\n')
+    for state, row in zip(states, table):
+        out.write(f'    [STATE_{state.upper()}] = {{\n')
+        for i in range(0, 256, 16):
+            entries = ', '.join(f'{idx:2}' for idx in row[i:i + 16])
+            out.write(f'        {entries},\n')
+        out.write('    },\n')
+    out.write('};\n')
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,218 @@
+#!/usr/bin/env python3
+import argparse
+import os
+import sys
+import unicodedata
+
+
+MAX_CODEPOINT = 0x10ffff
+BLOCK_SHIFT = 8
+BLOCK_SIZE = 1 << BLOCK_SHIFT
+
+# UAX #11: unassigned code points in these ranges default to 'W'
+DEFAULT_WIDE = [
+    (0x3400, 0x4dbf),
+    (0x4e00, 0x9fff),
+    (0xf900, 0xfaff),
+    (0x20000, 0x2fffd),
+    (0x30000, 0x3fffd),
+]
+
+# PropList.txt: Prepended_Concatenation_Mark
+PREPENDED_CONCATENATION_MARKS = {
+    *range(0x0600, 0x0606), 0x06dd, 0x070f, 0x0890, 0x0891, 0x08e2,
+    0x110bd, 0x110cd,
+}
+
+
+def parse_ucd_file(path):
+    """
+    Yields (first, last, fields) for each entry in a UCD data file
+    """
+    with open(path, 'r', encoding='utf-8') as f:
+        for line in f:
+            line = line.split('#', 1)[0].strip()
+            if not line:
+                continue
+
+            fields = [x.strip() for x in line.split(';')]
+            cps = fields[0].split('..')
+            first = int(cps[0], 16)
+            last = int(cps[1], 16) if len(cps) > 1 else first
+            yield first, last, fields[1:]
+
+
+def ucd_version(ucd_dir):
+    """
+    Returns the Unicode version of the UCD files in 'ucd_dir', from the
+    header of EastAsianWidth.txt ('# EastAsianWidth-14.0.0.txt')
+    """
+    with open(os.path.join(ucd_dir, 'EastAsianWidth.txt'), 'r', encoding='utf-8') as f:
+        header = f.readline().strip()
+
+    prefix, suffix = '# EastAsianWidth-', '.txt'
+    if not header.startswith(prefix) or not header.endswith(suffix):
+        return None
+    return header[len(prefix):-len(suffix)]
+
+
+def load_ucd(ucd_dir):
+    """
+    Returns (general category, east asian width) lookup functions,
+    backed by UnicodeData.txt and EastAsianWidth.txt
+    """
+    category = {}
+    range_first = None
+
+    for cp, _, fields in parse_ucd_file(os.path.join(ucd_dir, 'UnicodeData.txt')):
+        name, gc = fields[0], fields[1]
+
+        # Ranges are encoded as '<Foo, First>', '<Foo, Last>' pairs
+        if name.endswith(', First>'):
+            range_first = cp
+            continue
+        if name.endswith(', Last>'):
+            for c in range(range_first, cp + 1):
+                category[c] = gc
+            continue
+
+        category[cp] = gc
+
+    eaw = {}
+    for first, last, fields in parse_ucd_file(os.path.join(ucd_dir, 'EastAsianWidth.txt')):
+        for c in range(first, last + 1):
+            eaw[c] = fields[0]
+
+    return (lambda cp: category.get(cp, 'Cn'),
+            lambda cp: eaw.get(cp, 'N'))
+
+
+def load_builtin():
+    """
+    Returns (general category, east asian width) lookup functions,
+    backed by Python's unicodedata module
+    """
+    def east_asian_width(cp):
+        # unicodedata doesn't return a meaningful width for
+        # unassigned code points; use the same default as
+        # EastAsianWidth.txt. See also DEFAULT_WIDE.
+        if unicodedata.category(chr(cp)) == 'Cn':
+            return 'N'
+        return unicodedata.east_asian_width(chr(cp))
+
+    return (lambda cp: unicodedata.category(chr(cp)),
+            east_asian_width)
+
+
+def width(cp, category, east_asian_width):
+    if cp == 0:
+        return 0
+
+    gc = category(cp)
+
+    if gc in ('Cc', 'Cs'):
+        return -1
+
+    if gc in ('Mn', 'Me'):
+        return 0
+
+    # Format characters (e.g. ZWSP, ZWJ, BIDI controls), except SOFT
+    # HYPHEN and the prepended concatenation marks, which *are* visible
+    if gc == 'Cf' and cp != 0x00ad and cp not in PREPENDED_CONCATENATION_MARKS:
+        return 0
+
+    # Hangul Jamo medial vowels and final consonants; these combine
+    # with the preceding initial consonant
+    if 0x1160 <= cp <= 0x11ff or 0xd7b0 <= cp <= 0xd7ff:
+        return 0
+
+    if east_asian_width(cp) in ('W', 'F'):
+        return 2
+
+    if gc == 'Cn' and any(first <= cp <= last for first, last in DEFAULT_WIDE):
+        return 2
+
+    # Everything else, including unassigned code points and private
+    # use characters, is single-width
+    return 1
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('output')
+    parser.add_argument(
+        '--ucd', metavar='DIR',
+        help='directory containing UnicodeData.txt and EastAsianWidth.txt '
+             '(default: use Python\'s built-in unicodedata module)')
+    parser.add_argument(
+        '--unicode-version', metavar='VERSION', required=True,
+        help='the Unicode version the table is expected to be generated '
+             'from; fails if the UCD (or Python\'s unicodedata) is of any '
+             'other version')
+    opts = parser.parse_args()
+
+    if opts.ucd:
+        version = ucd_version(opts.ucd)
+        source = f'the UCD files in {opts.ucd}'
+    else:
+        version = unicodedata.unidata_version
+        source = 'Python\'s unicodedata module'
+
+    # The widths must not depend on what happens to be installed on
+    # the build host
+    if version != opts.unicode_version:
+        print(f'error: {source}: Unicode {version}, '
+              f'expected Unicode {opts.unicode_version}',
+              file=sys.stderr)
+        sys.exit(1)
+
+    if opts.ucd:
+        category, east_asian_width = load_ucd(opts.ucd)
+    else:
+        category, east_asian_width = load_builtin()
+
+    # Widths are stored as (width + 1), in two bits, four per byte
+    blocks = {}
+    stage1 = []
+
+    for block_start in range(0, MAX_CODEPOINT + 1, BLOCK_SIZE):
+        packed = bytearray(BLOCK_SIZE // 4)
+
+        for i in range(BLOCK_SIZE):
+            w = width(block_start + i, category, east_asian_width)
+            packed[i // 4] |= (w + 1) << ((i % 4) * 2)
+
+        packed = bytes(packed)
+        if packed not in blocks:
+            blocks[packed] = len(blocks)
+        stage1.append(blocks[packed])
+
+    assert len(blocks) <= 256
+
+    with open(opts.output, 'w', encoding='utf-8') as out:
+        out.write(f'/* Generated by generate-wcwidth-table.py from Unicode {version} */\n')
+        out.write('/* Do not edit; see INSTALL.md for how to re-generate */\n')
+        out.write('#pragma once\n\n')
+        out.write('#include <stdint.h>\n\n')
+        out.write(f'#define WCWIDTH_UNICODE_VERSION "{version}"\n')
+        out.write(f'#define WCWIDTH_MAX_CODEPOINT 0x{MAX_CODEPOINT:x}\n')
+        out.write(f'#define WCWIDTH_BLOCK_SHIFT {BLOCK_SHIFT}\n\n')
+
+        out.write('/* Code point >> WCWIDTH_BLOCK_SHIFT -> block index */\n')
+        out.write(f'static const uint8_t wcwidth_stage1[{len(stage1)}] = {{\n')
+        for i in range(0, len(stage1), 16):
+            out.write('    ' + ', '.join(f'{b:3}' for b in stage1[i:i + 16]) + ',\n')
+        out.write('};\n\n')
+
+        out.write('/* Block index -> (width + 1), two bits per code point */\n')
+        out.write(f'static const uint8_t wcwidth_stage2[{len(blocks)}][{BLOCK_SIZE // 4}] = {{\n')
+        for packed in blocks:
+            out.write('    {\n')
+            for i in range(0, len(packed), 16):
+                out.write('        ' + ', '.join(f'0x{b:02x}' for b in packed[i:i + 16]) + ',\n')
+            out.write('    },\n')
+        out.write('};\n')
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -21,6 +21,9 @@
 #include "util.h"
 #include "xmalloc.h"
 
+/* Number of spilled lines paged in at a time, when searching them */
+#define SEARCH_SPILL_CHUNK 1024
+
 /*
  * Ensures a "new" viewport doesn't contain any unallocated rows.
  *
@@ -35,25 +38,23 @@
 static int
 ensure_view_is_allocated(struct terminal *term, int new_view)
 {
-    int view_end = (new_view + term->rows - 1) & (term->grid->num_rows - 1);
+    int view_end = grid_row_wrap(term->grid, new_view + term->rows - 1);
 
-    if (term->grid->rows[new_view] == NULL) {
-        while (term->grid->rows[new_view] == NULL)
-            new_view = (new_view + 1) & (term->grid->num_rows - 1);
+    if (grid_ring_get(term->grid, new_view) == NULL) {
+        while (grid_ring_get(term->grid, new_view) == NULL)
+            new_view = grid_row_wrap(term->grid, new_view + 1);
     }
 
-    else if (term->grid->rows[view_end] == NULL) {
-        while (term->grid->rows[view_end] == NULL) {
-            new_view--;
-            if (new_view < 0)
-                new_view += term->grid->num_rows;
-            view_end = (new_view + term->rows - 1) & (term->grid->num_rows - 1);
+    else if (grid_ring_get(term->grid, view_end) == NULL) {
+        while (grid_ring_get(term->grid, view_end) == NULL) {
+            new_view = grid_row_wrap(term->grid, new_view - 1);
+            view_end = grid_row_wrap(term->grid, new_view + term->rows - 1);
         }
     }
 
 #if defined(_DEBUG)
-    for (size_t r = 0; r < term->rows; r++)
-        xassert(term->grid->rows[(new_view + r) & (term->grid->num_rows - 1)] != NULL);
+    for (int r = 0; r < term->rows; r++)
+        xassert(grid_ring_get(term->grid, grid_row_wrap(term->grid, new_view + r)) != NULL);
 #endif
 
     return new_view;
@@ -81,9 +82,8 @@ search_ensure_size(struct terminal *term, size_t wanted_size)
 static bool
 has_wrapped_around(const struct terminal *term, int abs_row_no)
 {
-    int scrollback_start = term->grid->offset + term->rows;
-    int rebased_row = abs_row_no - scrollback_start + term->grid->num_rows;
-    rebased_row &= term->grid->num_rows - 1;
+    int scrollback_start = grid_row_absolute(term->grid, term->rows);
+    int rebased_row = grid_row_wrap(term->grid, abs_row_no - scrollback_start);
 
     return rebased_row == 0;
 }
@@ -162,7 +162,7 @@ search_update_selection(struct terminal *term,
 {
     bool move_viewport = true;
 
-    int view_end = (term->grid->view + term->rows - 1) & (term->grid->num_rows - 1);
+    int view_end = grid_row_absolute_in_view(term->grid, term->rows - 1);
     if (view_end >= term->grid->view) {
         /* Viewport does *not* wrap around */
         if (start_row >= term->grid->view && end_row <= view_end)
@@ -183,7 +183,7 @@ search_update_selection(struct terminal *term,
         new_view = ensure_view_is_allocated(term, new_view);
 
         /* Don't scroll past scrollback history */
-        int end = (term->grid->offset + term->rows - 1) & (term->grid->num_rows - 1);
+        int end = grid_row_absolute(term->grid, term->rows - 1);
         if (end >= term->grid->offset) {
             /* Not wrapped */
             if (new_view >= term->grid->offset && new_view <= end)
@@ -196,7 +196,7 @@ search_update_selection(struct terminal *term,
 #if defined(_DEBUG)
         /* Verify all to-be-visible rows have been allocated */
         for (int r = 0; r < term->rows; r++)
-            xassert(term->grid->rows[(new_view + r) & (term->grid->num_rows - 1)] != NULL);
+            xassert(grid_ring_get(term->grid, grid_row_wrap(term->grid, new_view + r)) != NULL);
 #endif
 
         /* Update view */
@@ -305,24 +305,37 @@ search_find_next(struct terminal *term)
             backward ? "backward" : "forward", start_row, start_col,
             term->grid->offset, term->grid->view);
 
-#define ROW_DEC(_r) ((_r) = ((_r) - 1 + term->grid->num_rows) & (term->grid->num_rows - 1))
-#define ROW_INC(_r) ((_r) = ((_r) + 1) & (term->grid->num_rows - 1))
+#define ROW_DEC(_r) ((_r) = grid_row_wrap(term->grid, (_r) - 1))
+#define ROW_INC(_r) ((_r) = grid_row_wrap(term->grid, (_r) + 1))
+
+    /*
+     * Compressed (scrollback) rows are decoded into these, instead of
+     * being decompressed, since we may be scanning all of them
+     */
+    struct cell start_buf[term->grid->num_cols];
+    struct cell end_buf[term->grid->num_cols];
+
+    size_t scan_rows = term->grid->num_rows;
 
+again:
     /* Scan backward from current end-of-output */
     /* TODO: don't search "scrollback" in alt screen? */
     for (size_t r = 0;
-         r < term->grid->num_rows;
+         r < scan_rows;
          backward ? ROW_DEC(start_row) : ROW_INC(start_row), r++)
     {
+        const struct row *start = grid_ring_get(term->grid, start_row);
+        const struct cell *start_cells =
+            start != NULL ? grid_row_cells(start, start_buf) : NULL;
+
         for (;
              backward ? start_col >= 0 : start_col < term->cols;
              backward ? start_col-- : start_col++)
         {
-            const struct row *row = term->grid->rows[start_row];
-            if (row == NULL)
+            if (start_cells == NULL)
                 continue;
 
-            if (matches_cell(term, &row->cells[start_col], 0) < 0)
+            if (matches_cell(term, &start_cells[start_col], 0) < 0)
                 continue;
 
             /*
@@ -335,24 +348,25 @@ search_find_next(struct terminal *term)
             int end_row = start_row;
             int end_col = start_col;
             size_t match_len = 0;
+            const struct cell *cells = start_cells;
 
             for (size_t i = 0; i < term->search.len;) {
                 if (end_col >= term->cols) {
-                    end_row = (end_row + 1) & (term->grid->num_rows - 1);
+                    end_row = grid_row_wrap(term->grid, end_row + 1);
                     end_col = 0;
 
                     if (has_wrapped_around(term, end_row))
                         break;
 
-                    row = term->grid->rows[end_row];
+                    cells = grid_row_cells(grid_ring_get(term->grid, end_row), end_buf);
                 }
 
-                if (row->cells[end_col].wc >= CELL_SPACER) {
+                if (cells[end_col].wc >= CELL_SPACER) {
                     end_col++;
                     continue;
                 }
 
-                ssize_t additional_chars = matches_cell(term, &row->cells[end_col], i);
+                ssize_t additional_chars = matches_cell(term, &cells[end_col], i);
                 if (additional_chars < 0)
                     break;
 
@@ -383,6 +397,19 @@ search_find_next(struct terminal *term)
         start_col = backward ? term->cols - 1 : 0;
     }
 
+    if (backward && term->conf->scrollback.spill) {
+        /* Continue with (a chunk of) the spilled lines, newest first */
+        int first_row;
+        const int count = term_spill_page_in(term, SEARCH_SPILL_CHUNK, &first_row);
+
+        if (count > 0) {
+            start_row = grid_row_wrap(term->grid, first_row + count - 1);
+            start_col = term->cols - 1;
+            scan_rows = count;
+            goto again;
+        }
+    }
+
     /* No match */
     LOG_DBG("no match");
     term->search.match = (struct coord){-1, -1};
@@ -450,9 +477,9 @@ search_match_to_end_of_word(struct terminal *term, bool spaces_only)
         ({                                                              \
             bool wrapped_around = false;                                \
             if (++(coord).col >= term->cols) {                           \
-                (coord).row = ((coord).row + 1) & (term->grid->num_rows - 1); \
+                (coord).row = grid_row_wrap(term->grid, (coord).row + 1); \
                 (coord).col = 0;                                        \
-                row = term->grid->rows[(coord).row];                    \
+                row = grid_row_at(term->grid, (coord).row);             \
                 if (has_wrapped_around(term, (coord.row)))              \
                     wrapped_around = true;                              \
             }                                                           \
@@ -463,7 +490,7 @@ search_match_to_end_of_word(struct terminal *term, bool spaces_only)
     if (newline(new_end))
         return;
 
-    xassert(term->grid->rows[new_end.row] != NULL);
+    xassert(grid_ring_get(term->grid, new_end.row) != NULL);
 
     /* Find next word boundary */
     new_end.row -= term->grid->view;
@@ -471,7 +498,7 @@ search_match_to_end_of_word(struct terminal *term, bool spaces_only)
     new_end.row += term->grid->view;
 
     struct coord pos = old_end;
-    row = term->grid->rows[pos.row];
+    row = grid_row_at(term->grid, pos.row);
 
     struct extraction_context *ctx = extract_begin(SELECTION_NONE, false);
     if (ctx == NULL)
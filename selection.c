@@ -100,9 +100,9 @@ selection_view_down(struct terminal *term, int new_view)
     if (likely(new_view > term->grid->view))
         return;
 
-    term->selection.start.row &= term->grid->num_rows - 1;
+    term->selection.start.row = grid_row_wrap(term->grid, term->selection.start.row);
     if (term->selection.end.row >= 0)
-        term->selection.end.row &= term->grid->num_rows - 1;
+        term->selection.end.row = grid_row_wrap(term->grid, term->selection.end.row);
 }
 
 static void
@@ -134,8 +134,8 @@ foreach_selected_normal(
     }
 
     for (int r = start_row; r <= end_row; r++) {
-        size_t real_r = r & (term->grid->num_rows - 1);
-        struct row *row = term->grid->rows[real_r];
+        size_t real_r = grid_row_wrap(term->grid, r);
+        struct row *row = grid_row_at(term->grid, real_r);
         xassert(row != NULL);
 
         for (int c = start_col;
@@ -170,8 +170,8 @@ foreach_selected_block(
     };
 
     for (int r = top_left.row; r <= bottom_right.row; r++) {
-        size_t real_r = r & (term->grid->num_rows - 1);
-        struct row *row = term->grid->rows[real_r];
+        size_t real_r = grid_row_wrap(term->grid, r);
+        struct row *row = grid_row_at(term->grid, real_r);
         xassert(row != NULL);
 
         for (int c = top_left.col; c <= bottom_right.col; c++) {
@@ -571,7 +571,7 @@ set_pivot_point_for_block_and_char_wise(struct terminal *term,
     /* First, make sure ‘start’ isn’t in the middle of a
      * multi-column character */
     while (true) {
-        const struct row *row = term->grid->rows[pivot_start->row & (term->grid->num_rows - 1)];
+        const struct row *row = grid_row_at(term->grid, grid_row_wrap(term->grid, pivot_start->row));
         const struct cell *cell = &row->cells[pivot_start->col];
 
         if (cell->wc < CELL_SPACER)
@@ -596,7 +596,7 @@ set_pivot_point_for_block_and_char_wise(struct terminal *term,
     if (new_direction == SELECTION_RIGHT) {
         bool keep_going = true;
         while (keep_going) {
-            const struct row *row = term->grid->rows[pivot_end->row & (term->grid->num_rows - 1)];
+            const struct row *row = grid_row_at(term->grid, grid_row_wrap(term->grid, pivot_end->row));
             const wchar_t wc = row->cells[pivot_end->col].wc;
 
             keep_going = wc >= CELL_SPACER;
@@ -612,7 +612,7 @@ set_pivot_point_for_block_and_char_wise(struct terminal *term,
     } else {
         bool keep_going = true;
         while (keep_going) {
-            const struct row *row = term->grid->rows[pivot_start->row & (term->grid->num_rows - 1)];
+            const struct row *row = grid_row_at(term->grid, grid_row_wrap(term->grid, pivot_start->row));
             const wchar_t wc = pivot_start->col < term->cols - 1
                 ? row->cells[pivot_start->col + 1].wc : 0;
 
@@ -628,9 +628,9 @@ set_pivot_point_for_block_and_char_wise(struct terminal *term,
         }
     }
 
-    xassert(term->grid->rows[pivot_start->row & (term->grid->num_rows - 1)]->
+    xassert(grid_row_at(term->grid, grid_row_wrap(term->grid, pivot_start->row))->
            cells[pivot_start->col].wc <= CELL_SPACER);
-    xassert(term->grid->rows[pivot_end->row & (term->grid->num_rows - 1)]->
+    xassert(grid_row_at(term->grid, grid_row_wrap(term->grid, pivot_end->row))->
            cells[pivot_end->col].wc <= CELL_SPACER + 1);
 }
 
@@ -753,11 +753,11 @@ selection_update(struct terminal *term, int col, int row)
         break;
     }
 
-    size_t start_row_idx = new_start.row & (term->grid->num_rows - 1);
-    size_t end_row_idx = new_end.row & (term->grid->num_rows - 1);
+    size_t start_row_idx = grid_row_wrap(term->grid, new_start.row);
+    size_t end_row_idx = grid_row_wrap(term->grid, new_end.row);
 
-    const struct row *row_start = term->grid->rows[start_row_idx];
-    const struct row *row_end = term->grid->rows[end_row_idx];
+    const struct row *row_start = grid_row_at(term->grid, start_row_idx);
+    const struct row *row_end = grid_row_at(term->grid, end_row_idx);
 
     /* If an end point is in the middle of a multi-column character,
      * expand the selection to cover the entire character */
@@ -1127,37 +1127,22 @@ selection_primary_unset(struct seat *seat)
 }
 
 static bool
-fdm_scroll_timer(struct fdm *fdm, int fd, int events, void *data)
+fdm_scroll_timer(struct fdm *fdm, struct fdm_timer *timer,
+                 uint64_t expirations, void *data)
 {
-    if (events & EPOLLHUP)
-        return false;
-
     struct terminal *term = data;
 
-    uint64_t expiration_count;
-    ssize_t ret = read(
-        term->selection.auto_scroll.fd,
-        &expiration_count, sizeof(expiration_count));
-
-    if (ret < 0) {
-        if (errno == EAGAIN)
-            return true;
-
-        LOG_ERRNO("failed to read selection scroll timer");
-        return false;
-    }
-
     switch (term->selection.auto_scroll.direction) {
     case SELECTION_SCROLL_NOT:
         return true;
 
     case SELECTION_SCROLL_UP:
-        cmd_scrollback_up(term, expiration_count);
+        cmd_scrollback_up(term, expirations);
         selection_update(term, term->selection.auto_scroll.col, 0);
         break;
 
     case SELECTION_SCROLL_DOWN:
-        cmd_scrollback_down(term, expiration_count);
+        cmd_scrollback_down(term, expirations);
         selection_update(term, term->selection.auto_scroll.col, term->rows - 1);
         break;
     }
@@ -1175,35 +1160,20 @@ selection_start_scroll_timer(struct terminal *term, int interval_ns,
     if (!term->selection.ongoing)
         return;
 
-    if (term->selection.auto_scroll.fd < 0) {
-        int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
-        if (fd < 0) {
-            LOG_ERRNO("failed to create selection scroll timer");
-            goto err;
-        }
-
-        if (!fdm_add(term->fdm, fd, EPOLLIN, &fdm_scroll_timer, term)) {
-            close(fd);
-            return;
-        }
-
-        term->selection.auto_scroll.fd = fd;
+    if (term->selection.auto_scroll.timer == NULL) {
+        term->selection.auto_scroll.timer = fdm_timer_add(
+            term->fdm, &fdm_scroll_timer, term);
     }
 
-    struct itimerspec timer;
-    if (timerfd_gettime(term->selection.auto_scroll.fd, &timer) < 0) {
-        LOG_ERRNO("failed to get current selection scroll timer value");
-        goto err;
-    }
-
-    if (timer.it_value.tv_sec == 0 && timer.it_value.tv_nsec == 0)
-        timer.it_value.tv_nsec = 1;
+    /* Keep the current expiry, if armed; only update the interval */
+    uint64_t value_ns = fdm_timer_remaining(term->selection.auto_scroll.timer);
+    if (value_ns == 0)
+        value_ns = 1;
 
-    timer.it_interval.tv_sec = interval_ns / 1000000000;
-    timer.it_interval.tv_nsec = interval_ns % 1000000000;
-
-    if (timerfd_settime(term->selection.auto_scroll.fd, 0, &timer, NULL) < 0) {
-        LOG_ERRNO("failed to set new selection scroll timer value");
+    if (!fdm_timer_set(term->fdm, term->selection.auto_scroll.timer,
+                       value_ns, interval_ns))
+    {
+        LOG_ERR("failed to set new selection scroll timer value");
         goto err;
     }
 
@@ -1219,13 +1189,13 @@ err:
 void
 selection_stop_scroll_timer(struct terminal *term)
 {
-    if (term->selection.auto_scroll.fd < 0) {
+    if (term->selection.auto_scroll.timer == NULL) {
         xassert(term->selection.auto_scroll.direction == SELECTION_SCROLL_NOT);
         return;
     }
 
-    fdm_del(term->fdm, term->selection.auto_scroll.fd);
-    term->selection.auto_scroll.fd = -1;
+    fdm_timer_del(term->fdm, term->selection.auto_scroll.timer);
+    term->selection.auto_scroll.timer = NULL;
     term->selection.auto_scroll.direction = SELECTION_SCROLL_NOT;
 }
 
@@ -103,7 +103,6 @@ buffer_destroy(struct buffer *buf)
     buf->pool = NULL;
     buf->fd = -1;
 
-    free(buf->scroll_damage);
     pixman_region32_fini(&buf->dirty);
 }
 
@@ -237,7 +236,11 @@ shm_get_buffer(struct wl_shm *shm, int width, int height, unsigned long cookie,
         if (it->item.cookie != cookie)
             continue;
 
-        if (it->item.busy)
+        /*
+         * Every other buffer ages, including idle ones we don't pick;
+         * the renderer uses the age to tell which frames it has missed
+         */
+        if (it->item.busy || cached != NULL)
             it->item.age++;
         else
 #if FORCED_DOUBLE_BUFFERING
@@ -251,8 +254,6 @@ shm_get_buffer(struct wl_shm *shm, int width, int height, unsigned long cookie,
                 it->item.busy = true;
                 it->item.purge = false;
                 pixman_region32_clear(&it->item.dirty);
-                free(it->item.scroll_damage);
-                it->item.scroll_damage = NULL;
                 xassert(it->item.pix_instances == pix_instances);
                 cached = &it->item;
             }
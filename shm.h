@@ -35,10 +35,8 @@ struct buffer {
     bool scrollable;
     bool purge;            /* True if this buffer should be destroyed */
 
-    unsigned age;
-    struct damage *scroll_damage;
-    size_t scroll_damage_count;
-    pixman_region32_t dirty;
+    unsigned age;          /* Frames rendered since this buffer was rendered to */
+    pixman_region32_t dirty;  /* Pixels changed by this buffer's frame */
 };
 
 struct buffer *shm_get_buffer(
@@ -7,6 +7,7 @@
 #define LOG_ENABLE_DBG 0
 #include "log.h"
 #include "debug.h"
+#include "grid.h"
 #include "render.h"
 #include "hsl.h"
 #include "util.h"
@@ -110,14 +111,19 @@ static void
 sixel_erase(struct terminal *term, struct sixel *sixel)
 {
     for (int i = 0; i < sixel->rows; i++) {
-        int r = (sixel->pos.row + i) & (term->grid->num_rows - 1);
+        int r = grid_row_wrap(term->grid, sixel->pos.row + i);
 
-        struct row *row = term->grid->rows[r];
+        struct row *row = grid_ring_get(term->grid, r);
         if (row == NULL) {
             /* A resize/reflow may cause row to now be unallocated */
             continue;
         }
 
+        if (row->cells == NULL) {
+            /* Compressed; will be fully dirtied when decompressed */
+            continue;
+        }
+
         row->dirty = true;
 
         for (int c = sixel->pos.col; c < min(sixel->cols, term->cols); c++)
@@ -139,11 +145,8 @@ sixel_erase(struct terminal *term, struct sixel *sixel)
 static int
 rebase_row(const struct terminal *term, int abs_row)
 {
-    int scrollback_start = term->grid->offset + term->rows;
-    int rebased_row = abs_row - scrollback_start + term->grid->num_rows;
-
-    rebased_row &= term->grid->num_rows - 1;
-    return rebased_row;
+    int scrollback_start = grid_row_absolute(term->grid, term->rows);
+    return grid_row_wrap(term->grid, abs_row - scrollback_start);
 }
 
 /*
@@ -201,7 +204,7 @@ verify_no_wraparound_crossover(const struct terminal *term)
         xassert(six->pos.row >= 0);
         xassert(six->pos.row < term->grid->num_rows);
 
-        int end = (six->pos.row + six->rows - 1) & (term->grid->num_rows - 1);
+        int end = grid_row_wrap(term->grid, six->pos.row + six->rows - 1);
         xassert(end >= six->pos.row);
     }
 #endif
@@ -732,8 +735,8 @@ sixel_overwrite_by_rectangle(
     if (likely(tll_length(term->grid->sixel_images) == 0))
         return;
 
-    const int start = (term->grid->offset + row) & (term->grid->num_rows - 1);
-    const int end = (start + height - 1) & (term->grid->num_rows - 1);
+    const int start = grid_row_absolute(term->grid, row);
+    const int end = grid_row_wrap(term->grid, start + height - 1);
     const bool wraps = end < start;
 
     if (wraps) {
@@ -764,13 +767,13 @@ sixel_overwrite_by_row(struct terminal *term, int _row, int col, int width)
     if (col + width > term->grid->num_cols)
         width = term->grid->num_cols - col;
 
-    const int row = (term->grid->offset + _row) & (term->grid->num_rows - 1);
+    const int row = grid_row_absolute(term->grid, _row);
     const int scrollback_rel_row = rebase_row(term, row);
 
     tll_foreach(term->grid->sixel_images, it) {
         struct sixel *six = &it->item;
         const int six_start = six->pos.row;
-        const int six_end = (six_start + six->rows - 1) & (term->grid->num_rows - 1);
+        const int six_end = grid_row_wrap(term->grid, six_start + six->rows - 1);
 
         /* We should never generate scrollback wrapping sixels */
         xassert(six_end >= six_start);
@@ -853,7 +856,7 @@ sixel_reflow(struct terminal *term)
         tll_rforeach(copy, it) {
             struct sixel *six = &it->item;
             int start = six->pos.row;
-            int end = (start + six->rows - 1) & (grid->num_rows - 1);
+            int end = (start + six->rows - 1) % grid->num_rows;
 
             if (end < start) {
                 /* Crosses scrollback wrap-around */
@@ -981,7 +984,7 @@ sixel_unhook(struct terminal *term)
            rows_avail > 0 &&
            rows_needed <= term->grid->num_rows)
     {
-        const int cur_row = (term->grid->offset + start_row) & (term->grid->num_rows - 1);
+        const int cur_row = grid_row_absolute(term->grid, start_row);
         const int rows_left_until_wrap_around = term->grid->num_rows - cur_row;
         const int usable_rows = min(rows_avail, rows_left_until_wrap_around);
 
@@ -1028,7 +1031,7 @@ sixel_unhook(struct terminal *term)
 
         /* Dirty touched cells, and scroll terminal content if necessary */
         for (size_t i = 0; i < image.rows; i++) {
-            struct row *row = term->grid->rows[cur_row + i];
+            struct row *row = grid_row_at(term->grid, cur_row + i);
             row->dirty = true;
 
             for (int col = image.pos.col;
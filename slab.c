@@ -0,0 +1,151 @@
+#include "slab.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "debug.h"
+#include "macros.h"
+#include "util.h"
+#include "xmalloc.h"
+
+/* Target size of a chunk; very large blocks get at least MIN_BLOCKS */
+#define CHUNK_SIZE (64 * 1024)
+#define MIN_BLOCKS 8
+
+/*
+ * Each block is prefixed with a pointer to the chunk it was carved
+ * from. Free blocks are linked together through their first word.
+ */
+struct slab_chunk {
+    struct slab_chunk *prev;
+    struct slab_chunk *next;
+    void *free;         /* Freed blocks */
+    size_t used;        /* Blocks currently handed out */
+    size_t carved;      /* Blocks carved out of 'blocks' so far */
+    void *blocks[];
+};
+
+static void
+chunk_unlink(struct slab_chunk **list, struct slab_chunk *chunk)
+{
+    if (chunk->prev != NULL)
+        chunk->prev->next = chunk->next;
+    else
+        *list = chunk->next;
+
+    if (chunk->next != NULL)
+        chunk->next->prev = chunk->prev;
+}
+
+static void
+chunk_push(struct slab_chunk **list, struct slab_chunk *chunk)
+{
+    chunk->prev = NULL;
+    chunk->next = *list;
+
+    if (*list != NULL)
+        (*list)->prev = chunk;
+    *list = chunk;
+}
+
+static void
+chunks_free(struct slab_chunk *chunk)
+{
+    while (chunk != NULL) {
+        struct slab_chunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
+
+void
+slab_init(struct slab *slab, size_t size)
+{
+    /* Room for the chunk pointer, and the free list link */
+    size = max(size, sizeof(void *));
+    size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+
+    const size_t block_size = sizeof(struct slab_chunk *) + size;
+
+    *slab = (struct slab){
+        .block_size = block_size,
+        .blocks_per_chunk = max(MIN_BLOCKS, CHUNK_SIZE / block_size),
+    };
+}
+
+void
+slab_destroy(struct slab *slab)
+{
+    chunks_free(slab->partial);
+    chunks_free(slab->full);
+    slab->partial = slab->full = NULL;
+}
+
+void *
+slab_alloc(struct slab *slab)
+{
+    xassert(slab->block_size > 0);
+
+    struct slab_chunk *chunk = slab->partial;
+
+    if (unlikely(chunk == NULL)) {
+        chunk = xmalloc(
+            sizeof(*chunk) + slab->blocks_per_chunk * slab->block_size);
+        chunk->free = NULL;
+        chunk->used = 0;
+        chunk->carved = 0;
+        chunk_push(&slab->partial, chunk);
+    }
+
+    void *block;
+
+    if (chunk->free != NULL) {
+        block = chunk->free;
+        chunk->free = *(void **)block;
+    } else {
+        xassert(chunk->carved < slab->blocks_per_chunk);
+
+        struct slab_chunk **header = (struct slab_chunk **)(
+            (uint8_t *)chunk->blocks + chunk->carved++ * slab->block_size);
+
+        *header = chunk;
+        block = header + 1;
+    }
+
+    if (++chunk->used == slab->blocks_per_chunk) {
+        chunk_unlink(&slab->partial, chunk);
+        chunk_push(&slab->full, chunk);
+    }
+
+    return block;
+}
+
+void
+slab_free(struct slab *slab, void *ptr)
+{
+    if (ptr == NULL)
+        return;
+
+    struct slab_chunk *chunk = ((struct slab_chunk **)ptr)[-1];
+    xassert(chunk->used > 0);
+
+    if (chunk->used-- == slab->blocks_per_chunk) {
+        chunk_unlink(&slab->full, chunk);
+        chunk_push(&slab->partial, chunk);
+    }
+
+    if (chunk->used == 0) {
+        if (slab->partial != chunk || chunk->next != NULL) {
+            chunk_unlink(&slab->partial, chunk);
+            free(chunk);
+        } else {
+            /* Keep the last one, but carve it from the start again */
+            chunk->free = NULL;
+            chunk->carved = 0;
+        }
+        return;
+    }
+
+    *(void **)ptr = chunk->free;
+    chunk->free = ptr;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * Allocator for fixed size blocks, carved out of larger chunks.
+ *
+ * Freed blocks are re-used before new ones are carved, and a chunk
+ * is released once all of its blocks have been freed (except when it
+ * is the last chunk with free blocks). slab_destroy() releases
+ * everything at once, without having to free each block.
+ *
+ * Blocks are aligned to the size of a pointer. Not thread safe.
+ */
+struct slab_chunk;
+
+struct slab {
+    size_t block_size;
+    size_t blocks_per_chunk;
+    struct slab_chunk *partial;     /* Chunks with free blocks */
+    struct slab_chunk *full;        /* Chunks without free blocks */
+};
+
+void slab_init(struct slab *slab, size_t size);
+void slab_destroy(struct slab *slab);
+
+void *slab_alloc(struct slab *slab);
+void slab_free(struct slab *slab, void *ptr);
@@ -0,0 +1,464 @@
+#include "spill.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define LOG_MODULE "spill"
+#define LOG_ENABLE_DBG 0
+#include "log.h"
+#include "attrs.h"
+#include "composed.h"
+#include "debug.h"
+#include "macros.h"
+#include "terminal.h"
+#include "util.h"
+#include "xmalloc.h"
+
+#define SPILL_INDEX_STRIDE 64
+
+/* Encoded lines are written to the file in batches of (at least) this size */
+#define WRITE_BATCH_SIZE (64 * 1024)
+
+/*
+ * A spilled line. Like a compressed row (see grid.c), the attributes
+ * are stored as runs covering all columns, followed by the text, up
+ * to and including the last non-empty cell, as variable length
+ * integers. Unlike a compressed row, attributes and composed
+ * characters are stored by value; by the time the line is read back,
+ * the terminal may have dropped them from its tables.
+ *
+ * A composed character is stored as CELL_COMB_CHARS_LO, followed by
+ * the number of combining characters, the base character, and the
+ * combining characters.
+ */
+struct spill_run {
+    uint32_t count;
+    struct attributes attrs;
+};
+
+struct spill_line {
+    uint32_t size;          /* Total size, in bytes, including this header */
+    uint32_t cols;
+    uint32_t chars;         /* Number of cells with stored text */
+    uint32_t run_count;
+    uint32_t linebreak;
+    struct spill_run runs[];
+};
+
+/* Largest encoding of a single cell's text (a composed character) */
+#define MAX_CELL_SIZE (5 + 1 + 5 + 5 * 5)
+
+static uint8_t *
+put_varint(uint8_t *p, uint32_t v)
+{
+    while (v >= 0x80) {
+        *p++ = (v & 0x7f) | 0x80;
+        v >>= 7;
+    }
+    *p++ = v;
+    return p;
+}
+
+static uint32_t
+get_varint(const uint8_t **p)
+{
+    uint32_t v = 0;
+    for (int shift = 0; ; shift += 7) {
+        const uint8_t b = *(*p)++;
+        v |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            break;
+    }
+    return v;
+}
+
+static bool
+spill_open(struct spill *spill)
+{
+    const char *tmpdir = getenv("TMPDIR");
+    char *path = xasprintf(
+        "%s/foot-scrollback-XXXXXX",
+        tmpdir != NULL && tmpdir[0] != '\0' ? tmpdir : "/tmp");
+
+    int fd = mkostemp(path, O_CLOEXEC);
+    if (fd < 0) {
+        LOG_ERRNO("%s: failed to create scrollback spill file", path);
+        free(path);
+        spill->failed = true;
+        return false;
+    }
+
+    /*
+     * Unlinked right away; the file lives on until it is closed, by
+     * spill_reset(), or by foot exiting (even if it crashes)
+     */
+    unlink(path);
+    free(path);
+
+    spill->fd = fd;
+    spill->buf_size = 2 * WRITE_BATCH_SIZE;
+    spill->buf = xmalloc(spill->buf_size);
+    return true;
+}
+
+static bool
+flush(struct spill *spill)
+{
+    size_t ofs = 0;
+
+    while (ofs < spill->buf_len) {
+        ssize_t ret = pwrite(
+            spill->fd, &spill->buf[ofs], spill->buf_len - ofs,
+            spill->size + ofs);
+
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+
+            LOG_ERRNO("failed to write to the scrollback spill file");
+
+            /* Drop the lines that didn't make it, and stop spilling */
+            spill->count -= spill->buf_lines;
+            spill->buf_len = spill->buf_lines = 0;
+            spill->next_line = spill->next_ofs = 0;
+            spill->failed = true;
+            return false;
+        }
+
+        ofs += ret;
+    }
+
+    spill->size += spill->buf_len;
+    spill->buf_len = spill->buf_lines = 0;
+    return true;
+}
+
+void
+spill_line(struct terminal *term, const struct row *row,
+           const struct cell *cells, int cols)
+{
+    struct spill *spill = &term->spill;
+
+    if (unlikely(spill->failed))
+        return;
+    if (unlikely(spill->buf == NULL) && !spill_open(spill))
+        return;
+
+    int chars = cols;
+    while (chars > 0 && cells[chars - 1].wc == 0)
+        chars--;
+
+    const size_t max_size = sizeof(struct spill_line) +
+                            cols * sizeof(struct spill_run) +
+                            chars * MAX_CELL_SIZE + 3;
+
+    if (spill->buf_len + max_size > spill->buf_size) {
+        spill->buf_size = spill->buf_len + max_size;
+        spill->buf = xrealloc(spill->buf, spill->buf_size);
+    }
+
+    struct spill_line *line = (struct spill_line *)&spill->buf[spill->buf_len];
+    struct spill_run *runs = line->runs;
+    size_t run_count = 0;
+
+    for (int c = 0; c < cols; c++) {
+        if (c > 0 && cells[c].attrs.idx == cells[c - 1].attrs.idx) {
+            runs[run_count - 1].count++;
+            continue;
+        }
+
+        runs[run_count++] = (struct spill_run){
+            .count = 1,
+            .attrs = *attrs_of(term, &cells[c]),
+        };
+    }
+
+    uint8_t *p = (uint8_t *)&runs[run_count];
+
+    for (int c = 0; c < chars; c++) {
+        const wchar_t wc = cells[c].wc;
+
+        if (wc >= CELL_COMB_CHARS_LO &&
+            wc < CELL_COMB_CHARS_LO + term->composed_count)
+        {
+            const struct composed *cc = &term->composed[wc - CELL_COMB_CHARS_LO];
+
+            p = put_varint(p, CELL_COMB_CHARS_LO);
+            p = put_varint(p, cc->count);
+            p = put_varint(p, cc->base);
+            for (size_t i = 0; i < cc->count; i++)
+                p = put_varint(p, cc->combining[i]);
+        } else
+            p = put_varint(p, wc);
+    }
+
+    /* Keep the lines 4-byte aligned */
+    const size_t size = (p - (uint8_t *)line + 3) & ~(size_t)3;
+    xassert(size <= max_size);
+
+    *line = (struct spill_line){
+        .size = size,
+        .cols = cols,
+        .chars = chars,
+        .run_count = run_count,
+        .linebreak = row->linebreak,
+    };
+
+    if (spill->count % SPILL_INDEX_STRIDE == 0) {
+        const size_t idx = spill->count / SPILL_INDEX_STRIDE;
+
+        if (idx >= spill->index_size) {
+            spill->index_size = spill->index_size > 0
+                ? spill->index_size * 2 : 1024;
+            spill->index = xrealloc(
+                spill->index, spill->index_size * sizeof(spill->index[0]));
+        }
+
+        spill->index[idx] = spill->size + spill->buf_len;
+    }
+
+    spill->buf_len += size;
+    spill->buf_lines++;
+    spill->count++;
+
+    if (spill->buf_len >= WRITE_BATCH_SIZE)
+        flush(spill);
+}
+
+/* Maps (at least) everything written to the file */
+static bool
+map_file(struct spill *spill)
+{
+    if (spill->map_size >= spill->size)
+        return true;
+
+    const size_t page_size = sysconf(_SC_PAGE_SIZE);
+    size_t size = max(spill->size, spill->map_size * 2);
+    size = (size + page_size - 1) & ~(page_size - 1);
+
+    if (spill->map != NULL)
+        munmap(spill->map, spill->map_size);
+
+    /* Mapping past the end of the file is fine, as long as we don't touch it */
+    void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, spill->fd, 0);
+
+    if (map == MAP_FAILED) {
+        LOG_ERRNO("failed to mmap the scrollback spill file");
+        spill->map = NULL;
+        spill->map_size = 0;
+        return false;
+    }
+
+    spill->map = map;
+    spill->map_size = size;
+    return true;
+}
+
+static const struct spill_line *
+get_line(struct spill *spill, size_t line_no)
+{
+    xassert(line_no < spill->count);
+
+    if (spill->buf_len > 0 && !flush(spill))
+        return NULL;
+    if (line_no >= spill->count)
+        return NULL;
+    if (!map_file(spill))
+        return NULL;
+
+    /* Closest preceding index entry, or the line following the last one read */
+    size_t n = line_no / SPILL_INDEX_STRIDE * SPILL_INDEX_STRIDE;
+    size_t ofs = spill->index[line_no / SPILL_INDEX_STRIDE];
+
+    if (spill->next_line > n && spill->next_line <= line_no) {
+        n = spill->next_line;
+        ofs = spill->next_ofs;
+    }
+
+    for (; n < line_no; n++)
+        ofs += ((const struct spill_line *)&spill->map[ofs])->size;
+
+    const struct spill_line *line = (const struct spill_line *)&spill->map[ofs];
+    xassert(ofs + line->size <= spill->size);
+
+    spill->next_line = line_no + 1;
+    spill->next_ofs = ofs + line->size;
+    return line;
+}
+
+static void
+get_chain(const uint8_t **text, struct composed *cc)
+{
+    cc->count = get_varint(text);
+    cc->base = get_varint(text);
+    for (size_t i = 0; i < cc->count; i++)
+        cc->combining[i] = get_varint(text);
+}
+
+bool
+spill_read(struct terminal *term, size_t line_no, struct row *row, int cols)
+{
+    const struct spill_line *line = get_line(&term->spill, line_no);
+    if (line == NULL)
+        return false;
+
+    struct cell *cells = row->cells;
+    int c = 0;
+
+    for (uint32_t i = 0; i < line->run_count && c < cols; i++) {
+        const struct spill_run *run = &line->runs[i];
+        const uint32_t idx = attrs_get(term, &run->attrs);
+
+        for (uint32_t j = 0; j < run->count && c < cols; j++, c++)
+            cells[c].attrs = (struct cell_attrs){.idx = idx};
+    }
+
+    for (; c < cols; c++)
+        cells[c].attrs = (struct cell_attrs){.idx = ATTRS_DEFAULT};
+
+    const uint8_t *text = (const uint8_t *)&line->runs[line->run_count];
+
+    for (c = 0; c < (int)line->chars && c < cols; c++) {
+        wchar_t wc = get_varint(&text);
+
+        if (wc == CELL_COMB_CHARS_LO) {
+            struct composed cc;
+            get_chain(&text, &cc);
+
+            if (!composed_get(term, &cc, &wc))
+                wc = cc.base;
+        }
+
+        cells[c].wc = wc;
+    }
+
+    for (; c < cols; c++)
+        cells[c].wc = 0;
+
+    row->linebreak = line->linebreak;
+    row->dirty = true;
+    return true;
+}
+
+bool
+spill_read_text(struct terminal *term, size_t line_no, struct spill_text *text)
+{
+    const struct spill_line *line = get_line(&term->spill, line_no);
+    if (line == NULL)
+        return false;
+
+    const int cols = line->cols;
+
+    if (text->row == NULL)
+        text->row = xcalloc(1, sizeof(*text->row));
+
+    if (cols > text->size) {
+        text->row->cells = xrealloc(
+            text->row->cells, cols * sizeof(text->row->cells[0]));
+        text->chains = xrealloc(text->chains, cols * sizeof(text->chains[0]));
+        text->size = cols;
+    }
+
+    struct cell *cells = text->row->cells;
+    const uint8_t *p = (const uint8_t *)&line->runs[line->run_count];
+    int c = 0;
+
+    for (; c < (int)line->chars; c++) {
+        const wchar_t wc = get_varint(&p);
+
+        if (wc == CELL_COMB_CHARS_LO)
+            get_chain(&p, &text->chains[c]);
+
+        cells[c] = (struct cell){.wc = wc, .attrs = {.idx = ATTRS_DEFAULT}};
+    }
+
+    for (; c < cols; c++)
+        cells[c] = (struct cell){.attrs = {.idx = ATTRS_DEFAULT}};
+
+    text->row->linebreak = line->linebreak;
+    text->cols = cols;
+    return true;
+}
+
+void
+spill_text_free(struct spill_text *text)
+{
+    if (text->row != NULL)
+        free(text->row->cells);
+    free(text->row);
+    free(text->chains);
+}
+
+/* Drops all but the 'count' oldest lines */
+static void
+truncate_lines(struct spill *spill, size_t count)
+{
+    xassert(count < spill->count);
+
+    const struct spill_line *line = get_line(spill, count);
+    if (line == NULL) {
+        /* Keep what's readable, but stop spilling */
+        spill->count = min(spill->count, count);
+        spill->failed = true;
+        return;
+    }
+
+    /* Subsequent lines overwrite the dropped ones */
+    spill->size = (const uint8_t *)line - spill->map;
+    spill->count = count;
+    spill->next_line = spill->next_ofs = 0;
+
+    /*
+     * Give the dropped lines' space back (the file is typically on a
+     * tmpfs). The mapping is kept; nothing beyond 'size' is read
+     * until it has been written again.
+     */
+    if (ftruncate(spill->fd, spill->size) < 0)
+        LOG_ERRNO("failed to truncate the scrollback spill file");
+}
+
+void
+spill_unload(struct terminal *term)
+{
+    struct spill *spill = &term->spill;
+
+    if (spill->loaded == 0)
+        return;
+
+    const size_t count = spill->count - spill->loaded;
+    spill->loaded = 0;
+    truncate_lines(spill, count);
+}
+
+void
+spill_drop(struct terminal *term, size_t lines)
+{
+    struct spill *spill = &term->spill;
+    xassert(spill->loaded == 0);
+
+    lines = min(lines, spill->count);
+    if (lines == 0)
+        return;
+
+    truncate_lines(spill, spill->count - lines);
+}
+
+void
+spill_reset(struct terminal *term)
+{
+    struct spill *spill = &term->spill;
+
+    if (spill->map != NULL)
+        munmap(spill->map, spill->map_size);
+    if (spill->buf != NULL)
+        close(spill->fd);
+
+    free(spill->buf);
+    free(spill->index);
+
+    *spill = (struct spill){0};
+}
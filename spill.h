@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct terminal;
+struct row;
+struct cell;
+struct composed;
+
+/*
+ * Overflow scrollback (scrollback.spill). Lines evicted from the
+ * normal grid are appended to a temporary file, in a compact format,
+ * instead of being discarded. They are read back through a memory
+ * mapping of the file.
+ *
+ * Lines are numbered from zero (the oldest line ever evicted), and a
+ * sparse index maps every SPILL_INDEX_STRIDE:th line number to its
+ * file offset.
+ *
+ * Spilled lines can be paged back into the grid, above its oldest
+ * row (see term_spill_page_in()). Those rows are copies of the
+ * newest 'loaded' spilled lines.
+ *
+ * A zeroed struct is an empty spill; the file, and the write buffer,
+ * are created when the first line is spilled.
+ */
+struct spill {
+    int fd;                     /* Only valid when 'buf' is non-NULL */
+    bool failed;                /* Creating, or writing to, the file failed */
+
+    size_t size;                /* Bytes in the file */
+    size_t count;               /* Spilled lines */
+
+    size_t loaded;              /* Spilled lines paged back into the grid */
+    int grown;                  /* Ring slots added for paged in lines */
+
+    uint64_t *index;            /* File offset of every SPILL_INDEX_STRIDE:th line */
+    size_t index_size;
+
+    /* Encoded lines not yet written to the file */
+    uint8_t *buf;
+    size_t buf_len;
+    size_t buf_size;
+    size_t buf_lines;
+
+    uint8_t *map;
+    size_t map_size;
+
+    /* Line following the last one read, to speed up sequential reads */
+    size_t next_line;
+    size_t next_ofs;
+};
+
+/* Discards all spilled lines, and removes the file */
+void spill_reset(struct terminal *term);
+
+/* Appends a line, with the contents 'cells' (of 'cols' cells) */
+void spill_line(struct terminal *term, const struct row *row,
+                const struct cell *cells, int cols);
+
+/*
+ * Decodes line 'line' into 'row' (whose cells must be allocated), as
+ * a row 'cols' cells wide; wider lines are truncated
+ */
+bool spill_read(struct terminal *term, size_t line, struct row *row, int cols);
+
+/*
+ * A spilled line's text, for extraction. Unlike spill_read(), the line
+ * keeps the width it was spilled with, and nothing is interned: all
+ * cells have the default attributes, and composed characters are
+ * decoded into 'chains' (by column), with their cells set to
+ * CELL_COMB_CHARS_LO.
+ *
+ * A zeroed struct is empty; the buffers grow as needed.
+ */
+struct spill_text {
+    struct row *row;
+    int cols;
+    struct composed *chains;
+    int size;                   /* Allocated cells and chains */
+};
+
+bool spill_read_text(struct terminal *term, size_t line, struct spill_text *text);
+void spill_text_free(struct spill_text *text);
+
+/*
+ * Drops the paged in lines from the spill; the grid's copies become
+ * its only ones
+ */
+void spill_unload(struct terminal *term);
+
+/* Drops the 'lines' newest lines (there must be no paged in lines) */
+void spill_drop(struct terminal *term, size_t lines);
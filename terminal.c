@@ -7,14 +7,16 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <time.h>
 
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <sys/ioctl.h>
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
-#include <sys/timerfd.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
 #include <linux/input-event-codes.h>
 #include <xdg-shell.h>
 
@@ -23,6 +25,8 @@
 #include "log.h"
 
 #include "async.h"
+#include "attrs.h"
+#include "composed.h"
 #include "config.h"
 #include "debug.h"
 #include "extract.h"
@@ -106,8 +110,8 @@ term_paste_data_to_slave(struct terminal *term, const void *data, size_t len)
 {
     xassert(term->is_sending_paste_data);
 
-    if (term->ptmx < 0) {
-        /* We're probably in "hold" */
+    if (term->ptmx < 0 || term->parser.hup) {
+        /* We're probably in "hold", or the client has hung up */
         return false;
     }
 
@@ -125,8 +129,8 @@ term_paste_data_to_slave(struct terminal *term, const void *data, size_t len)
 bool
 term_to_slave(struct terminal *term, const void *data, size_t len)
 {
-    if (term->ptmx < 0) {
-        /* We're probably in "hold" */
+    if (term->ptmx < 0 || term->parser.hup) {
+        /* We're probably in "hold", or the client has hung up */
         return false;
     }
 
@@ -205,6 +209,27 @@ static struct timespec last = {0};
 
 static bool cursor_blink_rearm_timer(struct terminal *term);
 
+/*
+ * Max time spent reading and parsing PTY data, per terminal and FDM
+ * poll iteration. Whatever is left is deferred to the next iteration
+ * (the FD is level triggered), giving other terminals, and input
+ * handling and rendering, a chance to run in between.
+ *
+ * Small enough for a handful of busy terminals to fit in a single
+ * frame (at 60Hz).
+ */
+#define PTMX_READ_BUDGET_NS (2 * 1000000ull)
+
+static uint64_t
+monotonic_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void ptmx_data_parsed(struct fdm *fdm, struct terminal *term);
+
 /* Externally visible, but not declared in terminal.h, to enable pgo
  * to call this function directly */
 bool
@@ -221,19 +246,32 @@ fdm_ptmx(struct fdm *fdm, int fd, int events, void *data)
             return false;
     }
 
-    /* Prevent blinking while typing */
-    if (term->cursor_blink.fd >= 0) {
-        term->cursor_blink.state = CURSOR_BLINK_ON;
-        cursor_blink_rearm_timer(term);
+    if (hup && term->parser.running) {
+        /*
+         * The parser thread owns EOF and hangups, and tells us when
+         * it has read everything (see fdm_parser_done()). EPOLLHUP
+         * can't be masked, so stop watching the PTY until then.
+         */
+        fdm_del_no_close(fdm, fd);
+        term->parser.hup = true;
+        return true;
     }
 
     uint8_t buf[24 * 1024];
     ssize_t count = sizeof(buf);
 
-    const size_t max_iterations = !hup ? 10 : (size_t)-1ll;
+    const uint64_t start = monotonic_ns();
+    uint64_t now = start;
+    size_t total = 0;
+    bool drained = !pollin;
+
+    if (term->ptmx_stats.deferred_at != 0) {
+        term->ptmx_stats.max_wait_ns = max(
+            term->ptmx_stats.max_wait_ns, start - term->ptmx_stats.deferred_at);
+        term->ptmx_stats.deferred_at = 0;
+    }
 
-    for (size_t i = 0; i < max_iterations && pollin; i++) {
-        xassert(pollin);
+    while (pollin) {
         count = read(term->ptmx, buf, sizeof(buf));
 
         if (count < 0) {
@@ -242,6 +280,7 @@ fdm_ptmx(struct fdm *fdm, int fd, int events, void *data)
                  * EAGAIN: no more to read - FDM will trigger us again
                  * EIO: assume PTY was closed - we already have, or will get, a EPOLLHUP
                  */
+                drained = true;
                 break;
             }
 
@@ -249,10 +288,52 @@ fdm_ptmx(struct fdm *fdm, int fd, int events, void *data)
             return false;
         } else if (count == 0) {
             /* Reached end-of-file */
+            drained = true;
             break;
         }
 
         vt_from_slave(term, buf, count);
+        total += count;
+
+        now = monotonic_ns();
+        if (now - start >= PTMX_READ_BUDGET_NS) {
+            /* Out of budget; continue in the next FDM iteration */
+            term->ptmx_stats.deferred++;
+            term->ptmx_stats.deferred_at = now;
+            break;
+        }
+    }
+
+    if (total > 0) {
+        term->ptmx_stats.reads++;
+        term->ptmx_stats.bytes += total;
+        term->ptmx_stats.max_read_ns = max(
+            term->ptmx_stats.max_read_ns, now - start);
+    }
+
+    ptmx_data_parsed(fdm, term);
+
+    /* Don't close the PTY until we've read everything */
+    if (hup && drained) {
+        fdm_del(fdm, fd);
+        term->ptmx = -1;
+    }
+
+    return true;
+}
+
+/*
+ * Called after PTY data has been parsed (or, when the parser thread
+ * is running, the main thread has been notified of some other PTY
+ * event). Must be called with the FDM lock held.
+ */
+static void
+ptmx_data_parsed(struct fdm *fdm, struct terminal *term)
+{
+    /* Prevent blinking while typing */
+    if (term->cursor_blink.timer != NULL) {
+        term->cursor_blink.state = CURSOR_BLINK_ON;
+        cursor_blink_rearm_timer(term);
     }
 
     if (!term->render.app_sync_updates.enabled) {
@@ -306,53 +387,213 @@ fdm_ptmx(struct fdm *fdm, int fd, int events, void *data)
             xassert(upper_ns < 1000000000);
             xassert(upper_ns > lower_ns);
 
-            timerfd_settime(
-                term->delayed_render_timer.lower_fd, 0,
-                &(struct itimerspec){.it_value = {.tv_nsec = lower_ns}},
-                NULL);
+            fdm_timer_set(fdm, term->delayed_render_timer.lower, lower_ns, 0);
 
             /* Second timeout - only reset when we render. Set to one
              * frame (assuming 60Hz) */
             if (!term->delayed_render_timer.is_armed) {
-                timerfd_settime(
-                    term->delayed_render_timer.upper_fd, 0,
-                    &(struct itimerspec){.it_value = {.tv_nsec = upper_ns}},
-                    NULL);
+                fdm_timer_set(
+                    fdm, term->delayed_render_timer.upper, upper_ns, 0);
                 term->delayed_render_timer.is_armed = true;
             }
         } else
             render_refresh(term);
     }
+}
 
-    if (hup) {
-        fdm_del(fdm, fd);
-        term->ptmx = -1;
+/*
+ * Reads, and parses, one chunk of PTY data in the parser thread.
+ * Returns read()'s return value.
+ */
+static ssize_t
+parser_read(struct terminal *term, uint8_t *buf, size_t size)
+{
+    ssize_t count = read(term->parser.ptmx, buf, size);
+
+    if (count <= 0) {
+        /* EIO: assume PTY was closed */
+        if (count < 0 && errno != EAGAIN && errno != EIO)
+            LOG_ERRNO("parser thread: failed to read from pseudo terminal");
+        return count;
     }
 
-    return true;
+    fdm_lock(term->fdm);
+
+    vt_from_slave(term, buf, count);
+
+    term->ptmx_stats.reads++;
+    term->ptmx_stats.bytes += count;
+
+    ptmx_data_parsed(term->fdm, term);
+    fdm_wake(term->fdm);
+    fdm_unlock(term->fdm);
+    return count;
 }
 
+static int
+parser_thread(void *_term)
+{
+    struct terminal *term = _term;
+
+    /* Signals are handled by the main thread */
+    sigset_t mask;
+    sigfillset(&mask);
+    pthread_sigmask(SIG_SETMASK, &mask, NULL);
+
+    if (pthread_setname_np(pthread_self(), "foot:parser") < 0)
+        LOG_ERRNO("parser thread: failed to set process title");
+
+    struct pollfd fds[] = {
+        {.fd = term->parser.ptmx, .events = POLLIN},
+        {.fd = term->parser.quit_fd, .events = POLLIN},
+    };
+
+    uint8_t buf[24 * 1024];
+
+    while (true) {
+        if (poll(fds, ALEN(fds), -1) < 0) {
+            if (errno == EINTR)
+                continue;
+
+            LOG_ERRNO("parser thread: failed to poll");
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            /*
+             * Asked to quit. Parse what the client has already
+             * written before we do, but don't chase a client that
+             * keeps writing.
+             */
+            int queued = 0;
+            if (ioctl(term->parser.ptmx, FIONREAD, &queued) < 0)
+                queued = 0;
+
+            while (queued > 0) {
+                ssize_t count = parser_read(
+                    term, buf, min((size_t)queued, sizeof(buf)));
+                if (count <= 0)
+                    break;
+                queued -= count;
+            }
+
+            return 0;
+        }
+
+        ssize_t count = parser_read(term, buf, sizeof(buf));
+        if (count < 0 && errno == EAGAIN)
+            continue;
+        if (count <= 0)
+            break;
+    }
+
+    /* EOF, or error; let the main thread close the PTY */
+    if (write(term->parser.done_fd, &(uint64_t){1}, sizeof(uint64_t)) < 0)
+        LOG_ERRNO("parser thread: failed to signal main thread");
+
+    return 0;
+}
+
+static bool fdm_parser_done(struct fdm *fdm, int fd, int events, void *data);
+
 static bool
-fdm_flash(struct fdm *fdm, int fd, int events, void *data)
+parser_thread_start(struct terminal *term)
 {
-    if (events & EPOLLHUP)
+    int ptmx = fcntl(term->ptmx, F_DUPFD_CLOEXEC, 0);
+    if (ptmx < 0) {
+        LOG_ERRNO("failed to dup() PTY for the parser thread");
         return false;
+    }
 
-    struct terminal *term = data;
-    uint64_t expiration_count;
-    ssize_t ret = read(
-        term->flash.fd, &expiration_count, sizeof(expiration_count));
+    int quit_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    int done_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (quit_fd < 0 || done_fd < 0) {
+        LOG_ERRNO("failed to create parser thread event FDs");
+        if (quit_fd >= 0)
+            close(quit_fd);
+        if (done_fd >= 0)
+            close(done_fd);
+        close(ptmx);
+        return false;
+    }
+
+    if (!fdm_add(term->fdm, done_fd, EPOLLIN, &fdm_parser_done, term)) {
+        close(quit_fd);
+        close(done_fd);
+        close(ptmx);
+        return false;
+    }
 
-    if (ret < 0) {
-        if (errno == EAGAIN)
-            return true;
+    term->parser.ptmx = ptmx;
+    term->parser.quit_fd = quit_fd;
+    term->parser.done_fd = done_fd;
+    term->parser.hup = false;
 
-        LOG_ERRNO("failed to read flash timer");
+    int ret = thrd_create(&term->parser.thread, &parser_thread, term);
+    if (ret != thrd_success) {
+        LOG_ERR("failed to create parser thread: %s (%d)",
+                thrd_err_as_string(ret), ret);
+        fdm_del(term->fdm, done_fd);
+        close(quit_fd);
+        close(ptmx);
+        term->parser.ptmx = term->parser.quit_fd = term->parser.done_fd = -1;
         return false;
     }
 
+    term->parser.running = true;
+    return true;
+}
+
+/*
+ * Must be called with the FDM lock held (i.e. from the main
+ * thread). Data already written by the client is parsed before the
+ * thread exits.
+ */
+static void
+parser_thread_stop(struct terminal *term)
+{
+    if (!term->parser.running)
+        return;
+
+    if (write(term->parser.quit_fd, &(uint64_t){1}, sizeof(uint64_t)) < 0)
+        LOG_ERRNO("failed to signal parser thread to quit");
+
+    /* The parser thread needs the lock to parse */
+    fdm_unlock(term->fdm);
+    thrd_join(term->parser.thread, NULL);
+    fdm_lock(term->fdm);
+
+    fdm_del(term->fdm, term->parser.done_fd);
+    close(term->parser.quit_fd);
+    close(term->parser.ptmx);
+    term->parser.ptmx = term->parser.quit_fd = term->parser.done_fd = -1;
+    term->parser.running = false;
+}
+
+/* Parser thread has reached EOF, i.e. the client has hung up */
+static bool
+fdm_parser_done(struct fdm *fdm, int fd, int events, void *data)
+{
+    struct terminal *term = data;
+
+    parser_thread_stop(term);
+
+    if (term->parser.hup)
+        close(term->ptmx);
+    else
+        fdm_del(fdm, term->ptmx);
+    term->ptmx = -1;
+    return true;
+}
+
+static bool
+fdm_flash(struct fdm *fdm, struct fdm_timer *timer, uint64_t expirations,
+          void *data)
+{
+    struct terminal *term = data;
+
     LOG_DBG("flash timer expired %llu times",
-            (unsigned long long)expiration_count);
+            (unsigned long long)expirations);
 
     term->flash.active = false;
     term_damage_view(term);
@@ -361,26 +602,13 @@ fdm_flash(struct fdm *fdm, int fd, int events, void *data)
 }
 
 static bool
-fdm_blink(struct fdm *fdm, int fd, int events, void *data)
+fdm_blink(struct fdm *fdm, struct fdm_timer *timer, uint64_t expirations,
+          void *data)
 {
-    if (events & EPOLLHUP)
-        return false;
-
     struct terminal *term = data;
-    uint64_t expiration_count;
-    ssize_t ret = read(
-        term->blink.fd, &expiration_count, sizeof(expiration_count));
-
-    if (ret < 0) {
-        if (errno == EAGAIN)
-            return true;
-
-        LOG_ERRNO("failed to read blink timer");
-        return false;
-    }
 
     LOG_DBG("blink timer expired %llu times",
-            (unsigned long long)expiration_count);
+            (unsigned long long)expirations);
 
     /* Invert blink state */
     term->blink.state = term->blink.state == BLINK_ON
@@ -393,7 +621,7 @@ fdm_blink(struct fdm *fdm, int fd, int events, void *data)
         for (int col = 0; col < term->cols; col++) {
             struct cell *cell = &row->cells[col];
 
-            if (cell->attrs.blink) {
+            if (attrs_of(term, cell)->blink) {
                 cell->attrs.clean = 0;
                 row->dirty = true;
                 no_blinking_cells = false;
@@ -405,8 +633,8 @@ fdm_blink(struct fdm *fdm, int fd, int events, void *data)
         LOG_DBG("disarming blink timer");
 
         term->blink.state = BLINK_ON;
-        fdm_del(term->fdm, term->blink.fd);
-        term->blink.fd = -1;
+        fdm_timer_del(term->fdm, term->blink.timer);
+        term->blink.timer = NULL;
     } else
         render_refresh(term);
     return true;
@@ -415,33 +643,20 @@ fdm_blink(struct fdm *fdm, int fd, int events, void *data)
 void
 term_arm_blink_timer(struct terminal *term)
 {
-    if (term->blink.fd >= 0)
+    if (term->blink.timer != NULL)
         return;
 
     LOG_DBG("arming blink timer");
 
-    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
-    if (fd < 0) {
-        LOG_ERRNO("failed to create blink timer FD");
-        return;
-    }
+    struct fdm_timer *timer = fdm_timer_add(term->fdm, &fdm_blink, term);
 
-    if (!fdm_add(term->fdm, fd, EPOLLIN, &fdm_blink, term)) {
-        close(fd);
+    if (!fdm_timer_set(term->fdm, timer, 500 * 1000000, 500 * 1000000)) {
+        LOG_ERR("failed to arm blink timer");
+        fdm_timer_del(term->fdm, timer);
         return;
     }
 
-    struct itimerspec alarm = {
-        .it_value = {.tv_sec = 0, .tv_nsec = 500 * 1000000},
-        .it_interval = {.tv_sec = 0, .tv_nsec = 500 * 1000000},
-    };
-
-    if (timerfd_settime(fd, 0, &alarm, NULL) < 0) {
-        LOG_ERRNO("failed to arm blink timer");
-        fdm_del(term->fdm, fd);
-    }
-
-    term->blink.fd = fd;
+    term->blink.timer = timer;
 }
 
 static void
@@ -453,26 +668,13 @@ cursor_refresh(struct terminal *term)
 }
 
 static bool
-fdm_cursor_blink(struct fdm *fdm, int fd, int events, void *data)
+fdm_cursor_blink(struct fdm *fdm, struct fdm_timer *timer,
+                 uint64_t expirations, void *data)
 {
-    if (events & EPOLLHUP)
-        return false;
-
     struct terminal *term = data;
-    uint64_t expiration_count;
-    ssize_t ret = read(
-        term->cursor_blink.fd, &expiration_count, sizeof(expiration_count));
-
-    if (ret < 0) {
-        if (errno == EAGAIN)
-            return true;
-
-        LOG_ERRNO("failed to read cursor blink timer");
-        return false;
-    }
 
     LOG_DBG("cursor blink timer expired %llu times",
-            (unsigned long long)expiration_count);
+            (unsigned long long)expirations);
 
     /* Invert blink state */
     term->cursor_blink.state = term->cursor_blink.state == CURSOR_BLINK_ON
@@ -483,46 +685,23 @@ fdm_cursor_blink(struct fdm *fdm, int fd, int events, void *data)
 }
 
 static bool
-fdm_delayed_render(struct fdm *fdm, int fd, int events, void *data)
+fdm_delayed_render(struct fdm *fdm, struct fdm_timer *timer,
+                   uint64_t expirations, void *data)
 {
-    if (events & EPOLLHUP)
-        return false;
-
     struct terminal *term = data;
 
-    uint64_t unused;
-    ssize_t ret1 = 0;
-    ssize_t ret2 = 0;
-
-    if (fd == term->delayed_render_timer.lower_fd)
-        ret1 = read(term->delayed_render_timer.lower_fd, &unused, sizeof(unused));
-    if (fd == term->delayed_render_timer.upper_fd)
-        ret2 = read(term->delayed_render_timer.upper_fd, &unused, sizeof(unused));
-
-    if ((ret1 < 0 || ret2 < 0)) {
-        if (errno == EAGAIN)
-            return true;
-
-        LOG_ERRNO("failed to read timeout timer");
-        return false;
-    }
-
-    if (ret1 > 0)
+    if (timer == term->delayed_render_timer.lower)
         LOG_DBG("lower delay timer expired");
-    else if (ret2 > 0)
+    else if (timer == term->delayed_render_timer.upper)
         LOG_DBG("upper delay timer expired");
 
-    if (ret1 == 0 && ret2 == 0)
-        return true;
-
 #if PTMX_TIMING
     last = (struct timespec){0};
 #endif
 
     /* Reset timers */
-    struct itimerspec reset = {{0}};
-    timerfd_settime(term->delayed_render_timer.lower_fd, 0, &reset, NULL);
-    timerfd_settime(term->delayed_render_timer.upper_fd, 0, &reset, NULL);
+    fdm_timer_set(fdm, term->delayed_render_timer.lower, 0, 0);
+    fdm_timer_set(fdm, term->delayed_render_timer.upper, 0, 0);
     term->delayed_render_timer.is_armed = false;
 
     render_refresh(term);
@@ -531,23 +710,9 @@ fdm_delayed_render(struct fdm *fdm, int fd, int events, void *data)
 
 static bool
 fdm_app_sync_updates_timeout(
-    struct fdm *fdm, int fd, int events, void *data)
+    struct fdm *fdm, struct fdm_timer *timer, uint64_t expirations, void *data)
 {
-    if (events & EPOLLHUP)
-        return false;
-
     struct terminal *term = data;
-    uint64_t unused;
-    ssize_t ret = read(term->render.app_sync_updates.timer_fd,
-                       &unused, sizeof(unused));
-
-    if (ret < 0) {
-        if (errno == EAGAIN)
-            return true;
-        LOG_ERRNO("failed to read application synchronized updates timeout timer");
-        return false;
-    }
-
     term_disable_app_sync_updates(term);
     return true;
 }
@@ -557,47 +722,14 @@ initialize_render_workers(struct terminal *term)
 {
     LOG_INFO("using %zu rendering threads", term->render.workers.count);
 
-    if (sem_init(&term->render.workers.start, 0, 0) < 0 ||
-        sem_init(&term->render.workers.done, 0, 0) < 0)
-    {
-        LOG_ERRNO("failed to instantiate render worker semaphores");
-        return false;
-    }
-
     int err;
     if ((err = mtx_init(&term->render.workers.lock, mtx_plain)) != thrd_success) {
         LOG_ERR("failed to instantiate render worker mutex: %s (%d)",
                 thrd_err_as_string(err), err);
-        goto err_sem_destroy;
-    }
-
-    term->render.workers.threads = xcalloc(
-        term->render.workers.count, sizeof(term->render.workers.threads[0]));
-
-    for (size_t i = 0; i < term->render.workers.count; i++) {
-        struct render_worker_context *ctx = xmalloc(sizeof(*ctx));
-        *ctx = (struct render_worker_context) {
-            .term = term,
-            .my_id = 1 + i,
-        };
-
-        int ret = thrd_create(
-            &term->render.workers.threads[i], &render_worker_thread, ctx);
-        if (ret != thrd_success) {
-
-            LOG_ERR("failed to create render worker thread: %s (%d)",
-                    thrd_err_as_string(ret), ret);
-            term->render.workers.threads[i] = 0;
-            return false;
-        }
+        return false;
     }
 
     return true;
-
-err_sem_destroy:
-    sem_destroy(&term->render.workers.start);
-    sem_destroy(&term->render.workers.done);
-    return false;
 }
 
 int
@@ -634,6 +766,9 @@ term_set_fonts(struct terminal *term, struct fcft_font *fonts[static 4])
     for (size_t i = 0; i < ALEN(term->box_drawing); i++)
         free_box_drawing(&term->box_drawing[i]);
 
+    /* Glyph caches are keyed on the (now freed) glyph pointers */
+    render_glyph_caches_invalidate();
+
     const int old_cell_width = term->cell_width;
     const int old_cell_height = term->cell_height;
 
@@ -969,10 +1104,6 @@ term_init(const struct config *conf, struct fdm *fdm, struct reaper *reaper,
           void (*shutdown_cb)(void *data, int exit_code), void *shutdown_data)
 {
     int ptmx = -1;
-    int flash_fd = -1;
-    int delay_lower_fd = -1;
-    int delay_upper_fd = -1;
-    int app_sync_updates_fd = -1;
 
     struct terminal *term = malloc(sizeof(*term));
     if (unlikely(term == NULL)) {
@@ -984,22 +1115,6 @@ term_init(const struct config *conf, struct fdm *fdm, struct reaper *reaper,
         LOG_ERRNO("failed to open PTY");
         goto close_fds;
     }
-    if ((flash_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)) == -1) {
-        LOG_ERRNO("failed to create flash timer FD");
-        goto close_fds;
-    }
-    if ((delay_lower_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)) == -1 ||
-        (delay_upper_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)) == -1)
-    {
-        LOG_ERRNO("failed to create delayed rendering timer FDs");
-        goto close_fds;
-    }
-
-    if ((app_sync_updates_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)) == -1)
-    {
-        LOG_ERRNO("failed to create application synchronized updates timer FD");
-        goto close_fds;
-    }
 
     if (ioctl(ptmx, (unsigned int)TIOCSWINSZ,
               &(struct winsize){.ws_row = 24, .ws_col = 80}) < 0)
@@ -1017,25 +1132,18 @@ term_init(const struct config *conf, struct fdm *fdm, struct reaper *reaper,
     }
 
     /*
-     * Enable all FDM callbackes *except* ptmx - we can't do that
-     * until the window has been 'configured' since we don't have a
-     * size (and thus no grid) before then.
+     * Note: the ptmx FDM callback isn't enabled until the window has
+     * been 'configured', since we don't have a size (and thus no
+     * grid) before then.
      */
 
-    if (!fdm_add(fdm, flash_fd, EPOLLIN, &fdm_flash, term) ||
-        !fdm_add(fdm, delay_lower_fd, EPOLLIN, &fdm_delayed_render, term) ||
-        !fdm_add(fdm, delay_upper_fd, EPOLLIN, &fdm_delayed_render, term) ||
-        !fdm_add(fdm, app_sync_updates_fd, EPOLLIN, &fdm_app_sync_updates_timeout, term))
-    {
-        goto err;
-    }
-
     /* Initialize configure-based terminal attributes */
     *term = (struct terminal) {
         .fdm = fdm,
         .reaper = reaper,
         .conf = conf,
         .ptmx = ptmx,
+        .parser = {.ptmx = -1, .quit_fd = -1, .done_fd = -1},
         .ptmx_buffers = tll_init(),
         .ptmx_paste_buffers = tll_init(),
         .font_sizes = {
@@ -1054,8 +1162,7 @@ term_init(const struct config *conf, struct fdm *fdm, struct reaper *reaper,
         .auto_margin = true,
         .window_title_stack = tll_init(),
         .scale = 1,
-        .flash = {.fd = flash_fd},
-        .blink = {.fd = -1},
+        .flash = {.timer = fdm_timer_add(fdm, &fdm_flash, term)},
         .vt = {
             .state = 0,  /* STATE_GROUND */
             .osc8 = {
@@ -1076,7 +1183,6 @@ term_init(const struct config *conf, struct fdm *fdm, struct reaper *reaper,
             .decset = false,
             .deccsusr = conf->cursor.blink,
             .state = CURSOR_BLINK_ON,
-            .fd = -1,
         },
         .cursor_color = {
             .text = conf->cursor.color.text,
@@ -1085,9 +1191,6 @@ term_init(const struct config *conf, struct fdm *fdm, struct reaper *reaper,
         .selection = {
             .start = {-1, -1},
             .end = {-1, -1},
-            .auto_scroll = {
-                .fd = -1,
-            },
         },
         .normal = {.scroll_damage = tll_init(), .sixel_images = tll_init()},
         .alt = {.scroll_damage = tll_init(), .sixel_images = tll_init()},
@@ -1105,17 +1208,17 @@ term_init(const struct config *conf, struct fdm *fdm, struct reaper *reaper,
         .wl = wayl,
         .render = {
             .scrollback_lines = conf->scrollback.lines,
-            .app_sync_updates.timer_fd = app_sync_updates_fd,
+            .app_sync_updates.timer = fdm_timer_add(
+                fdm, &fdm_app_sync_updates_timeout, term),
             .workers = {
                 .count = conf->render_worker_count,
-                .queue = tll_init(),
             },
             .presentation_timings = conf->presentation_timings,
         },
         .delayed_render_timer = {
             .is_armed = false,
-            .lower_fd = delay_lower_fd,
-            .upper_fd = delay_upper_fd,
+            .lower = fdm_timer_add(fdm, &fdm_delayed_render, term),
+            .upper = fdm_timer_add(fdm, &fdm_delayed_render, term),
         },
         .sixel = {
             .scrolling = true,
@@ -1134,6 +1237,7 @@ term_init(const struct config *conf, struct fdm *fdm, struct reaper *reaper,
     };
 
    term_update_ascii_printer(term);
+    attrs_init(term);
 
     for (size_t i = 0; i < 4; i++) {
         size_t j = 0;
@@ -1205,10 +1309,6 @@ err:
 
 close_fds:
     close(ptmx);
-    fdm_del(fdm, flash_fd);
-    fdm_del(fdm, delay_lower_fd);
-    fdm_del(fdm, delay_upper_fd);
-    fdm_del(fdm, app_sync_updates_fd);
 
     free(term);
     return NULL;
@@ -1220,7 +1320,12 @@ term_window_configured(struct terminal *term)
     /* Enable ptmx FDM callback */
     if (!term->is_shutting_down) {
         xassert(term->window->is_configured);
-        fdm_add(term->fdm, term->ptmx, EPOLLIN, &fdm_ptmx, term);
+
+        if (term->conf->tweak.parser_thread && parser_thread_start(term)) {
+            /* Main thread only deals with writes */
+            fdm_add(term->fdm, term->ptmx, 0, &fdm_ptmx, term);
+        } else if (fdm_add(term->fdm, term->ptmx, EPOLLIN, &fdm_ptmx, term))
+            fdm_set_low_priority(term->fdm, term->ptmx);
     }
 }
 
@@ -1276,30 +1381,34 @@ term_shutdown(struct terminal *term)
      * iteration, by creating an event FD that we trigger immediately.
      */
 
+    parser_thread_stop(term);
+
     term_cursor_blink_update(term);
-    xassert(term->cursor_blink.fd < 0);
+    xassert(term->cursor_blink.timer == NULL);
 
-    fdm_del(term->fdm, term->selection.auto_scroll.fd);
-    fdm_del(term->fdm, term->render.app_sync_updates.timer_fd);
-    fdm_del(term->fdm, term->delayed_render_timer.lower_fd);
-    fdm_del(term->fdm, term->delayed_render_timer.upper_fd);
-    fdm_del(term->fdm, term->blink.fd);
-    fdm_del(term->fdm, term->flash.fd);
+    fdm_timer_del(term->fdm, term->selection.auto_scroll.timer);
+    fdm_timer_del(term->fdm, term->render.app_sync_updates.timer);
+    fdm_timer_del(term->fdm, term->delayed_render_timer.lower);
+    fdm_timer_del(term->fdm, term->delayed_render_timer.upper);
+    fdm_timer_del(term->fdm, term->blink.timer);
+    fdm_timer_del(term->fdm, term->flash.timer);
 
     /* We’ll deal with this explicitly */
     reaper_del(term->reaper, term->slave);
 
-    if (term->window != NULL && term->window->is_configured)
+    if (term->window != NULL && term->window->is_configured &&
+        !term->parser.hup)
+    {
         fdm_del(term->fdm, term->ptmx);
-    else
+    } else
         close(term->ptmx);
 
-    term->selection.auto_scroll.fd = -1;
-    term->render.app_sync_updates.timer_fd = -1;
-    term->delayed_render_timer.lower_fd = -1;
-    term->delayed_render_timer.upper_fd = -1;
-    term->blink.fd = -1;
-    term->flash.fd = -1;
+    term->selection.auto_scroll.timer = NULL;
+    term->render.app_sync_updates.timer = NULL;
+    term->delayed_render_timer.lower = NULL;
+    term->delayed_render_timer.upper = NULL;
+    term->blink.timer = NULL;
+    term->flash.timer = NULL;
     term->ptmx = -1;
 
     int event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
@@ -1344,45 +1453,44 @@ term_destroy(struct terminal *term)
         }
     }
 
-    fdm_del(term->fdm, term->selection.auto_scroll.fd);
-    fdm_del(term->fdm, term->render.app_sync_updates.timer_fd);
-    fdm_del(term->fdm, term->delayed_render_timer.lower_fd);
-    fdm_del(term->fdm, term->delayed_render_timer.upper_fd);
-    fdm_del(term->fdm, term->cursor_blink.fd);
-    fdm_del(term->fdm, term->blink.fd);
-    fdm_del(term->fdm, term->flash.fd);
-    fdm_del(term->fdm, term->ptmx);
+    parser_thread_stop(term);
 
-    if (term->window != NULL) {
-        wayl_win_destroy(term->window);
-        term->window = NULL;
+    if (term->ptmx_stats.deferred > 0) {
+        LOG_INFO(
+            "PTY: %llu bytes in %llu reads, %llu deferred; "
+            "longest read: %llu µs, longest wait: %llu µs",
+            (unsigned long long)term->ptmx_stats.bytes,
+            (unsigned long long)term->ptmx_stats.reads,
+            (unsigned long long)term->ptmx_stats.deferred,
+            (unsigned long long)term->ptmx_stats.max_read_ns / 1000,
+            (unsigned long long)term->ptmx_stats.max_wait_ns / 1000);
     }
 
-    mtx_lock(&term->render.workers.lock);
-    xassert(tll_length(term->render.workers.queue) == 0);
-
-    /* Count livinig threads - we may get here when only some of the
-     * threads have been successfully started */
-    size_t worker_count = 0;
-    if (term->render.workers.threads != NULL) {
-        for (size_t i = 0; i < term->render.workers.count; i++, worker_count++) {
-            if (term->render.workers.threads[i] == 0)
-                break;
-        }
+    fdm_timer_del(term->fdm, term->selection.auto_scroll.timer);
+    fdm_timer_del(term->fdm, term->render.app_sync_updates.timer);
+    fdm_timer_del(term->fdm, term->delayed_render_timer.lower);
+    fdm_timer_del(term->fdm, term->delayed_render_timer.upper);
+    fdm_timer_del(term->fdm, term->cursor_blink.timer);
+    fdm_timer_del(term->fdm, term->blink.timer);
+    fdm_timer_del(term->fdm, term->flash.timer);
+    if (term->parser.hup)
+        close(term->ptmx);
+    else
+        fdm_del(term->fdm, term->ptmx);
 
-        for (size_t i = 0; i < worker_count; i++) {
-            sem_post(&term->render.workers.start);
-            tll_push_back(term->render.workers.queue, -2);
-        }
+    if (term->window != NULL) {
+        wayl_win_destroy(term->window);
+        term->window = NULL;
     }
-    mtx_unlock(&term->render.workers.lock);
 
     free(term->vt.osc.data);
     free(term->vt.osc8.uri);
     grid_free(&term->normal);
     grid_free(&term->alt);
 
-    free(term->composed);
+    spill_reset(term);
+    composed_free(term);
+    attrs_free(term);
 
     free(term->window_title);
     tll_free_and_free(term->window_title_stack, free);
@@ -1397,18 +1505,23 @@ term_destroy(struct terminal *term)
 
     free(term->search.buf);
 
-    if (term->render.workers.threads != NULL) {
-        for (size_t i = 0; i < term->render.workers.count; i++) {
-            if (term->render.workers.threads[i] != 0)
-                thrd_join(term->render.workers.threads[i], NULL);
-        }
-    }
-    free(term->render.workers.threads);
+    render_glyph_caches_invalidate();
     mtx_destroy(&term->render.workers.lock);
-    sem_destroy(&term->render.workers.start);
-    sem_destroy(&term->render.workers.done);
-    xassert(tll_length(term->render.workers.queue) == 0);
-    tll_free(term->render.workers.queue);
+
+    for (size_t i = 0; i < term->render.damage_history.count; i++) {
+        struct frame_damage *frame = &term->render.damage_history.frames[
+            (term->render.damage_history.head + i) %
+            ALEN(term->render.damage_history.frames)];
+        pixman_region32_fini(&frame->dirty);
+        free(frame->scroll);
+    }
+
+    free(term->render.snapshot.rows);
+    free(term->render.snapshot.cells);
+    free(term->render.snapshot.composed);
+    free(term->render.snapshot.attrs);
+    for (size_t i = 0; i < ALEN(term->render.snapshot.fonts); i++)
+        fcft_destroy(term->render.snapshot.fonts[i]);
 
     tll_free(term->tab_stops);
 
@@ -1524,10 +1637,15 @@ erase_cell_range(struct terminal *term, struct row *row, int start, int end)
     row->dirty = true;
 
     if (unlikely(term->vt.attrs.have_bg)) {
+        const struct cell_attrs attrs = {
+            .idx = attrs_get(
+                term, &(struct attributes){.have_bg = 1, .bg = term->vt.attrs.bg}),
+        };
+
         for (int col = start; col <= end; col++) {
             struct cell *c = &row->cells[col];
             c->wc = 0;
-            c->attrs = (struct attributes){.have_bg = 1, .bg = term->vt.attrs.bg};
+            c->attrs = attrs;
         }
     } else
         memset(&row->cells[start], 0, (end - start + 1) * sizeof(row->cells[0]));
@@ -1657,7 +1775,7 @@ term_reset(struct terminal *term, bool hard)
 
     term->flash.active = false;
     term->blink.state = BLINK_ON;
-    fdm_del(term->fdm, term->blink.fd); term->blink.fd = -1;
+    fdm_timer_del(term->fdm, term->blink.timer); term->blink.timer = NULL;
     term->colors.fg = term->conf->colors.fg;
     term->colors.bg = term->conf->colors.bg;
     term->colors.alpha = term->conf->colors.alpha;
@@ -1691,15 +1809,18 @@ term_reset(struct terminal *term, bool hard)
         erase_line(term, r);
     }
     for (size_t i = term->rows; i < term->normal.num_rows; i++) {
-        grid_row_free(term->normal.rows[i]);
-        term->normal.rows[i] = NULL;
+        grid_row_free(&term->normal, grid_ring_get(&term->normal, i));
+        grid_ring_set(&term->normal, i, NULL);
     }
+    term_spill_reset(term);
     for (size_t i = term->rows; i < term->alt.num_rows; i++) {
-        grid_row_free(term->alt.rows[i]);
-        term->alt.rows[i] = NULL;
+        grid_row_free(&term->alt, grid_ring_get(&term->alt, i));
+        grid_ring_set(&term->alt, i, NULL);
     }
-    term->normal.cur_row = term->normal.rows[0];
-    term->alt.cur_row = term->alt.rows[0];
+    grid_release_chunks(&term->normal);
+    grid_release_chunks(&term->alt);
+    term->normal.cur_row = grid_ring_get(&term->normal, 0);
+    term->alt.cur_row = grid_ring_get(&term->alt, 0);
     tll_free(term->normal.scroll_damage);
     tll_free(term->alt.scroll_damage);
     term->render.last_cursor.row = NULL;
@@ -2000,30 +2121,17 @@ term_cursor_down(struct terminal *term, int count)
 static bool
 cursor_blink_rearm_timer(struct terminal *term)
 {
-    if (term->cursor_blink.fd < 0) {
-        int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
-        if (fd < 0) {
-            LOG_ERRNO("failed to create cursor blink timer FD");
-            return false;
-        }
-
-        if (!fdm_add(term->fdm, fd, EPOLLIN, &fdm_cursor_blink, term)) {
-            close(fd);
-            return false;
-        }
-
-        term->cursor_blink.fd = fd;
+    if (term->cursor_blink.timer == NULL) {
+        term->cursor_blink.timer = fdm_timer_add(
+            term->fdm, &fdm_cursor_blink, term);
     }
 
-    static const struct itimerspec timer = {
-        .it_value = {.tv_sec = 0, .tv_nsec = 500000000},
-        .it_interval = {.tv_sec = 0, .tv_nsec = 500000000},
-    };
-
-    if (timerfd_settime(term->cursor_blink.fd, 0, &timer, NULL) < 0) {
-        LOG_ERRNO("failed to arm cursor blink timer");
-        fdm_del(term->fdm, term->cursor_blink.fd);
-        term->cursor_blink.fd = -1;
+    if (!fdm_timer_set(term->fdm, term->cursor_blink.timer,
+                       500000000, 500000000))
+    {
+        LOG_ERR("failed to arm cursor blink timer");
+        fdm_timer_del(term->fdm, term->cursor_blink.timer);
+        term->cursor_blink.timer = NULL;
         return false;
     }
 
@@ -2033,8 +2141,8 @@ cursor_blink_rearm_timer(struct terminal *term)
 static bool
 cursor_blink_disarm_timer(struct terminal *term)
 {
-    fdm_del(term->fdm, term->cursor_blink.fd);
-    term->cursor_blink.fd = -1;
+    fdm_timer_del(term->fdm, term->cursor_blink.timer);
+    term->cursor_blink.timer = NULL;
     return true;
 }
 
@@ -2049,10 +2157,10 @@ term_cursor_blink_update(struct terminal *term)
             term->kbd_focus, term->is_shutting_down,
             enable, activate);
 
-    if (activate && term->cursor_blink.fd < 0) {
+    if (activate && term->cursor_blink.timer == NULL) {
         term->cursor_blink.state = CURSOR_BLINK_ON;
         cursor_blink_rearm_timer(term);
-    } else if (!activate && term->cursor_blink.fd >= 0)
+    } else if (!activate && term->cursor_blink.timer != NULL)
         cursor_blink_disarm_timer(term);
 }
 
@@ -2072,6 +2180,112 @@ selection_on_bottom_region(const struct terminal *term,
         selection_on_rows(term, region.end, term->rows - 1);
 }
 
+/* The oldest row, screen relative. All empty slots precede it */
+static int
+oldest_row(const struct terminal *term, const struct grid *grid)
+{
+    int oldest = term->rows;
+    while (oldest < grid->num_rows &&
+           grid_ring_get(grid, grid_row_absolute(grid, oldest)) == NULL)
+    {
+        oldest++;
+    }
+    return oldest;
+}
+
+/*
+ * Inserts 'count' empty slots into the normal grid's row ring, right
+ * below the screen, or removes -'count' (empty) slots from there.
+ */
+static void
+spill_resize_ring(struct terminal *term, int count)
+{
+    struct coord original_view = {
+        .row = term->is_searching ? term->search.original_view : -1,
+    };
+
+    struct coord *const tracking_points[] = {
+        &term->selection.start,
+        &term->selection.end,
+        &term->selection.pivot.start,
+        &term->selection.pivot.end,
+        &term->search.match,
+        &original_view,
+    };
+
+    grid_resize_ring(
+        &term->normal, count, term->rows,
+        ALEN(tracking_points), tracking_points);
+
+    if (term->is_searching)
+        term->search.original_view = original_view.row;
+
+    if (term->grid == &term->normal)
+        term_damage_view(term);
+}
+
+/*
+ * Appends an evicted (i.e. the oldest) row to the spill file, unless
+ * it was paged in from it
+ */
+static void
+spill_evict_row(struct terminal *term, const struct row *row,
+                struct cell buf[])
+{
+    if (term->spill.loaded > 0)
+        term->spill.loaded--;
+    else
+        spill_line(term, row, grid_row_cells(row, buf), term->normal.num_cols);
+}
+
+/*
+ * Gives back the slots added for lines paged in from the spill file
+ * (see term_spill_page_in()). Those are the oldest slots, and their
+ * rows are evicted.
+ */
+static void
+spill_trim(struct terminal *term)
+{
+    struct grid *grid = &term->normal;
+    const int grown = term->spill.grown;
+
+    if (term->selection.end.row >= 0) {
+        /* Selection rows may be "unwrapped", i.e. >= num_rows */
+        const int start = (term->selection.start.row - grid->offset +
+                           grid->num_rows) % grid->num_rows;
+        const int end = (term->selection.end.row - grid->offset +
+                         grid->num_rows) % grid->num_rows;
+
+        if ((start >= term->rows && start < term->rows + grown) ||
+            (end >= term->rows && end < term->rows + grown))
+        {
+            selection_cancel(term);
+        }
+    }
+
+    /* Compressed rows are decoded into this, not decompressed */
+    struct cell buf[grid->num_cols];
+
+    for (int r = term->rows; r < term->rows + grown; r++) {
+        const int idx = grid_row_absolute(grid, r);
+        struct row *row = grid_ring_get(grid, idx);
+
+        if (row == NULL)
+            continue;
+
+        spill_evict_row(term, row, buf);
+
+        if (term->render.last_cursor.row == row)
+            term->render.last_cursor.row = NULL;
+
+        grid_row_free(grid, row);
+        grid_ring_set(grid, idx, NULL);
+    }
+
+    spill_resize_ring(term, -grown);
+    term->spill.grown = 0;
+}
+
 void
 term_scroll_partial(struct terminal *term, struct scroll_region region, int rows)
 {
@@ -2081,6 +2295,15 @@ term_scroll_partial(struct terminal *term, struct scroll_region region, int rows
     /* Verify scroll amount has been clamped */
     xassert(rows <= region.end - region.start);
 
+    const bool spill =
+        term->conf->scrollback.spill && term->grid == &term->normal;
+
+    if (unlikely(term->spill.grown > 0) && spill &&
+        term->grid->view == term->grid->offset)
+    {
+        spill_trim(term);
+    }
+
     /* Cancel selections that cannot be scrolled */
     if (unlikely(term->selection.end.row >= 0)) {
         /*
@@ -2099,14 +2322,30 @@ term_scroll_partial(struct terminal *term, struct scroll_region region, int rows
     sixel_scroll_up(term, rows);
 
     bool view_follows = term->grid->view == term->grid->offset;
-    term->grid->offset += rows;
-    term->grid->offset &= term->grid->num_rows - 1;
+    term->grid->offset = grid_row_wrap(term->grid, term->grid->offset + rows);
 
     if (view_follows) {
         selection_view_down(term, term->grid->offset);
         term->grid->view = term->grid->offset;
     }
 
+    /*
+     * The scrolled in lines re-use the oldest rows, which are now
+     * right above the screen's bottom. Spill them before they are
+     * overwritten.
+     */
+    if (unlikely(spill)) {
+        /* Compressed rows are decoded into this, not decompressed */
+        struct cell buf[term->grid->num_cols];
+
+        for (int r = term->rows - rows; r < term->rows; r++) {
+            const struct row *row = grid_ring_get(
+                term->grid, grid_row_absolute(term->grid, r));
+            if (row != NULL)
+                spill_evict_row(term, row, buf);
+        }
+    }
+
     /* Top non-scrolling region. */
     for (int i = region.start - 1; i >= 0; i--)
         grid_swap_row(term->grid, i - rows, i);
@@ -2124,6 +2363,9 @@ term_scroll_partial(struct terminal *term, struct scroll_region region, int rows
     term_damage_scroll(term, DAMAGE_SCROLL, region, rows);
     term->grid->cur_row = grid_row(term->grid, term->grid->cursor.point.row);
 
+    if (term->conf->scrollback.compress)
+        grid_compress_scrollback(term->grid, term->rows, rows);
+
 #if defined(_DEBUG)
     for (int r = 0; r < term->rows; r++)
         xassert(grid_row(term->grid, r) != NULL);
@@ -2161,13 +2403,17 @@ term_scroll_reverse_partial(struct terminal *term,
         }
     }
 
+    /*
+     * Lines paged in from the spill file may end up on the screen;
+     * make them regular scrollback lines
+     */
+    if (unlikely(term->spill.loaded > 0) && term->grid == &term->normal)
+        spill_unload(term);
+
     sixel_scroll_down(term, rows);
 
     bool view_follows = term->grid->view == term->grid->offset;
-    term->grid->offset -= rows;
-    while (term->grid->offset < 0)
-        term->grid->offset += term->grid->num_rows;
-    term->grid->offset &= term->grid->num_rows - 1;
+    term->grid->offset = grid_row_wrap(term->grid, term->grid->offset - rows);
 
     xassert(term->grid->offset >= 0);
     xassert(term->grid->offset < term->grid->num_rows);
@@ -2185,6 +2431,39 @@ term_scroll_reverse_partial(struct terminal *term,
     for (int i = 0 + rows; i < region.start + rows; i++)
         grid_swap_row(term->grid, i, i - rows);
 
+    /*
+     * The scrolled in lines are taken from the newest scrollback
+     * lines. Once those have run out, they are the newest spilled
+     * lines.
+     */
+    if (unlikely(term->spill.count > 0) && term->grid == &term->normal) {
+        int missing = 0;
+        for (int r = region.start; r < region.start + rows; r++)
+            missing += grid_ring_get(term->grid, grid_row_absolute(term->grid, r)) == NULL;
+        spill_drop(term, missing);
+    }
+
+    /*
+     * Lines pushed off the screen end up as the oldest rows. With
+     * spill, the oldest rows must be the ones preceding the spilled
+     * lines; drop them instead.
+     */
+    if (unlikely(term->conf->scrollback.spill) && term->grid == &term->normal) {
+        for (int r = term->rows; r < term->rows + rows; r++) {
+            const int idx = grid_row_absolute(term->grid, r);
+            struct row *row = grid_ring_get(term->grid, idx);
+
+            if (row == NULL)
+                continue;
+
+            if (term->render.last_cursor.row == row)
+                term->render.last_cursor.row = NULL;
+
+            grid_row_free(term->grid, row);
+            grid_ring_set(term->grid, idx, NULL);
+        }
+    }
+
     /* Erase scrolled in lines */
     for (int r = region.start; r < region.start + rows; r++) {
         struct row *row = grid_row_and_alloc(term->grid, r);
@@ -2206,6 +2485,83 @@ term_scroll_reverse(struct terminal *term, int rows)
     term_scroll_reverse_partial(term, term->scroll_region, rows);
 }
 
+int
+term_spill_page_in(struct terminal *term, int count, int *first_row)
+{
+    struct grid *grid = &term->normal;
+    struct spill *spill = &term->spill;
+
+    if (term->grid != grid)
+        return 0;
+
+    int oldest = oldest_row(term, grid);
+
+    /* The ring grows to (at most) twice its regular size */
+    const int empty = oldest - term->rows;
+    const int growable = grid->num_rows - 2 * spill->grown;
+
+    const size_t available = spill->count - spill->loaded;
+    const int n = min((size_t)min(count, empty + growable), available);
+
+    if (n <= 0)
+        return 0;
+
+    if (n > empty) {
+        /* Make room, in whole chunks; trimmed again by term_scroll_partial() */
+        const int grow = min(
+            (n - empty + GRID_CHUNK_SIZE - 1) & ~(GRID_CHUNK_SIZE - 1),
+            growable);
+
+        spill_resize_ring(term, grow);
+        spill->grown += grow;
+        oldest += grow;
+    }
+
+    const size_t first_line = available - n;
+    const int first = oldest - n;
+
+    for (int i = 0; i < n; i++) {
+        /* In the grid before decoding; interning may scan the grid */
+        struct row *row = grid_row_alloc(grid, true);
+        grid_ring_set(grid, grid_row_absolute(grid, first + i), row);
+
+        spill_read(term, first_line + i, row, grid->num_cols);
+    }
+
+    spill->loaded += n;
+
+    if (first_row != NULL)
+        *first_row = grid_row_absolute(grid, first);
+    return n;
+}
+
+/*
+ * Called after the normal grid has been resized, with room for paged
+ * in lines. Removes the empty slots in excess of 'num_rows'.
+ */
+void
+term_spill_resized(struct terminal *term, int num_rows)
+{
+    struct grid *grid = &term->normal;
+    const int used = grid->num_rows - (oldest_row(term, grid) - term->rows);
+    const int fitted = max(num_rows, used);
+
+    if (fitted < grid->num_rows)
+        spill_resize_ring(term, fitted - grid->num_rows);
+
+    term->spill.grown = fitted - num_rows;
+}
+
+void
+term_spill_reset(struct terminal *term)
+{
+    /* The scrollback is empty; so are the slots added for paged in lines */
+    if (term->spill.grown > 0)
+        spill_resize_ring(term, -term->spill.grown);
+
+    spill_reset(term);
+}
+
 void
 term_carriage_return(struct terminal *term)
 {
@@ -2224,6 +2580,34 @@ term_linefeed(struct terminal *term)
         term_cursor_down(term, 1);
 }
 
+/*
+ * The first of 'count' linefeeds, with the cursor at the bottom of
+ * the scrolling region, and nothing but text in between them (see
+ * vt_from_slave()). All 'count' lines are scrolled in at once, and
+ * the cursor is moved up to where the text following this linefeed
+ * goes. The remaining linefeeds then only move the cursor down.
+ *
+ * The end result is the same as that of one term_linefeed() per
+ * linefeed; each one scrolling one line, but with the non-scrolling
+ * regions swapped back, the scrolled in lines erased, and the
+ * damage recorded, once per line.
+ */
+void
+term_linefeed_batch(struct terminal *term, int count)
+{
+    xassert(term->grid->cursor.point.row == term->scroll_region.end - 1);
+    xassert(count > 0);
+    xassert(count <= term->scroll_region.end - term->scroll_region.start);
+
+    term->grid->cur_row->linebreak = true;
+    term->grid->cursor.lcf = false;
+
+    term_scroll(term, count);
+    term_cursor_to(
+        term, term->grid->cursor.point.row - (count - 1),
+        term->grid->cursor.point.col);
+}
+
 void
 term_reverse_index(struct terminal *term)
 {
@@ -2584,13 +2968,11 @@ term_flash(struct terminal *term, unsigned duration_ms)
 {
     LOG_DBG("FLASH for %ums", duration_ms);
 
-    struct itimerspec alarm = {
-        .it_value = {.tv_sec = 0, .tv_nsec = duration_ms * 1000000},
-    };
-
-    if (timerfd_settime(term->flash.fd, 0, &alarm, NULL) < 0)
-        LOG_ERRNO("failed to arm flash timer");
-    else {
+    if (!fdm_timer_set(term->fdm, term->flash.timer,
+                       (uint64_t)duration_ms * 1000000, 0))
+    {
+        LOG_ERR("failed to arm flash timer");
+    } else {
         term->flash.active = true;
     }
 }
@@ -2642,9 +3024,8 @@ term_enable_app_sync_updates(struct terminal *term)
 {
     term->render.app_sync_updates.enabled = true;
 
-    if (timerfd_settime(
-            term->render.app_sync_updates.timer_fd, 0,
-            &(struct itimerspec){.it_value = {.tv_sec = 1}}, NULL) < 0)
+    if (!fdm_timer_set(
+            term->fdm, term->render.app_sync_updates.timer, 1000000000, 0))
     {
         LOG_ERR("failed to arm timer for application synchronized updates");
     }
@@ -2661,12 +3042,8 @@ term_enable_app_sync_updates(struct terminal *term)
     }
 
     /* Disarm delayed rendering timers */
-    timerfd_settime(
-        term->delayed_render_timer.lower_fd, 0,
-        &(struct itimerspec){{0}}, NULL);
-    timerfd_settime(
-        term->delayed_render_timer.upper_fd, 0,
-        &(struct itimerspec){{0}}, NULL);
+    fdm_timer_set(term->fdm, term->delayed_render_timer.lower, 0, 0);
+    fdm_timer_set(term->fdm, term->delayed_render_timer.upper, 0, 0);
     term->delayed_render_timer.is_armed = false;
 }
 
@@ -2680,9 +3057,7 @@ term_disable_app_sync_updates(struct terminal *term)
     render_refresh(term);
 
     /* Reset timers */
-    timerfd_settime(
-        term->render.app_sync_updates.timer_fd, 0,
-        &(struct itimerspec){{0}}, NULL);
+    fdm_timer_set(term->fdm, term->render.app_sync_updates.timer, 0, 0);
 }
 
 static inline void
@@ -2741,8 +3116,7 @@ print_spacer(struct terminal *term, int col, int remaining)
     struct cell *cell = &row->cells[col];
 
     cell->wc = CELL_SPACER + remaining;
-    cell->attrs = term->vt.attrs;
-    cell->attrs.clean = 0;
+    cell->attrs = (struct cell_attrs){.idx = attrs_pen(term)};
 }
 
 void
@@ -2788,11 +3162,10 @@ term_print(struct terminal *term, wchar_t wc, int width)
     struct cell *cell = &row->cells[term->grid->cursor.point.col];
 
     cell->wc = term->vt.last_printed = wc;
-    cell->attrs = term->vt.attrs;
+    cell->attrs = (struct cell_attrs){.idx = attrs_pen(term)};
 
     row->dirty = true;
     row->linebreak = false;
-    cell->attrs.clean = 0;
 
     /* Advance cursor the 'additional' columns while dirty:ing the cells */
     for (int i = 1; i < width && term->grid->cursor.point.col < term->cols - 1; i++) {
@@ -2828,11 +3201,10 @@ ascii_printer_fast(struct terminal *term, wchar_t wc)
     struct cell *cell = &row->cells[term->grid->cursor.point.col];
 
     cell->wc = term->vt.last_printed = wc;
-    cell->attrs = term->vt.attrs;
+    cell->attrs = (struct cell_attrs){.idx = attrs_pen(term)};
 
     row->dirty = true;
     row->linebreak = false;
-    cell->attrs.clean = 0;
 
     /* Advance cursor */
     if (unlikely(++term->grid->cursor.point.col >= term->cols)) {
@@ -2842,6 +3214,149 @@ ascii_printer_fast(struct terminal *term, wchar_t wc)
         xassert(!term->grid->cursor.lcf);
 }
 
+void
+term_print_ascii_run(struct terminal *term, const uint8_t *data, size_t len)
+{
+    /*
+     * Charsets, single shifts, insert mode and sixels all require
+     * per-character handling. Note that a single shift is only in
+     * effect for the first character, after which we may be able to
+     * use the fast path for the remainder of the run.
+     */
+    while (len > 0 && term->ascii_printer != &ascii_printer_fast) {
+        term->ascii_printer(term, *data);
+        data++;
+        len--;
+    }
+
+    if (len == 0)
+        return;
+
+    xassert(term->charsets.set[term->charsets.selected] == CHARSET_ASCII);
+    xassert(!term->insert_mode);
+    xassert(tll_length(term->grid->sixel_images) == 0);
+
+    struct grid *grid = term->grid;
+    const int cols = term->cols;
+
+    const struct cell_attrs attrs = {.idx = attrs_pen(term)};
+
+    term->vt.last_printed = data[len - 1];
+
+    while (len > 0) {
+        print_linewrap(term);
+
+        /* *Must* get current row *after* linewrap */
+        struct row *row = grid->cur_row;
+        int col = grid->cursor.point.col;
+
+        size_t count = min(len, (size_t)(cols - col));
+        struct cell *cell = &row->cells[col];
+
+        for (size_t i = 0; i < count; i++, cell++) {
+            cell->wc = data[i];
+            cell->attrs = attrs;
+        }
+
+        row->dirty = true;
+        row->linebreak = false;
+
+        data += count;
+        len -= count;
+        col += count;
+
+        /* Advance cursor */
+        if (unlikely(col >= cols)) {
+            grid->cursor.lcf = true;
+            col = cols - 1;
+
+            if (unlikely(!term->auto_margin) && len > 0) {
+                /* No auto-wrap; all remaining characters end up in
+                 * the last column, overwriting each other */
+                row->cells[col].wc = data[len - 1];
+                len = 0;
+            }
+        } else
+            xassert(!grid->cursor.lcf);
+
+        grid->cursor.point.col = col;
+    }
+}
+
+void
+term_print_run(struct terminal *term, const wchar_t *wcs, const int *widths,
+               size_t count)
+{
+    if (term->ascii_printer != &ascii_printer_fast) {
+        /* Insert mode and/or sixels; see term_print_ascii_run() */
+        for (size_t i = 0; i < count; i++)
+            term_print(term, wcs[i], widths[i]);
+        return;
+    }
+
+    if (count == 0)
+        return;
+
+    xassert(!term->insert_mode);
+    xassert(tll_length(term->grid->sixel_images) == 0);
+
+    struct grid *grid = term->grid;
+    const int cols = term->cols;
+
+    const struct cell_attrs attrs = {.idx = attrs_pen(term)};
+
+    term->vt.last_printed = wcs[count - 1];
+
+    for (size_t i = 0; i < count; i++) {
+        const wchar_t wc = wcs[i];
+        const int width = widths[i];
+
+        xassert(width > 0);
+
+        print_linewrap(term);
+
+        if (unlikely(width > 1) && likely(term->auto_margin) &&
+            grid->cursor.point.col + width > cols)
+        {
+            /* Multi-column character that doesn't fit on current
+             * line - pad with spacers, and force a line-wrap */
+            for (int c = grid->cursor.point.col; c < cols; c++) {
+                grid->cur_row->cells[c].wc = CELL_SPACER;
+                grid->cur_row->cells[c].attrs = attrs;
+            }
+
+            grid->cursor.lcf = true;
+            print_linewrap(term);
+        }
+
+        /* *Must* get current row *after* linewrap */
+        struct row *row = grid->cur_row;
+        int col = grid->cursor.point.col;
+
+        row->cells[col].wc = wc;
+        row->cells[col].attrs = attrs;
+
+        row->dirty = true;
+        row->linebreak = false;
+
+        /* Spacers for the 'additional' columns */
+        for (int w = 1; w < width && col < cols - 1; w++) {
+            col++;
+            row->cells[col].wc = CELL_SPACER + width - w;
+            row->cells[col].attrs = attrs;
+        }
+
+        /* Advance cursor */
+        if (unlikely(++col >= cols)) {
+            grid->cursor.lcf = true;
+            col--;
+        } else
+            xassert(!grid->cursor.lcf);
+
+        grid->cursor.point.col = col;
+    }
+}
+
 static void
 ascii_printer_single_shift(struct terminal *term, wchar_t wc)
 {
@@ -2916,52 +3431,92 @@ term_surface_kind(const struct terminal *term, const struct wl_surface *surface)
 }
 
 static bool
-rows_to_text(const struct terminal *term, int start, int end,
-             char **text, size_t *len)
+extract_rows(const struct terminal *term, int start, int end,
+             struct extraction_context *ctx)
 {
-    struct extraction_context *ctx = extract_begin(SELECTION_NONE, true);
-    if (ctx == NULL)
-        return false;
+    /* Compressed rows are decoded into this, not decompressed */
+    struct cell buf[term->grid->num_cols];
 
-    for (size_t r = start;
-         r != ((end + 1) & (term->grid->num_rows - 1));
-         r = (r + 1) & (term->grid->num_rows - 1))
+    for (int r = start;
+         r != grid_row_wrap(term->grid, end + 1);
+         r = grid_row_wrap(term->grid, r + 1))
     {
-        const struct row *row = term->grid->rows[r];
+        const struct row *row = grid_ring_get(term->grid, r);
         xassert(row != NULL);
 
+        const struct cell *cells = grid_row_cells(row, buf);
+
         for (int c = 0; c < term->cols; c++)
-            if (!extract_one(term, row, &row->cells[c], c, ctx))
-                goto out;
+            if (!extract_one(term, row, &cells[c], c, ctx))
+                return false;
     }
 
-out:
+    return true;
+}
+
+static bool
+rows_to_text(const struct terminal *term, int start, int end,
+             char **text, size_t *len)
+{
+    struct extraction_context *ctx = extract_begin(SELECTION_NONE, true);
+    if (ctx == NULL)
+        return false;
+
+    extract_rows(term, start, end, ctx);
     return extract_finish(ctx, text, len);
 }
 
 bool
-term_scrollback_to_text(const struct terminal *term, char **text, size_t *len)
+term_scrollback_to_text(struct terminal *term, char **text, size_t *len)
 {
-    int start = term->grid->offset + term->rows;
-    int end = term->grid->offset + term->rows - 1;
+    int start = grid_row_absolute(term->grid, term->rows);
+    int end = grid_row_absolute(term->grid, term->rows - 1);
 
     /* If scrollback isn't full yet, this may be NULL, so scan forward
      * until we find the first non-NULL row */
-    while (term->grid->rows[start] == NULL) {
-        start++;
-        start &= term->grid->num_rows - 1;
-    }
+    while (grid_ring_get(term->grid, start) == NULL)
+        start = grid_row_wrap(term->grid, start + 1);
 
-    if (end < 0)
-        end += term->grid->num_rows;
+    while (grid_ring_get(term->grid, end) == NULL)
+        end = grid_row_wrap(term->grid, end - 1);
 
-    while (term->grid->rows[end] == NULL) {
-        end--;
-        if (end < 0)
-            end += term->grid->num_rows;
+    struct extraction_context *ctx = extract_begin(SELECTION_NONE, true);
+    if (ctx == NULL)
+        return false;
+
+    /*
+     * Spilled lines (except those paged back into the grid) come
+     * first, as wide as they were when spilled. extract_one() detects
+     * new lines by their row, and looks at the previous one; alternate
+     * between two rows.
+     */
+    const size_t spilled = term->grid == &term->normal
+        ? term->spill.count - term->spill.loaded : 0;
+
+    struct spill_text lines[2] = {0};
+
+    for (size_t i = 0; i < spilled; i++) {
+        struct spill_text *line = &lines[i & 1];
+
+        if (!spill_read_text(term, i, line))
+            break;
+
+        for (int c = 0; c < line->cols; c++) {
+            const struct cell *cell = &line->row->cells[c];
+            const struct composed *composed =
+                cell->wc == CELL_COMB_CHARS_LO ? &line->chains[c] : NULL;
+
+            if (!extract_one_composed(term, line->row, cell, composed, c, ctx))
+                goto out;
+        }
     }
 
-    return rows_to_text(term, start, end, text, len);
+    extract_rows(term, start, end, ctx);
+
+out:
+    spill_text_free(&lines[0]);
+    spill_text_free(&lines[1]);
+    return extract_finish(ctx, text, len);
 }
 
 bool
@@ -3106,7 +3661,7 @@ term_osc8_close(struct terminal *term)
     while (true) {
         int end_col = r == end.row ? end.col : term->cols - 1;
 
-        struct row *row = term->grid->rows[r];
+        struct row *row = grid_row_at(term->grid, r);
 
         switch (term->conf->url.osc8_underline) {
         case OSC8_UNDERLINE_ALWAYS:
@@ -3144,8 +3699,7 @@ term_osc8_close(struct terminal *term)
         if (r == end.row)
             break;
 
-        r++;
-        r &= term->grid->num_rows - 1;
+        r = grid_row_wrap(term->grid, r + 1);
     }
 
 done:
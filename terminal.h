@@ -16,6 +16,8 @@
 #include "fdm.h"
 #include "macros.h"
 #include "reaper.h"
+#include "slab.h"
+#include "spill.h"
 #include "wayland.h"
 
 /*
@@ -25,6 +27,10 @@
  *
  * Note that the members are laid out optimized for x86
  */
+/*
+ * VT attributes. Cells don't store these directly; they are interned
+ * in a per-terminal table, which cells refer to by index (see attrs.h)
+ */
 struct attributes {
     bool bold:1;
     bool dim:1;
@@ -36,25 +42,31 @@ struct attributes {
     bool reverse:1;
     uint32_t fg:24;
 
-    bool clean:1;
     bool have_fg:1;
     bool have_bg:1;
-    uint32_t selected:2;
-    bool url:1;
-    uint32_t reserved:2;
+    uint32_t reserved:6;
     uint32_t bg:24;
 };
 static_assert(sizeof(struct attributes) == 8, "VT attribute struct too large");
 
+/* A cell's attributes: an index into the attribute table, and per-cell state */
+struct cell_attrs {
+    uint32_t idx:28;
+    bool clean:1;
+    uint32_t selected:2;
+    bool url:1;
+};
+static_assert(sizeof(struct cell_attrs) == 4, "cell attribute struct too large");
+
 #define CELL_COMB_CHARS_LO    0x40000000ul
 #define CELL_COMB_CHARS_HI    0x400ffffful
 #define CELL_SPACER           0x40100000ul
 
 struct cell {
     wchar_t wc;
-    struct attributes attrs;
+    struct cell_attrs attrs;
 };
-static_assert(sizeof(struct cell) == 12, "bad size");
+static_assert(sizeof(struct cell) == 8, "bad size");
 
 struct scroll_region {
     int start;
@@ -80,6 +92,13 @@ struct damage {
     int lines;
 };
 
+/* What a rendered frame changed in its buffer */
+struct frame_damage {
+    struct damage *scroll;      /* Scroll damage applied to the buffer, in order */
+    size_t scroll_count;
+    pixman_region32_t dirty;    /* Pixels rendered, after scrolling */
+};
+
 struct composed {
     wchar_t base;
     wchar_t combining[5];
@@ -97,11 +116,20 @@ struct row_data {
     tll(struct row_uri_range) uri_ranges;
 };
 
+/*
+ * Scrollback rows far enough out of the view are compressed; 'cells'
+ * is then NULL, and the row's contents are in 'compressed'. Use
+ * grid_row() and friends (grid.h) to access rows; they decompress
+ * rows on demand.
+ */
+struct row_compressed;
+
 struct row {
     struct cell *cells;
     bool dirty;
     bool linebreak;
     struct row_data *extra;
+    struct row_compressed *compressed;
 };
 
 struct sixel {
@@ -116,7 +144,7 @@ struct sixel {
 };
 
 struct grid {
-    int num_rows;
+    int num_rows;       /* Size of the row ring (screen + scrollback) */
     int num_cols;
     int offset;
     int view;
@@ -132,9 +160,26 @@ struct grid {
     struct cursor cursor;
     struct cursor saved_cursor;
 
-    struct row **rows;
+    /*
+     * The row ring, in chunks of GRID_CHUNK_SIZE rows (see grid.h).
+     * Chunks are allocated when a row is first stored in them. Until
+     * then, and once released again, they are all the shared, empty,
+     * chunk.
+     */
+    struct row ***chunks;
     struct row *cur_row;
 
+    /* Compressed rows that have been decompressed on demand (indices) */
+    struct {
+        int *idx;
+        size_t count;
+        size_t size;
+    } decompressed;
+
+    /* Rows, and their cells (num_cols per row), are carved from these */
+    struct slab row_slab;
+    struct slab cell_slab;
+
     tll(struct damage) scroll_damage;
     tll(struct sixel) sixel_images;
 };
@@ -280,6 +325,28 @@ struct terminal {
     pid_t slave;
     int ptmx;
 
+    /* PTY read scheduling statistics, see fdm_ptmx() */
+    struct {
+        uint64_t reads;         /* fdm_ptmx() calls that read anything */
+        uint64_t bytes;
+        uint64_t deferred;      /* Reads cut short by the time budget */
+        uint64_t max_read_ns;   /* Longest single fdm_ptmx() call */
+        uint64_t max_wait_ns;   /* Longest wait, with data deferred */
+        uint64_t deferred_at;   /* When data was last deferred; 0 if none */
+    } ptmx_stats;
+
+    /*
+     * Reads and parses PTY data, when tweak.parser_thread is enabled
+     */
+    struct {
+        bool running;
+        bool hup;       /* Main thread no longer watches 'ptmx' */
+        thrd_t thread;
+        int ptmx;       /* dup() of 'ptmx', polled by the parser thread */
+        int quit_fd;    /* Event FD, wakes the parser thread up to quit */
+        int done_fd;    /* Event FD, parser thread has reached EOF */
+    } parser;
+
     struct vt vt;
     struct grid *grid;
     struct grid normal;
@@ -309,14 +376,36 @@ struct terminal {
 
     tll(int) tab_stops;
 
+    /* Composed character chains, and a hash index (slot + 1, or 0) */
     size_t composed_count;
+    size_t composed_size;
     struct composed *composed;
+    uint32_t *composed_index;
+    size_t composed_index_size;
+    size_t composed_reuse_ofs;
+    uint64_t composed_generation;   /* Bumped whenever a chain is added */
+
+    /* Interned attributes, and a hash index (slot + 1, or 0) */
+    size_t attrs_count;
+    size_t attrs_size;
+    struct attributes *attrs;
+    uint32_t *attrs_index;
+    size_t attrs_index_size;
+    size_t attrs_reuse_ofs;
+    uint64_t attrs_generation;      /* Bumped whenever a slot is (re-)used */
+
+    /* vt.attrs, as of when it was last interned, and its index */
+    struct attributes attrs_pen;
+    uint32_t attrs_pen_idx;
+
+    /* Lines evicted from the normal grid's scrollback (scrollback.spill) */
+    struct spill spill;
 
     /* Temporary: for FDM */
     struct {
         bool is_armed;
-        int lower_fd;
-        int upper_fd;
+        struct fdm_timer *lower;
+        struct fdm_timer *upper;
     } delayed_render_timer;
 
     struct fcft_font *fonts[4];
@@ -384,12 +473,12 @@ struct terminal {
 
     struct {
         bool active;
-        int fd;
+        struct fdm_timer *timer;
     } flash;
 
     struct {
         enum { BLINK_ON, BLINK_OFF } state;
-        int fd;
+        struct fdm_timer *timer;
     } blink;
 
     int scale;
@@ -406,7 +495,7 @@ struct terminal {
     int cell_width;  /* pixels per cell, x-wise */
     int cell_height; /* pixels per cell, y-wise */
 
-    struct {
+    struct term_colors {
         uint32_t fg;
         uint32_t bg;
         uint32_t table[256];
@@ -420,7 +509,7 @@ struct terminal {
     struct {
         bool decset;   /* Blink enabled via '\E[?12h' */
         bool deccsusr; /* Blink enabled via '\E[X q' */
-        int fd;
+        struct fdm_timer *timer;
         enum { CURSOR_BLINK_ON, CURSOR_BLINK_OFF } state;
     } cursor_blink;
     struct {
@@ -442,7 +531,7 @@ struct terminal {
         } pivot;
 
         struct {
-            int fd;
+            struct fdm_timer *timer;
             int col;
             enum selection_scroll_direction direction;
         } auto_scroll;
@@ -494,18 +583,13 @@ struct terminal {
 
         struct {
             bool enabled;
-            int timer_fd;
+            struct fdm_timer *timer;
         } app_sync_updates;
 
-        /* Render threads + synchronization primitives */
+        /* Render threads (shared by all terminals, see render.c) */
         struct {
-            size_t count;
-            sem_t start;
-            sem_t done;
+            size_t count;   /* Max number of threads used, in addition to the main thread */
             mtx_t lock;
-            tll(int) queue;
-            thrd_t *threads;
-            struct buffer *buf;
         } workers;
 
         /* Last rendered cursor position */
@@ -516,6 +600,52 @@ struct terminal {
         } last_cursor;
 
         struct buffer *last_buf;     /* Buffer we rendered to last time */
+
+        /* The last frames' damage, oldest first; for buffers held by the compositor */
+        struct {
+            struct frame_damage frames[4];
+            size_t head;
+            size_t count;
+        } damage_history;
+
+        /*
+         * What rows are rasterized from: copies of the view's dirty
+         * rows, and of the (parser modifiable) state they're rendered
+         * with. Taken with the FDM lock held, see grid_render(). Rows
+         * that weren't dirty keep their content from earlier frames.
+         */
+        struct render_snapshot {
+            struct row *rows;       /* View relative */
+            struct cell *cells;     /* Backing store for all rows' cells */
+            int num_rows;
+            int num_cols;
+
+            struct composed *composed;
+            size_t composed_count;
+            size_t composed_size;
+            uint64_t composed_generation;
+
+            struct attributes *attrs;
+            size_t attrs_count;
+            size_t attrs_size;
+            uint64_t attrs_generation;
+
+            struct term_colors colors;
+            uint32_t cursor_color_text;
+            uint32_t cursor_color_cursor;
+            enum cursor_style cursor_style;
+            bool cursor_blink_on;
+            bool reverse;
+            bool blink_on;          /* Blinking text is visible */
+            bool blink_armed;       /* Blink timer is running */
+            bool kbd_focus;
+            bool is_searching;
+
+            struct fcft_font *fonts[4];     /* Referenced, see snapshot_state() */
+            int font_baseline;
+            enum fcft_subpixel font_subpixel;
+        } snapshot;
+
         bool was_flashing;           /* Flash was active last time we rendered */
         bool was_searching;
 
@@ -523,6 +653,16 @@ struct terminal {
 
         bool presentation_timings;
         struct timespec input_time;
+
+        /* Time spent in each phase of the last grid_render() */
+        struct {
+            struct timespec reapply;  /* Buffer acquisition, and previous frame's damage */
+            struct timespec scroll;   /* This frame's scroll damage, and dirty cell collection */
+            struct timespec sixel;
+            struct timespec rows;     /* Includes waiting for the workers */
+            struct timespec commit;
+            size_t threads;           /* Threads that rendered rows, including the main thread */
+        } timings;
     } render;
 
     struct {
@@ -653,6 +793,10 @@ void term_cursor_down(struct terminal *term, int count);
 void term_cursor_blink_update(struct terminal *term);
 
 void term_print(struct terminal *term, wchar_t wc, int width);
+void term_print_ascii_run(
+    struct terminal *term, const uint8_t *data, size_t len);
+void term_print_run(
+    struct terminal *term, const wchar_t *wcs, const int *widths, size_t count);
 
 void term_scroll(struct terminal *term, int rows);
 void term_scroll_reverse(struct terminal *term, int rows);
@@ -662,8 +806,18 @@ void term_scroll_partial(
 void term_scroll_reverse_partial(
     struct terminal *term, struct scroll_region region, int rows);
 
+/*
+ * Pages up to 'count' spilled lines back into the normal grid, above
+ * its oldest row. Returns the number of lines paged in; if non-NULL,
+ * '*first_row' is set to the (absolute) row of the first one.
+ */
+int term_spill_page_in(struct terminal *term, int count, int *first_row);
+void term_spill_resized(struct terminal *term, int num_rows);
+void term_spill_reset(struct terminal *term);
+
 void term_carriage_return(struct terminal *term);
 void term_linefeed(struct terminal *term);
+void term_linefeed_batch(struct terminal *term, int count);
 void term_reverse_index(struct terminal *term);
 
 void term_arm_blink_timer(struct terminal *term);
@@ -700,7 +854,7 @@ enum term_surface term_surface_kind(
     const struct terminal *term, const struct wl_surface *surface);
 
 bool term_scrollback_to_text(
-    const struct terminal *term, char **text, size_t *len);
+    struct terminal *term, char **text, size_t *len);
 bool term_view_to_text(
     const struct terminal *term, char **text, size_t *len);
 
@@ -0,0 +1,183 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <tllist.h>
+
+#include "config.h"
+#include "grid.h"
+#include "pgo/headless.h"
+#include "terminal.h"
+#include "vt.h"
+
+/*
+ * Headless VT parser tests, using the same stubs as foot-bench.
+ *
+ * The parser's fast paths must not change what ends up on the
+ * screen. Each sequence is fed to one terminal in a single
+ * vt_from_slave() call (taking the fast paths), and to another one
+ * byte at a time (the slow paths), and the results are compared.
+ */
+
+static const int row_count = 24;
+static const int col_count = 80;
+static const int grid_row_count = 256;
+
+struct test_term {
+    struct config conf;
+    struct wayland wayl;
+    struct terminal term;
+};
+
+static void
+test_term_init(struct test_term *t)
+{
+    *t = (struct test_term){
+        .conf = {
+            .tweak = {
+                .delayed_render_lower_ns = 500000,
+                .delayed_render_upper_ns = 16666666 / 2,
+            },
+        },
+        .wayl = {
+            .seats = tll_init(),
+            .monitors = tll_init(),
+            .terms = tll_init(),
+        },
+    };
+
+    headless_term_init(
+        &t->term, &t->conf, &t->wayl,
+        col_count, row_count, grid_row_count - row_count);
+}
+
+static void
+test_term_destroy(struct test_term *t)
+{
+    headless_term_destroy(&t->term);
+}
+
+static int
+scrolled_lines(struct terminal *term)
+{
+    int lines = 0;
+    tll_foreach(term->normal.scroll_damage, it)
+        lines += it->item.lines;
+    tll_free(term->normal.scroll_damage);
+    return lines;
+}
+
+static bool
+same_screen(const char *name, struct terminal *a, struct terminal *b)
+{
+    bool ok = true;
+
+    if (a->grid->offset != b->grid->offset) {
+        fprintf(stderr, "%s: grid offset: %d != %d\n",
+                name, a->grid->offset, b->grid->offset);
+        ok = false;
+    }
+
+    if (a->grid->cursor.point.row != b->grid->cursor.point.row ||
+        a->grid->cursor.point.col != b->grid->cursor.point.col)
+    {
+        fprintf(stderr, "%s: cursor: %dx%d != %dx%d\n", name,
+                a->grid->cursor.point.row, a->grid->cursor.point.col,
+                b->grid->cursor.point.row, b->grid->cursor.point.col);
+        ok = false;
+    }
+
+    for (int r = 0; r < row_count; r++) {
+        const struct row *ra = grid_row_in_view(a->grid, r);
+        const struct row *rb = grid_row_in_view(b->grid, r);
+
+        for (int c = 0; c < col_count; c++) {
+            if (ra->cells[c].wc != rb->cells[c].wc) {
+                fprintf(stderr, "%s: cell %dx%d: U+%04x != U+%04x\n",
+                        name, r, c, (unsigned)ra->cells[c].wc,
+                        (unsigned)rb->cells[c].wc);
+                ok = false;
+                break;
+            }
+        }
+    }
+
+    return ok;
+}
+
+/*
+ * Feeds 'prefix' to both terminals, to set them up, followed by
+ * 'data'; in one go to the first, a byte at a time to the second.
+ * Returns the number of lines the first terminal scrolled while
+ * parsing 'data', or -1 if the terminals differ.
+ */
+static int
+run(const char *name, const char *prefix, const char *data)
+{
+    struct test_term batched, sequential;
+    test_term_init(&batched);
+    test_term_init(&sequential);
+
+    vt_from_slave(&batched.term, (const uint8_t *)prefix, strlen(prefix));
+    vt_from_slave(&sequential.term, (const uint8_t *)prefix, strlen(prefix));
+    scrolled_lines(&batched.term);
+    scrolled_lines(&sequential.term);
+
+    vt_from_slave(&batched.term, (const uint8_t *)data, strlen(data));
+    for (size_t i = 0; data[i] != '\0'; i++)
+        vt_from_slave(&sequential.term, (const uint8_t *)&data[i], 1);
+
+    int scrolled = scrolled_lines(&batched.term);
+    int expected = scrolled_lines(&sequential.term);
+
+    if (scrolled != expected) {
+        fprintf(stderr, "%s: scrolled %d lines, expected %d\n",
+                name, scrolled, expected);
+        scrolled = -1;
+    }
+
+    if (!same_screen(name, &batched.term, &sequential.term))
+        scrolled = -1;
+
+    test_term_destroy(&batched);
+    test_term_destroy(&sequential);
+    return scrolled;
+}
+
+/* Moves the cursor to the bottom row */
+#define BOTTOM "\033[24H"
+
+int
+main(void)
+{
+    int failed = 0;
+
+    /* Linefeeds at the bottom are batched */
+    if (run("linefeeds", BOTTOM, "a\r\nb\r\nc\r\nd\r\n") != 4)
+        failed++;
+
+    /* Wrapping text moves the cursor down, in between */
+    char wrapped[3 * 80 + 16];
+    memset(wrapped, 'w', sizeof(wrapped));
+    memcpy(wrapped, "x\r\n", 3);
+    memcpy(&wrapped[sizeof(wrapped) - 4], "\r\n", 3);
+    if (run("wrapped", BOTTOM, wrapped) < 0)
+        failed++;
+
+    /*
+     * Reverse wrap: BS in the first column moves the cursor up a
+     * row, so the second linefeed doesn't scroll
+     */
+    if (run("reverse-wrap", BOTTOM, "x\r\n\bY\r\n") != 1)
+        failed++;
+
+    if (run("reverse-wrap-off", BOTTOM "\033[?45l", "x\r\n\bY\r\n") != 2)
+        failed++;
+
+    if (failed > 0) {
+        fprintf(stderr, "%d test(s) failed\n", failed);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
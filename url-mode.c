@@ -628,12 +628,12 @@ tag_cells_for_url(struct terminal *term, const struct url *url, bool value)
     const struct coord *start = &url->start;
     const struct coord *end = &url->end;
 
-    size_t end_r = end->row & (term->grid->num_rows - 1);
+    size_t end_r = grid_row_wrap(term->grid, end->row);
 
-    size_t r = start->row & (term->grid->num_rows - 1);
+    size_t r = grid_row_wrap(term->grid, start->row);
     size_t c = start->col;
 
-    struct row *row = term->grid->rows[r];
+    struct row *row = grid_row_at(term->grid, r);
     row->dirty = true;
 
     while (true) {
@@ -645,10 +645,10 @@ tag_cells_for_url(struct terminal *term, const struct url *url, bool value)
             break;
 
         if (++c >= term->cols) {
-            r = (r + 1) & (term->grid->num_rows - 1);
+            r = grid_row_wrap(term->grid, r + 1);
             c = 0;
 
-            row = term->grid->rows[r];
+            row = grid_row_at(term->grid, r);
             row->dirty = true;
         }
     }
@@ -674,7 +674,7 @@ urls_render(struct terminal *term)
     /* Dirty the last cursor, to ensure it is erased */
     {
         struct row *cursor_row = term->render.last_cursor.row;
-        if (cursor_row != NULL) {
+        if (cursor_row != NULL && cursor_row->cells != NULL) {
             struct cell *cell = &cursor_row->cells[term->render.last_cursor.col];
             cell->attrs.clean = 0;
             cursor_row->dirty = true;
@@ -4,48 +4,38 @@
 #include <string.h>
 #include <unistd.h>
 
+#if defined(__SSE2__)
+ #include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+ #include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+ #include <arm_neon.h>
+#endif
+
 #define LOG_MODULE "vt"
 #define LOG_ENABLE_DBG 0
 #include "log.h"
+#include "composed.h"
 #include "csi.h"
 #include "dcs.h"
 #include "debug.h"
 #include "grid.h"
 #include "osc.h"
 #include "util.h"
+#include "vt-table.h"
+#include "wcwidth.h"
 #include "xmalloc.h"
 
 #define UNHANDLED() LOG_DBG("unhandled: %s", esc_as_string(term, final))
 
-/* https://vt100.net/emu/dec_ansi_parser */
-
-enum state {
-    STATE_GROUND,
-    STATE_ESCAPE,
-    STATE_ESCAPE_INTERMEDIATE,
-
-    STATE_CSI_ENTRY,
-    STATE_CSI_PARAM,
-    STATE_CSI_INTERMEDIATE,
-    STATE_CSI_IGNORE,
-
-    STATE_OSC_STRING,
-
-    STATE_DCS_ENTRY,
-    STATE_DCS_PARAM,
-    STATE_DCS_INTERMEDIATE,
-    STATE_DCS_IGNORE,
-    STATE_DCS_PASSTHROUGH,
-
-    STATE_SOS_PM_APC_STRING,
-
-    STATE_UTF8_21,
-    STATE_UTF8_31,
-    STATE_UTF8_32,
-    STATE_UTF8_41,
-    STATE_UTF8_42,
-    STATE_UTF8_43,
-};
+/*
+ * https://vt100.net/emu/dec_ansi_parser
+ *
+ * The state machine itself (enum state, and the transition table) is
+ * generated from vt-table.txt, at build time.
+ */
 
 #if defined(_DEBUG) && defined(LOG_ENABLE_DBG) && LOG_ENABLE_DBG && 0
 static const char *const state_names[] = {
@@ -97,11 +87,6 @@ esc_as_string(struct terminal *term, uint8_t final)
 }
 #endif
 
-static void
-action_ignore(struct terminal *term)
-{
-}
-
 static void
 action_clear(struct terminal *term)
 {
@@ -286,6 +271,16 @@ action_print(struct terminal *term, uint8_t c)
     term->ascii_printer(term, c);
 }
 
+/*
+ * Prints a run of printable ASCII characters (0x20-0x7e). Only called
+ * from the ground state, see vt_from_slave().
+ */
+static void
+action_print_run(struct terminal *term, const uint8_t *data, size_t len)
+{
+    term_print_ascii_run(term, data, len);
+}
+
 static void
 action_param(struct terminal *term, uint8_t c)
 {
@@ -521,7 +516,7 @@ action_esc_dispatch(struct terminal *term, uint8_t final)
                 struct row *row = grid_row(term->grid, r);
                 for (int c = 0; c < term->cols; c++) {
                     row->cells[c].wc = L'E';
-                    row->cells[c].attrs = (struct attributes){0};
+                    row->cells[c].attrs = (struct cell_attrs){0};
                 }
                 row->dirty = true;
             }
@@ -580,10 +575,8 @@ action_put(struct terminal *term, uint8_t c)
 }
 
 static void
-action_utf8_print(struct terminal *term, wchar_t wc)
+utf8_print(struct terminal *term, wchar_t wc, int width)
 {
-    int width = wcwidth(wc);
-
     /*
      * Is this is combining character? The basic assumption is that if
      * wcwdith() returns 0, then it *is* a combining character.
@@ -623,7 +616,7 @@ action_utf8_print(struct terminal *term, wchar_t wc)
         if (composed != NULL)
             base = composed->base;
 
-        int base_width = wcwidth(base);
+        int base_width = my_wcwidth(base);
 
         if (base != 0 && base_width > 0) {
 
@@ -648,7 +641,7 @@ action_utf8_print(struct terminal *term, wchar_t wc)
                     term->fonts[0], base, wc, &base_from_primary,
                     &comb_from_primary, &pre_from_primary);
 
-                int precomposed_width = wcwidth(precomposed);
+                int precomposed_width = my_wcwidth(precomposed);
 
                 /*
                  * Only use the pre-composed character if:
@@ -688,44 +681,24 @@ action_utf8_print(struct terminal *term, wchar_t wc)
 
             xassert(wanted_count <= ALEN(composed->combining));
 
-            /* Look for existing combining chain */
-            for (size_t i = 0; i < term->composed_count; i++) {
-                const struct composed *cc = &term->composed[i];
-                if (cc->base != base)
-                    continue;
-
-                if (cc->count != wanted_count)
-                    continue;
-
-                if (cc->combining[wanted_count - 1] != wc)
-                    continue;
-
-                term_print(term, CELL_COMB_CHARS_LO + i, base_width);
-                return;
-            }
-
-            /* Allocate new chain */
-
-            struct composed new_cc;
-            new_cc.base = base;
-            new_cc.count = wanted_count;
+            struct composed new_cc = {
+                .base = base,
+                .count = wanted_count,
+            };
             for (size_t i = 0; i < wanted_count - 1; i++)
                 new_cc.combining[i] = composed->combining[i];
             new_cc.combining[wanted_count - 1] = wc;
 
-            if (term->composed_count < CELL_COMB_CHARS_HI) {
-                term->composed_count++;
-                term->composed = xrealloc(term->composed, term->composed_count * sizeof(term->composed[0]));
-                term->composed[term->composed_count - 1] = new_cc;
-
-                term_print(term, CELL_COMB_CHARS_LO + term->composed_count - 1, base_width);
+            wchar_t key;
+            if (composed_get(term, &new_cc, &key)) {
+                term_print(term, key, base_width);
                 return;
-            } else {
-                /* We reached our maximum number of allowed composed
-                 * character chains. Fall through here and print the
-                 * current zero-width character to the current cell */
-                LOG_WARN("maximum number of composed characters reached");
             }
+
+            /* We reached our maximum number of allowed composed
+             * character chains. Fall through here and print the
+             * current zero-width character to the current cell */
+            LOG_WARN("maximum number of composed characters reached");
         }
     }
 
@@ -733,6 +706,12 @@ action_utf8_print(struct terminal *term, wchar_t wc)
         term_print(term, wc, width);
 }
 
+static void
+action_utf8_print(struct terminal *term, wchar_t wc)
+{
+    utf8_print(term, wc, my_wcwidth(wc));
+}
+
 static void
 action_utf8_21(struct terminal *term, uint8_t c)
 {
@@ -799,361 +778,523 @@ action_utf8_44(struct terminal *term, uint8_t c)
     action_utf8_print(term, term->vt.utf8);
 }
 
-IGNORE_WARNING("-Wpedantic")
-
-static enum state
-anywhere(struct terminal *term, uint8_t data)
+/*
+ * Executes the action(s) of a state transition. Always inlined, and
+ * always called with a constant 'action', so that the switch is
+ * resolved at compile time.
+ */
+static inline void ALWAYS_INLINE
+vt_action(struct terminal *term, enum vt_action action, uint8_t c)
 {
-    switch (data) {
-        /*              exit                             current                          enter                            new state */
-    case 0x18:                                           action_execute(term, data);                                       return STATE_GROUND;
-    case 0x1a:                                           action_execute(term, data);                                       return STATE_GROUND;
-    case 0x1b:                                                                            action_clear(term);              return STATE_ESCAPE;
-
-    /* 8-bit C1 control characters (not supported) */
-    case 0x80 ... 0x9f:                                                                                                    return STATE_GROUND;
+    switch (action) {
+    case VT_ACTION_NONE:               break;
+    case VT_ACTION_EXECUTE:            action_execute(term, c); break;
+    case VT_ACTION_CLEAR:              action_clear(term); break;
+    case VT_ACTION_PRINT:              action_print(term, c); break;
+    case VT_ACTION_COLLECT:            action_collect(term, c); break;
+    case VT_ACTION_PARAM:              action_param(term, c); break;
+    case VT_ACTION_ESC_DISPATCH:       action_esc_dispatch(term, c); break;
+    case VT_ACTION_CSI_DISPATCH:       action_csi_dispatch(term, c); break;
+    case VT_ACTION_OSC_START:          action_osc_start(term, c); break;
+    case VT_ACTION_OSC_PUT:            action_osc_put(term, c); break;
+    case VT_ACTION_OSC_END:            action_osc_end(term, c); break;
+    case VT_ACTION_OSC_END_EXECUTE:    action_osc_end(term, c); action_execute(term, c); break;
+    case VT_ACTION_OSC_END_CLEAR:      action_osc_end(term, c); action_clear(term); break;
+    case VT_ACTION_HOOK:               action_hook(term, c); break;
+    case VT_ACTION_PUT:                action_put(term, c); break;
+    case VT_ACTION_UNHOOK:             action_unhook(term, c); break;
+    case VT_ACTION_UNHOOK_EXECUTE:     action_unhook(term, c); action_execute(term, c); break;
+    case VT_ACTION_UNHOOK_CLEAR:       action_unhook(term, c); action_clear(term); break;
+    case VT_ACTION_UTF8_21:            action_utf8_21(term, c); break;
+    case VT_ACTION_UTF8_22:            action_utf8_22(term, c); break;
+    case VT_ACTION_UTF8_31:            action_utf8_31(term, c); break;
+    case VT_ACTION_UTF8_32:            action_utf8_32(term, c); break;
+    case VT_ACTION_UTF8_33:            action_utf8_33(term, c); break;
+    case VT_ACTION_UTF8_41:            action_utf8_41(term, c); break;
+    case VT_ACTION_UTF8_42:            action_utf8_42(term, c); break;
+    case VT_ACTION_UTF8_43:            action_utf8_43(term, c); break;
+    case VT_ACTION_UTF8_44:            action_utf8_44(term, c); break;
     }
-
-    return term->vt.state;
 }
 
-static enum state
-state_ground_switch(struct terminal *term, uint8_t data)
+static inline bool
+is_printable_ascii(uint8_t c)
 {
-    switch (data) {
-        /*              exit                             current                          enter                            new state */
-    case 0x00 ... 0x17:
-    case 0x19:
-    case 0x1c ... 0x1f:                                  action_execute(term, data);                                       return STATE_GROUND;
-
-    /* modified from 0x20..0x7f to 0x20..0x7e, since 0x7f is DEL, which is a zero-width character */
-    case 0x20 ... 0x7e:                                  action_print(term, data);                                         return STATE_GROUND;
-
-    case 0xc2 ... 0xdf:                                  action_utf8_21(term, data);                                       return STATE_UTF8_21;
-    case 0xe0 ... 0xef:                                  action_utf8_31(term, data);                                       return STATE_UTF8_31;
-    case 0xf0 ... 0xf4:                                  action_utf8_41(term, data);                                       return STATE_UTF8_41;
-    }
-
-    return anywhere(term, data);
+    return c >= 0x20 && c <= 0x7e;
 }
 
-static enum state
-state_escape_switch(struct terminal *term, uint8_t data)
+/*
+ * Returns the length of the run of printable ASCII characters
+ * (0x20-0x7e) at the beginning of 'data'.
+ *
+ * Uses SSE2/AVX2/NEON, when available, to check 16 (or 32) bytes at a
+ * time. The tail (and the block containing the first non-printable
+ * character, on NEON) is handled byte-by-byte.
+ *
+ * Most runs are short (words between escapes, tab separated fields,
+ * prompts). The first 16 bytes are therefore checked byte-by-byte,
+ * and the vector scan is only entered for runs longer than that.
+ */
+static size_t
+printable_ascii_run_length(const uint8_t *data, size_t len)
 {
-    switch (data) {
-        /*              exit                             current                          enter                            new state */
-    case 0x00 ... 0x17:
-    case 0x19:
-    case 0x1c ... 0x1f:                                  action_execute(term, data);                                       return STATE_ESCAPE;
-
-    case 0x20 ... 0x2f:                                  action_collect(term, data);                                       return STATE_ESCAPE_INTERMEDIATE;
-    case 0x30 ... 0x4f:                                  action_esc_dispatch(term, data);                                  return STATE_GROUND;
-    case 0x50:                                                                            action_clear(term);              return STATE_DCS_ENTRY;
-    case 0x51 ... 0x57:                                  action_esc_dispatch(term, data);                                  return STATE_GROUND;
-    case 0x58:                                                                                                             return STATE_SOS_PM_APC_STRING;
-    case 0x59:                                           action_esc_dispatch(term, data);                                  return STATE_GROUND;
-    case 0x5a:                                           action_esc_dispatch(term, data);                                  return STATE_GROUND;
-    case 0x5b:                                                                            action_clear(term);              return STATE_CSI_ENTRY;
-    case 0x5c:                                           action_esc_dispatch(term, data);                                  return STATE_GROUND;
-    case 0x5d:                                                                            action_osc_start(term, data);    return STATE_OSC_STRING;
-    case 0x5e ... 0x5f:                                                                                                    return STATE_SOS_PM_APC_STRING;
-    case 0x60 ... 0x7e:                                  action_esc_dispatch(term, data);                                  return STATE_GROUND;
-    case 0x7f:                                           action_ignore(term);                                              return STATE_ESCAPE;
+    const size_t short_len = min(len, (size_t)16);
+
+    size_t i = 0;
+    for (; i < short_len; i++) {
+        if (!is_printable_ascii(data[i]))
+            return i;
     }
 
-    return anywhere(term, data);
-}
+#if defined(__AVX2__)
+    {
+        /* Bytes >= 0x80 are negative, and thus fail the 'lower' test */
+        const __m256i lower = _mm256_set1_epi8(0x1f);
+        const __m256i upper = _mm256_set1_epi8(0x7f);
+
+        for (; i + 32 <= len; i += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)&data[i]);
+            __m256i ok = _mm256_and_si256(
+                _mm256_cmpgt_epi8(v, lower), _mm256_cmpgt_epi8(upper, v));
+
+            uint32_t mask = (uint32_t)_mm256_movemask_epi8(ok);
+            if (mask != 0xffffffffu)
+                return i + __builtin_ctz(~mask);
+        }
+    }
+#endif
 
-static enum state
-state_escape_intermediate_switch(struct terminal *term, uint8_t data)
-{
-    switch (data) {
-        /*              exit                             current                          enter                            new state */
-    case 0x00 ... 0x17:
-    case 0x19:
-    case 0x1c ... 0x1f:                                  action_execute(term, data);                                       return STATE_ESCAPE_INTERMEDIATE;
-
-    case 0x20 ... 0x2f:                                  action_collect(term, data);                                       return STATE_ESCAPE_INTERMEDIATE;
-    case 0x30 ... 0x7e:                                  action_esc_dispatch(term, data);                                  return STATE_GROUND;
-    case 0x7f:                                           action_ignore(term);                                              return STATE_ESCAPE_INTERMEDIATE;
+#if defined(__SSE2__)
+    {
+        const __m128i lower = _mm_set1_epi8(0x1f);
+        const __m128i upper = _mm_set1_epi8(0x7f);
+
+        for (; i + 16 <= len; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)&data[i]);
+            __m128i ok = _mm_and_si128(
+                _mm_cmpgt_epi8(v, lower), _mm_cmplt_epi8(v, upper));
+
+            unsigned mask = (unsigned)_mm_movemask_epi8(ok);
+            if (mask != 0xffffu)
+                return i + __builtin_ctz(~mask);
+        }
     }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    {
+        const uint8x16_t lower = vdupq_n_u8(0x1f);
+        const uint8x16_t upper = vdupq_n_u8(0x7f);
 
-    return anywhere(term, data);
-}
+        for (; i + 16 <= len; i += 16) {
+            uint8x16_t v = vld1q_u8(&data[i]);
+            uint8x16_t ok = vandq_u8(vcgtq_u8(v, lower), vcltq_u8(v, upper));
 
-static enum state
-state_csi_entry_switch(struct terminal *term, uint8_t data)
-{
-    switch (data) {
-        /*              exit                             current                          enter                            new state */
-    case 0x00 ... 0x17:
-    case 0x19:
-    case 0x1c ... 0x1f:                                  action_execute(term, data);                                       return STATE_CSI_ENTRY;
-
-    case 0x20 ... 0x2f:                                  action_collect(term, data);                                       return STATE_CSI_INTERMEDIATE;
-    case 0x30 ... 0x39:                                  action_param(term, data);                                         return STATE_CSI_PARAM;
-    case 0x3a ... 0x3b:                                  action_param(term, data);                                         return STATE_CSI_PARAM;
-    case 0x3c ... 0x3f:                                  action_collect(term, data);                                       return STATE_CSI_PARAM;
-    case 0x40 ... 0x7e:                                  action_csi_dispatch(term, data);                                  return STATE_GROUND;
-    case 0x7f:                                           action_ignore(term);                                              return STATE_CSI_ENTRY;
+            /* Non-printable character somewhere in this block */
+            if (vminvq_u8(ok) == 0)
+                break;
+        }
     }
+#endif
 
-    return anywhere(term, data);
+    for (; i < len; i++) {
+        if (!is_printable_ascii(data[i]))
+            break;
+    }
+
+    return i;
 }
 
-static enum state
-state_csi_param_switch(struct terminal *term, uint8_t data)
+/*
+ * Returns the length of the run of non-ASCII bytes (0x80-0xff) at
+ * the beginning of 'data'. Like printable_ascii_run_length(), this
+ * uses SSE2/AVX2/NEON when available.
+ */
+static size_t
+non_ascii_run_length(const uint8_t *data, size_t len)
 {
-    switch (data) {
-        /*              exit                             current                          enter                            new state */
-    case 0x00 ... 0x17:
-    case 0x19:
-    case 0x1c ... 0x1f:                                  action_execute(term, data);                                       return STATE_CSI_PARAM;
-
-    case 0x20 ... 0x2f:                                  action_collect(term, data);                                       return STATE_CSI_INTERMEDIATE;
+    size_t i = 0;
 
-    case 0x30 ... 0x39:
-    case 0x3a ... 0x3b:                                  action_param(term, data);                                         return STATE_CSI_PARAM;
+#if defined(__AVX2__)
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)&data[i]);
 
-    case 0x3c ... 0x3f:                                                                                                    return STATE_CSI_IGNORE;
-    case 0x40 ... 0x7e:                                  action_csi_dispatch(term, data);                                  return STATE_GROUND;
-    case 0x7f:                                           action_ignore(term);                                              return STATE_CSI_PARAM;
+        /* The mask is simply the MSB of each byte */
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(v);
+        if (mask != 0xffffffffu)
+            return i + __builtin_ctz(~mask);
     }
+#endif
 
-    return anywhere(term, data);
-}
+#if defined(__SSE2__)
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)&data[i]);
 
-static enum state
-state_csi_intermediate_switch(struct terminal *term, uint8_t data)
-{
-    switch (data) {
-        /*              exit                             current                          enter                            new state */
-    case 0x00 ... 0x17:
-    case 0x19:
-    case 0x1c ... 0x1f:                                  action_execute(term, data);                                       return STATE_CSI_INTERMEDIATE;
-
-    case 0x20 ... 0x2f:                                  action_collect(term, data);                                       return STATE_CSI_INTERMEDIATE;
-    case 0x30 ... 0x3f:                                                                                                    return STATE_CSI_IGNORE;
-    case 0x40 ... 0x7e:                                  action_csi_dispatch(term, data);                                  return STATE_GROUND;
-    case 0x7f:                                           action_ignore(term);                                              return STATE_CSI_INTERMEDIATE;
+        unsigned mask = (unsigned)_mm_movemask_epi8(v);
+        if (mask != 0xffffu)
+            return i + __builtin_ctz(~mask);
     }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t v = vld1q_u8(&data[i]);
 
-    return anywhere(term, data);
-}
+        /* ASCII character somewhere in this block */
+        if (vminvq_u8(v) < 0x80)
+            break;
+    }
+#endif
 
-static enum state
-state_csi_ignore_switch(struct terminal *term, uint8_t data)
-{
-    switch (data) {
-        /*              exit                             current                          enter                            new state */
-    case 0x00 ... 0x17:
-    case 0x19:
-    case 0x1c ... 0x1f:                                  action_execute(term, data);                                       return STATE_CSI_IGNORE;
-
-    case 0x20 ... 0x3f:                                  action_ignore(term);                                              return STATE_CSI_IGNORE;
-    case 0x40 ... 0x7e:                                                                                                    return STATE_GROUND;
-    case 0x7f:                                           action_ignore(term);                                              return STATE_CSI_IGNORE;
+    for (; i < len; i++) {
+        if (data[i] < 0x80)
+            break;
     }
 
-    return anywhere(term, data);
+    return i;
 }
 
-static enum state
-state_osc_string_switch(struct terminal *term, uint8_t data)
+/*
+ * Decodes well-formed UTF-8 (RFC 3629: no overlong encodings, no
+ * surrogates, nothing above U+10FFFF) from 'data', which must consist
+ * of non-ASCII bytes only (see non_ascii_run_length()).
+ *
+ * Decoding stops when 'out' is full, at the first malformed sequence,
+ * or at an incomplete sequence at the end of 'data'. Those are left
+ * to the state machine.
+ *
+ * Returns the number of bytes consumed. The number of decoded
+ * characters is returned in 'count'.
+ */
+static size_t
+utf8_decode_run(const uint8_t *data, size_t len,
+                wchar_t *out, size_t out_size, size_t *count)
 {
-    switch (data) {
-        /*              exit                             current                          enter                            new state */
+    size_t i = 0;
+    size_t n = 0;
 
-    /* Note: original was 20-7f, but I changed to 20-ff to include utf-8. Don't forget to add EXECUTE to 8-bit C1 if we implement that. */
-    default:                                             action_osc_put(term, data);                                       return STATE_OSC_STRING;
+    /* Since all bytes are >= 0x80, a continuation byte is simply < 0xc0 */
+    while (n < out_size && i < len) {
+        const uint8_t c0 = data[i];
 
-    case 0x07:          action_osc_end(term, data);                                                                        return STATE_GROUND;
+        if (c0 >= 0xc2 && c0 <= 0xdf) {
+            if (i + 1 >= len || data[i + 1] >= 0xc0)
+                break;
 
-    case 0x00 ... 0x06:
-    case 0x08 ... 0x17:
-    case 0x19:
-    case 0x1c ... 0x1f:                                  action_ignore(term);                                              return STATE_OSC_STRING;
+            out[n++] = (c0 & 0x1f) << 6 | (data[i + 1] & 0x3f);
+            i += 2;
+        }
 
+        else if (c0 >= 0xe0 && c0 <= 0xef) {
+            if (i + 2 >= len)
+                break;
 
-    case 0x18:
-    case 0x1a:          action_osc_end(term, data);      action_execute(term, data);                                       return STATE_GROUND;
+            const uint8_t c1 = data[i + 1];
+            const uint8_t c2 = data[i + 2];
 
-    case 0x1b:          action_osc_end(term, data);      action_clear(term);                                               return STATE_ESCAPE;
-    }
-}
+            if (c1 >= 0xc0 || c2 >= 0xc0)
+                break;
+            if (c0 == 0xe0 && c1 < 0xa0)  /* Overlong */
+                break;
+            if (c0 == 0xed && c1 > 0x9f)  /* Surrogate */
+                break;
 
-static enum state
-state_dcs_entry_switch(struct terminal *term, uint8_t data)
-{
-    switch (data) {
-        /*              exit                             current                          enter                            new state */
-    case 0x00 ... 0x17:
-    case 0x19:
-    case 0x1c ... 0x1f:                                  action_ignore(term);                                              return STATE_DCS_ENTRY;
-
-    case 0x20 ... 0x2f:                                  action_collect(term, data);                                       return STATE_DCS_INTERMEDIATE;
-    case 0x30 ... 0x39:                                  action_param(term, data);                                         return STATE_DCS_PARAM;
-    case 0x3a:                                                                                                             return STATE_DCS_IGNORE;
-    case 0x3b:                                           action_param(term, data);                                         return STATE_DCS_PARAM;
-    case 0x3c ... 0x3f:                                  action_collect(term, data);                                       return STATE_DCS_PARAM;
-    case 0x40 ... 0x7e:                                                                   action_hook(term, data);         return STATE_DCS_PASSTHROUGH;
-    case 0x7f:                                           action_ignore(term);                                              return STATE_DCS_ENTRY;
-    }
+            out[n++] = (c0 & 0x0f) << 12 | (c1 & 0x3f) << 6 | (c2 & 0x3f);
+            i += 3;
+        }
 
-    return anywhere(term, data);
-}
+        else if (c0 >= 0xf0 && c0 <= 0xf4) {
+            if (i + 3 >= len)
+                break;
 
-static enum state
-state_dcs_param_switch(struct terminal *term, uint8_t data)
-{
-    switch (data) {
-        /*              exit                             current                          enter                            new state */
-    case 0x00 ... 0x17:
-    case 0x19:
-    case 0x1c ... 0x1f:                                  action_ignore(term);                                              return STATE_DCS_PARAM;
-
-    case 0x20 ... 0x2f:                                  action_collect(term, data);                                       return STATE_DCS_INTERMEDIATE;
-    case 0x30 ... 0x39:                                  action_param(term, data);                                         return STATE_DCS_PARAM;
-    case 0x3a:                                                                                                             return STATE_DCS_IGNORE;
-    case 0x3b:                                           action_param(term, data);                                         return STATE_DCS_PARAM;
-    case 0x3c ... 0x3f:                                                                                                    return STATE_DCS_IGNORE;
-    case 0x40 ... 0x7e:                                                                   action_hook(term, data);         return STATE_DCS_PASSTHROUGH;
-    case 0x7f:                                           action_ignore(term);                                              return STATE_DCS_PARAM;
-    }
+            const uint8_t c1 = data[i + 1];
+            const uint8_t c2 = data[i + 2];
+            const uint8_t c3 = data[i + 3];
 
-    return anywhere(term, data);
-}
+            if (c1 >= 0xc0 || c2 >= 0xc0 || c3 >= 0xc0)
+                break;
+            if (c0 == 0xf0 && c1 < 0x90)  /* Overlong */
+                break;
+            if (c0 == 0xf4 && c1 > 0x8f)  /* > U+10FFFF */
+                break;
 
-static enum state
-state_dcs_intermediate_switch(struct terminal *term, uint8_t data)
-{
-    switch (data) {
-        /*              exit                             current                          enter                            new state */
-    case 0x00 ... 0x17:
-    case 0x19:
-    case 0x1c ... 0x1f:                                  action_ignore(term);                                              return STATE_DCS_INTERMEDIATE;
-
-    case 0x20 ... 0x2f:                                  action_collect(term, data);                                       return STATE_DCS_INTERMEDIATE;
-    case 0x30 ... 0x3f:                                                                                                    return STATE_DCS_IGNORE;
-    case 0x40 ... 0x7e:                                                                   action_hook(term, data);         return STATE_DCS_PASSTHROUGH;
-    case 0x7f:                                           action_ignore(term);                                              return STATE_DCS_INTERMEDIATE;
+            out[n++] = (c0 & 0x07) << 18 | (c1 & 0x3f) << 12 |
+                       (c2 & 0x3f) << 6 | (c3 & 0x3f);
+            i += 4;
+        }
+
+        else
+            break;
     }
 
-    return anywhere(term, data);
+    *count = n;
+    return i;
 }
 
-static enum state
-state_dcs_ignore_switch(struct terminal *term, uint8_t data)
+/*
+ * Decodes, and prints, a run of well-formed multi-byte UTF-8
+ * characters. Only called from the ground state, see
+ * vt_from_slave().
+ *
+ * Returns the number of bytes consumed. This may be 0, if 'data'
+ * doesn't begin with a complete, well-formed, UTF-8 sequence.
+ */
+static size_t
+action_utf8_print_run(struct terminal *term, const uint8_t *data, size_t len)
 {
-    switch (data) {
-        /*              exit                             current                          enter                            new state */
-    case 0x00 ... 0x17:
-    case 0x19:
-    case 0x1c ... 0x1f:
-    case 0x20 ... 0x7f:                                  action_ignore(term);                                              return STATE_DCS_IGNORE;
+    len = non_ascii_run_length(data, len);
+
+    size_t consumed = 0;
+    while (consumed < len) {
+        wchar_t wcs[256];
+        size_t count;
+        size_t bytes = utf8_decode_run(
+            &data[consumed], len - consumed, wcs, ALEN(wcs), &count);
+
+        if (bytes == 0)
+            break;
+
+        /*
+         * Print characters in batches. Zero-width (combining)
+         * characters, and non-printables, are handed to
+         * utf8_print(), one by one.
+         */
+        int widths[ALEN(wcs)];
+        size_t first = 0;
+
+        for (size_t i = 0; i < count; i++) {
+            widths[i] = my_wcwidth(wcs[i]);
+            if (likely(widths[i] > 0))
+                continue;
+
+            if (i > first)
+                term_print_run(term, &wcs[first], &widths[first], i - first);
+            utf8_print(term, wcs[i], widths[i]);
+            first = i + 1;
+        }
+
+        if (count > first)
+            term_print_run(term, &wcs[first], &widths[first], count - first);
+        consumed += bytes;
     }
 
-    return anywhere(term, data);
+    return consumed;
 }
 
-static enum state
-state_dcs_passthrough_switch(struct terminal *term, uint8_t data)
+/*
+ * Returns the number of linefeeds at the beginning of 'data' (which
+ * must start with one) separated only by text, CR and HT. That is,
+ * by nothing that moves the cursor to another row, or scrolls,
+ * except by wrapping. Counts at most 'max' linefeeds.
+ *
+ * Not BS, since it moves the cursor up a row when reverse wrapping
+ * from the first column. The rows following it would then have
+ * already been scrolled in.
+ */
+static int
+linefeed_run_length(const uint8_t *data, size_t len, int max)
 {
-    switch (data) {
-        /*              exit                             current                          enter                            new state */
-    case 0x00 ... 0x17:
-    case 0x19:
-    case 0x1c ... 0x7e:                                  action_put(term, data);                                           return STATE_DCS_PASSTHROUGH;
+    xassert(len > 0 && data[0] == '\n');
 
-    case 0x7f:                                           action_ignore(term);                                              return STATE_DCS_PASSTHROUGH;
+    int count = 1;
+    size_t i = 1;
 
-    /* Anywhere */
-    case 0x18:          action_unhook(term, data);       action_execute(term, data);                                       return STATE_GROUND;
-    case 0x1a:          action_unhook(term, data);       action_execute(term, data);                                       return STATE_GROUND;
-    case 0x1b:          action_unhook(term, data);                                        action_clear(term);              return STATE_ESCAPE;
+    while (i < len && count < max) {
+        const uint8_t c = data[i];
 
-    /* 8-bit C1 control characters (not supported) */
-    case 0x80 ... 0x9f: action_unhook(term, data);                                                                         return STATE_GROUND;
+        if (is_printable_ascii(c)) {
+            i += printable_ascii_run_length(&data[i], len - i);
+            continue;
+        }
 
-    default:                                                                                                               return STATE_DCS_PASSTHROUGH;
-    }
-}
+        if (c >= 0x80) {
+            i += non_ascii_run_length(&data[i], len - i);
+            continue;
+        }
 
-static enum state
-state_sos_pm_apc_string_switch(struct terminal *term, uint8_t data)
-{
-    switch (data) {
-        /*              exit                             current                          enter                            new state */
-    case 0x00 ... 0x17:
-    case 0x19:
-    case 0x1c ... 0x7f:                                  action_ignore(term);                                              return STATE_SOS_PM_APC_STRING;
-    }
+        switch (c) {
+        case '\n':
+            /* Dropped, if it terminates an incomplete UTF-8 sequence */
+            if (data[i - 1] >= 0x80)
+                return count;
+            count++;
+            break;
 
-    return anywhere(term, data);
-}
+        case '\r':
+        case '\t':
+            break;
 
-static enum state
-state_utf8_21_switch(struct terminal *term, uint8_t data)
-{
-    switch (data) {
-        /*              exit                             current                          enter                            new state */
-    case 0x80 ... 0xbf:                                  action_utf8_22(term, data);                                       return STATE_GROUND;
-    default:                                                                                                               return STATE_GROUND;
+        default:
+            return count;
+        }
+
+        i++;
     }
+
+    return count;
 }
 
-static enum state
-state_utf8_31_switch(struct terminal *term, uint8_t data)
+/*
+ * Ground state fast paths. Returns the number of bytes consumed, or
+ * 0 if the byte at 'p' must go through the state machine.
+ */
+static inline size_t ALWAYS_INLINE
+ground_fast_path(struct terminal *term, const uint8_t *p, size_t len)
 {
-    switch (data) {
-        /*              exit                             current                          enter                            new state */
-    case 0x80 ... 0xbf:                                  action_utf8_32(term, data);                                       return STATE_UTF8_32;
-    default:                                                                                                               return STATE_GROUND;
+    if (is_printable_ascii(*p)) {
+        /*
+         * Print the whole run of printable ASCII in one go, without
+         * going through the state machine for each character.
+         */
+        size_t count = printable_ascii_run_length(p, len);
+        xassert(count > 0);
+
+        action_print_run(term, p, count);
+        return count;
     }
-}
 
-static enum state
-state_utf8_32_switch(struct terminal *term, uint8_t data)
-{
-    switch (data) {
-        /*              exit                             current                          enter                            new state */
-    case 0x80 ... 0xbf:                                  action_utf8_33(term, data);                                       return STATE_GROUND;
-    default:                                                                                                               return STATE_GROUND;
+    if (*p >= 0x80) {
+        /*
+         * Decode, and print, a run of well-formed multi-byte UTF-8
+         * characters in one go. Malformed sequences, and sequences
+         * split across buffers, are handled by the state machine.
+         */
+        return action_utf8_print_run(term, p, len);
     }
-}
 
-static enum state
-state_utf8_41_switch(struct terminal *term, uint8_t data)
-{
-    switch (data) {
-        /*              exit                             current                          enter                            new state */
-    case 0x80 ... 0xbf:                                  action_utf8_42(term, data);                                       return STATE_UTF8_42;
-    default:                                                                                                               return STATE_GROUND;
+    if (*p == '\n' &&
+        term->grid->cursor.point.row == term->scroll_region.end - 1 &&
+        term->scroll_region.start == 0 &&
+        likely(term->selection.end.row < 0))
+    {
+        /*
+         * A linefeed that scrolls. Scroll in all lines of the text
+         * that follows at once, rather than one at a time.
+         *
+         * Not with a selection, since whether it's cancelled or not
+         * depends on the rows scrolled at a time. Nor with a top
+         * margin, since the order in which the scrolled out lines
+         * end up in the scrollback does too.
+         */
+        term_linefeed_batch(
+            term, linefeed_run_length(
+                p, len,
+                term->scroll_region.end - term->scroll_region.start));
+        return 1;
     }
+
+    return 0;
 }
 
-static enum state
-state_utf8_42_switch(struct terminal *term, uint8_t data)
+/*
+ * Accumulates a run of digits into the current CSI parameter (or
+ * sub-parameter). Does the same thing as calling action_param() for
+ * each digit, but without dispatching each one through the state
+ * machine. Returns a pointer to the first non-digit.
+ *
+ * Must only be called after action_param(), i.e. with at least one
+ * parameter.
+ */
+static inline const uint8_t * ALWAYS_INLINE
+csi_param_digits(struct terminal *term, const uint8_t *p, const uint8_t *end)
 {
-    switch (data) {
-        /*              exit                             current                          enter                            new state */
-    case 0x80 ... 0xbf:                                  action_utf8_43(term, data);                                       return STATE_UTF8_43;
-    default:                                                                                                               return STATE_GROUND;
-    }
+    xassert(term->vt.params.idx > 0);
+
+    const size_t max_params = ALEN(term->vt.params.v);
+    const size_t max_sub_params = ALEN(term->vt.params.v[0].sub.value);
+
+    /* Let action_param() log the error */
+    if (unlikely(term->vt.params.idx - 1 >= max_params))
+        return p;
+
+    struct vt_param *param = &term->vt.params.v[term->vt.params.idx - 1];
+    unsigned *value;
+
+    if (param->sub.idx > 0) {
+        if (unlikely(param->sub.idx - 1 >= max_sub_params))
+            return p;
+        value = &param->sub.value[param->sub.idx - 1];
+    } else
+        value = &param->value;
+
+    unsigned v = *value;
+    for (; p < end && *p >= '0' && *p <= '9'; p++)
+        v = v * 10 + (*p - '0');
+
+    *value = v;
+    return p;
 }
 
-static enum state
-state_utf8_43_switch(struct terminal *term, uint8_t data)
+#if defined(__GNUC__)
+
+IGNORE_WARNING("-Wpedantic")
+
+/*
+ * Threaded dispatch, using computed gotos (labels as values, a GNU C
+ * extension).
+ *
+ * Each transition ends with its own jump to the next transition, and
+ * since the new state is a compile time constant in each transition,
+ * so is the row of the table it is looked up in. This gives the
+ * branch predictor one indirect jump per transition to learn from,
+ * instead of a single, shared, jump for all of them, and keeps the
+ * state out of the table lookup's dependency chain.
+ *
+ * CSI parameter digits, following a parameter transition, are
+ * consumed in a tight loop (csi_param_digits()), rather than being
+ * dispatched one by one.
+ */
+void
+vt_from_slave(struct terminal *term, const uint8_t *data, size_t len)
 {
-    switch (data) {
-        /*              exit                             current                          enter                            new state */
-    case 0x80 ... 0xbf:                                  action_utf8_44(term, data);                                       return STATE_GROUND;
-    default:                                                                                                               return STATE_GROUND;
+    static const void *const transitions[] = {
+#define X(id, action, new_state) [id] = &&transition_##id,
+        VT_TRANSITIONS(X)
+#undef X
+    };
+
+    const uint8_t *p = data;
+    const uint8_t *const end = data + len;
+
+    if (unlikely(len == 0))
+        return;
+
+    if (term->vt.state != STATE_GROUND)
+        goto *transitions[vt_table[term->vt.state][*p]];
+
+ground:
+    {
+        size_t count = ground_fast_path(term, p, end - p);
+        if (count > 0) {
+            p += count;
+            if (p >= end) {
+                term->vt.state = STATE_GROUND;
+                return;
+            }
+            goto ground;
+        }
     }
+
+    goto *transitions[vt_table[STATE_GROUND][*p]];
+
+#define X(id, action, new_state)                                \
+transition_##id:                                                \
+    vt_action(term, action, *p);                                \
+    p++;                                                        \
+    if (action == VT_ACTION_PARAM && new_state == STATE_CSI_PARAM) \
+        p = csi_param_digits(term, p, end);                     \
+    if (unlikely(p >= end)) {                                   \
+        term->vt.state = new_state;                             \
+        return;                                                 \
+    }                                                           \
+    if (new_state == STATE_GROUND)                              \
+        goto ground;                                            \
+    goto *transitions[vt_table[new_state][*p]];
+
+    VT_TRANSITIONS(X)
+#undef X
 }
 
 UNIGNORE_WARNINGS
 
+#else
+
 void
 vt_from_slave(struct terminal *term, const uint8_t *data, size_t len)
 {
@@ -1161,30 +1302,29 @@ vt_from_slave(struct terminal *term, const uint8_t *data, size_t len)
 
     const uint8_t *p = data;
     for (size_t i = 0; i < len; i++, p++) {
-        switch (current_state) {
-        case STATE_GROUND:              current_state = state_ground_switch(term, *p); break;
-        case STATE_ESCAPE:              current_state = state_escape_switch(term, *p); break;
-        case STATE_ESCAPE_INTERMEDIATE: current_state = state_escape_intermediate_switch(term, *p); break;
-        case STATE_CSI_ENTRY:           current_state = state_csi_entry_switch(term, *p); break;
-        case STATE_CSI_PARAM:           current_state = state_csi_param_switch(term, *p); break;
-        case STATE_CSI_INTERMEDIATE:    current_state = state_csi_intermediate_switch(term, *p); break;
-        case STATE_CSI_IGNORE:          current_state = state_csi_ignore_switch(term, *p); break;
-        case STATE_OSC_STRING:          current_state = state_osc_string_switch(term, *p); break;
-        case STATE_DCS_ENTRY:           current_state = state_dcs_entry_switch(term, *p); break;
-        case STATE_DCS_PARAM:           current_state = state_dcs_param_switch(term, *p); break;
-        case STATE_DCS_INTERMEDIATE:    current_state = state_dcs_intermediate_switch(term, *p); break;
-        case STATE_DCS_IGNORE:          current_state = state_dcs_ignore_switch(term, *p); break;
-        case STATE_DCS_PASSTHROUGH:     current_state = state_dcs_passthrough_switch(term, *p); break;
-        case STATE_SOS_PM_APC_STRING:   current_state = state_sos_pm_apc_string_switch(term, *p); break;
-
-        case STATE_UTF8_21:             current_state = state_utf8_21_switch(term, *p); break;
-        case STATE_UTF8_31:             current_state = state_utf8_31_switch(term, *p); break;
-        case STATE_UTF8_32:             current_state = state_utf8_32_switch(term, *p); break;
-        case STATE_UTF8_41:             current_state = state_utf8_41_switch(term, *p); break;
-        case STATE_UTF8_42:             current_state = state_utf8_42_switch(term, *p); break;
-        case STATE_UTF8_43:             current_state = state_utf8_43_switch(term, *p); break;
+        if (current_state == STATE_GROUND) {
+            size_t count = ground_fast_path(term, p, len - i);
+            if (count > 0) {
+                /* -1, since the loop increments too */
+                i += count - 1;
+                p += count - 1;
+                continue;
+            }
         }
 
-        term->vt.state = current_state;
+        switch (vt_table[current_state][*p]) {
+#define X(id, action, new_state)                \
+        case id:                                \
+            vt_action(term, action, *p);        \
+            current_state = new_state;          \
+            break;
+
+        VT_TRANSITIONS(X)
+#undef X
+        }
     }
+
+    term->vt.state = current_state;
 }
+
+#endif
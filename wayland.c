@@ -7,7 +7,6 @@
 #include <poll.h>
 #include <fcntl.h>
 
-#include <sys/timerfd.h>
 #include <sys/epoll.h>
 
 #include <wayland-client.h>
@@ -149,8 +148,7 @@ seat_destroy(struct seat *seat)
     if (seat->kbd.xkb != NULL)
         xkb_context_unref(seat->kbd.xkb);
 
-    if (seat->kbd.repeat.fd >= 0)
-        fdm_del(seat->wayl->fdm, seat->kbd.repeat.fd);
+    fdm_timer_del(seat->wayl->fdm, seat->kbd.repeat.timer);
 
     if (seat->pointer.theme != NULL)
         wl_cursor_theme_destroy(seat->pointer.theme);
@@ -785,26 +783,13 @@ static const struct zxdg_toplevel_decoration_v1_listener xdg_toplevel_decoration
 };
 
 static bool
-fdm_repeat(struct fdm *fdm, int fd, int events, void *data)
+fdm_repeat(struct fdm *fdm, struct fdm_timer *timer, uint64_t expirations,
+           void *data)
 {
-    if (events & EPOLLHUP)
-        return false;
-
     struct seat *seat = data;
-    uint64_t expiration_count;
-    ssize_t ret = read(
-        seat->kbd.repeat.fd, &expiration_count, sizeof(expiration_count));
-
-    if (ret < 0) {
-        if (errno == EAGAIN)
-            return true;
-
-        LOG_ERRNO("failed to read repeat key from repeat timer fd");
-        return false;
-    }
 
     seat->kbd.repeat.dont_re_repeat = true;
-    for (size_t i = 0; i < expiration_count; i++)
+    for (size_t i = 0; i < expirations; i++)
         input_repeat(seat, seat->kbd.repeat.key);
     seat->kbd.repeat.dont_re_repeat = false;
     return true;
@@ -875,33 +860,16 @@ handle_global(void *data, struct wl_registry *registry,
         if (!verify_iface_version(interface, version, required))
             return;
 
-        int repeat_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
-        if (repeat_fd == -1) {
-            LOG_ERRNO("failed to create keyboard repeat timer FD");
-            return;
-        }
-
         struct wl_seat *wl_seat = wl_registry_bind(
             wayl->registry, name, &wl_seat_interface, required);
 
         tll_push_back(wayl->seats, ((struct seat){
                     .wayl = wayl,
                     .wl_seat = wl_seat,
-                    .wl_name = name,
-                    .kbd = {
-                        .repeat = {
-                            .fd = repeat_fd,
-                        },
-                    }}));
+                    .wl_name = name}));
 
         struct seat *seat = &tll_back(wayl->seats);
-
-        if (!fdm_add(wayl->fdm, repeat_fd, EPOLLIN, &fdm_repeat, seat)) {
-            close(repeat_fd);
-            seat->kbd.repeat.fd = -1;
-            seat_destroy(seat);
-            return;
-        }
+        seat->kbd.repeat.timer = fdm_timer_add(wayl->fdm, &fdm_repeat, seat);
 
         seat_add_data_device(seat);
         seat_add_primary_selection(seat);
@@ -181,7 +181,7 @@ struct seat {
         struct xkb_compose_table *xkb_compose_table;
         struct xkb_compose_state *xkb_compose_state;
         struct {
-            int fd;
+            struct fdm_timer *timer;
 
             bool dont_re_repeat;
             int32_t delay;
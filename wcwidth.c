@@ -0,0 +1,58 @@
+#include "wcwidth.h"
+
+#include <stdint.h>
+
+#include "debug.h"
+#include "macros.h"
+#include "wcwidth-table.h"
+
+int
+my_wcwidth(wchar_t wc)
+{
+    if (unlikely((uint32_t)wc > WCWIDTH_MAX_CODEPOINT))
+        return -1;
+
+    const uint32_t cp = wc;
+    const uint8_t block = wcwidth_stage1[cp >> WCWIDTH_BLOCK_SHIFT];
+    const uint8_t packed = wcwidth_stage2[block][(cp & 0xff) >> 2];
+
+    return ((packed >> ((cp & 3) * 2)) & 3) - 1;
+}
+
+int
+my_wcswidth(const wchar_t *s, size_t n)
+{
+    int width = 0;
+
+    for (size_t i = 0; i < n && s[i] != L'\0'; i++) {
+        int w = my_wcwidth(s[i]);
+        if (w < 0)
+            return -1;
+        width += w;
+    }
+
+    return width;
+}
+
+UNITTEST
+{
+    xassert(my_wcwidth(L'\0') == 0);
+    xassert(my_wcwidth(L'\x1b') == -1);
+    xassert(my_wcwidth(L'\x7f') == -1);
+    xassert(my_wcwidth(L'\x9b') == -1);
+    xassert(my_wcwidth(L'a') == 1);
+    xassert(my_wcwidth(L'\u00e5') == 1);      /* LATIN SMALL LETTER A WITH RING ABOVE */
+    xassert(my_wcwidth(L'\u00ad') == 1);      /* SOFT HYPHEN */
+    xassert(my_wcwidth(L'\u0301') == 0);      /* COMBINING ACUTE ACCENT */
+    xassert(my_wcwidth(L'\u1160') == 0);      /* HANGUL JUNGSEONG FILLER */
+    xassert(my_wcwidth(L'\u200b') == 0);      /* ZERO WIDTH SPACE */
+    xassert(my_wcwidth(L'\u6f22') == 2);      /* CJK UNIFIED IDEOGRAPH-6F22 */
+    xassert(my_wcwidth(L'\uff21') == 2);      /* FULLWIDTH LATIN CAPITAL LETTER A */
+    xassert(my_wcwidth(L'\U0001f600') == 2);  /* GRINNING FACE */
+    xassert(my_wcwidth((wchar_t)0xd800) == -1);
+    xassert(my_wcwidth((wchar_t)0x110000) == -1);
+
+    xassert(my_wcswidth(L"a\u6f22b", 3) == 4);
+    xassert(my_wcswidth(L"a\u6f22b", 2) == 3);
+    xassert(my_wcswidth(L"a\x1b", 2) == -1);
+}
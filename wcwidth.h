@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stddef.h>
+#include <wchar.h>
+
+/*
+ * Replacements for wcwidth(3) and wcswidth(3), backed by a built-in
+ * table generated from the Unicode Character Database at build
+ * time. Unlike the libc versions, the result does not depend on the
+ * current locale, or on the libc version.
+ *
+ * Returns -1 for control characters and surrogates, 0 for combining
+ * and other zero-width characters, 2 for wide (East Asian Wide and
+ * Fullwidth) characters, and 1 for everything else.
+ */
+int my_wcwidth(wchar_t wc);
+int my_wcswidth(const wchar_t *s, size_t n);